@@ -1,4 +1,5 @@
 CFILES=$(shell find src/platform/linux/*.c src/*.c)
+CFLAGS+=-lpthread -lm
 
 ifndef DISABLE_WAYLAND
 	CFLAGS+=-lwayland-client\
@@ -13,15 +14,38 @@ endif
 ifndef DISABLE_X
 	CFLAGS+=-I/usr/include/freetype2/\
 		-lXfixes\
+		-lXdamage\
+		-lXrender\
+		-lXcursor\
 		-lXext\
 		-lXinerama\
+		-lXrandr\
 		-lXi\
 		-lXtst\
 		-lX11\
 		-lXft\
+		-lfreetype\
 		-DWARPD_X=1
 
 	CFILES+=$(shell find src/platform/linux/X/*.c)
+
+ifndef DISABLE_ATSPI
+	CFLAGS+=$(shell pkg-config --cflags dbus-1)\
+		-ldbus-1\
+		-DWARPD_ATSPI=1
+
+	CFILES+=$(shell find src/platform/linux/atspi/ -name '*.c')
+endif
+endif
+
+ifndef DISABLE_PNG
+	CFLAGS+=-lpng\
+		-DWARPD_PNG=1
+endif
+
+ifdef ENABLE_OCR
+	CFLAGS+=-ltesseract\
+		-DWARPD_OCR=1
 endif
 
 OBJECTS=$(CFILES:.c=.o)
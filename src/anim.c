@@ -0,0 +1,336 @@
+/*
+ * warpd - A modal keyboard-driven pointing system.
+ *
+ * © 2019 Raheman Vaiya (see: LICENSE).
+ */
+
+/*
+ * A frame paced scheduler for ripples and entry pulses on platforms which
+ * can draw rings (screen_draw_rings). Active effects are kept in a compact
+ * array and advanced against the monotonic clock once per refresh of the
+ * fastest screen they are on. Each frame only the screens with effects
+ * are redrawn, and only within the bounds of their old and new rings.
+ * Nothing is scheduled while no effect is active.
+ *
+ * Mode loops call anim_tick() whenever they wake up and wait for at most
+ * anim_timeout() for input. Whatever is still active when the mode loop
+ * exits is either played out (anim_drain) or cleared (anim_clear_all).
+ */
+
+#include "warpd.h"
+
+#define MAX_EFFECTS 16
+
+/* Used for screens which don't report their refresh rate (mHz). */
+#define DEFAULT_REFRESH_RATE 60000
+
+struct effect {
+	screen_t scr;
+	int x;
+	int y;
+
+	/* In us. */
+	uint64_t start;
+	uint64_t duration;
+
+	int max_radius;
+	int line_width;
+	uint8_t r, g, b, a;
+};
+
+static struct effect effects[MAX_EFFECTS];
+static size_t nr_effects;
+
+/* Screens which currently show rings along with their bounds. */
+static struct {
+	screen_t scr;
+	struct screen_rect bounds[MAX_EFFECTS];
+	size_t n;
+} shown[MAX_SCREENS];
+static size_t nr_shown;
+
+/* The time at which the next frame is due (0 if idle). */
+static uint64_t next_frame;
+
+/* #RRGGBB[AA] */
+static void parse_color(const char *s, struct effect *e)
+{
+	e->r = e->g = e->b = 0;
+	e->a = 255;
+
+	if (*s == '#')
+		s++;
+
+	sscanf(s, "%2hhx%2hhx%2hhx%2hhx", &e->r, &e->g, &e->b, &e->a);
+}
+
+static void add_effect(screen_t scr, int x, int y, int duration, int radius,
+		       int line_width, const char *color)
+{
+	struct effect *e;
+	size_t i;
+
+	if (duration <= 0 || radius <= 0)
+		return;
+
+	/* Full, replace the oldest. */
+	if (nr_effects == MAX_EFFECTS) {
+		e = &effects[0];
+		for (i = 1; i < nr_effects; i++)
+			if (effects[i].start < e->start)
+				e = &effects[i];
+	} else {
+		e = &effects[nr_effects++];
+	}
+
+	e->scr = scr;
+	e->x = x;
+	e->y = y;
+	e->start = get_time_us();
+	e->duration = (uint64_t)duration * 1000;
+	e->max_radius = radius;
+	e->line_width = MAX(1, line_width);
+	parse_color(color, e);
+
+	/* Draw the first frame as soon as possible. */
+	next_frame = e->start;
+}
+
+void anim_ripple(screen_t scr, int x, int y)
+{
+	if (!config_get_int("ripple_enabled"))
+		return;
+
+	add_effect(scr, x, y, config_get_int("ripple_duration"),
+		   config_get_int("ripple_max_radius"),
+		   config_get_int("ripple_line_width"),
+		   config_get("ripple_color"));
+}
+
+void anim_entry_pulse(screen_t scr, int x, int y)
+{
+	if (!config_get_int("cursor_entry_effect"))
+		return;
+
+	add_effect(scr, x, y, config_get_int("cursor_entry_duration"),
+		   config_get_int("cursor_entry_radius"), 2,
+		   config_get("cursor_entry_color"));
+}
+
+/* The period of the fastest screen with active effects in us. */
+static uint64_t frame_period()
+{
+	int rate = 0;
+	size_t i;
+
+	for (i = 0; i < nr_effects; i++) {
+		int r = 0;
+
+		if (platform->screen_get_refresh_rate)
+			r = platform->screen_get_refresh_rate(effects[i].scr);
+
+		rate = MAX(rate, r > 0 ? r : DEFAULT_REFRESH_RATE);
+	}
+
+	return 1000000000ULL / (rate ? rate : DEFAULT_REFRESH_RATE);
+}
+
+static size_t get_shown(screen_t scr)
+{
+	size_t i;
+
+	for (i = 0; i < nr_shown; i++)
+		if (shown[i].scr == scr)
+			return i;
+
+	shown[nr_shown].scr = scr;
+	shown[nr_shown].n = 0;
+
+	return nr_shown++;
+}
+
+/* Redraw the rings of the given screen (shown[idx]) as of now. */
+static void draw_screen(size_t idx, uint64_t now)
+{
+	static struct ring rings[MAX_EFFECTS];
+	static struct screen_rect damage[MAX_EFFECTS * 2];
+
+	screen_t scr = shown[idx].scr;
+	size_t nr_damage = 0;
+	size_t n = 0;
+	size_t i;
+
+	for (i = 0; i < shown[idx].n; i++)
+		damage[nr_damage++] = shown[idx].bounds[i];
+
+	shown[idx].n = 0;
+
+	for (i = 0; i < nr_effects; i++) {
+		struct effect *e = &effects[i];
+		uint64_t elapsed = now - e->start;
+		/* Fades out as it expands, in 256ths. */
+		int progress = elapsed * 256 / e->duration;
+		int fade = 256 - progress;
+		int reach;
+
+		if (e->scr != scr)
+			continue;
+
+		rings[n] = (struct ring){
+		    .x = e->x,
+		    .y = e->y,
+		    .radius = e->max_radius * progress / 256,
+		    .line_width = e->line_width,
+		    .color = raster_color(e->r, e->g, e->b, e->a * fade / 256),
+		};
+
+		/* Includes the antialiased edge. */
+		reach = rings[n].radius + (e->line_width + 1) / 2 + 1;
+		damage[nr_damage] = (struct screen_rect){
+		    .scr = scr,
+		    .x = e->x - reach,
+		    .y = e->y - reach,
+		    .w = reach * 2,
+		    .h = reach * 2,
+		};
+
+		shown[idx].bounds[shown[idx].n++] = damage[nr_damage++];
+		n++;
+	}
+
+	if (nr_damage)
+		platform->screen_draw_rings(scr, rings, n, damage, nr_damage);
+}
+
+/*
+ * Advance the active effects if a frame is due. Returns non-zero if
+ * anything was drawn, in which case the caller should commit().
+ */
+int anim_tick()
+{
+	const uint64_t now = get_time_us();
+	size_t i;
+
+	if (!next_frame || now < next_frame)
+		return 0;
+
+	/* Retire finished effects, the last frame clears them. */
+	for (i = 0; i < nr_effects;) {
+		if (now - effects[i].start >= effects[i].duration)
+			effects[i] = effects[--nr_effects];
+		else
+			i++;
+	}
+
+	for (i = 0; i < nr_effects; i++)
+		get_shown(effects[i].scr);
+
+	for (i = 0; i < nr_shown; i++)
+		draw_screen(i, now);
+
+	/* Forget screens which no longer show anything. */
+	for (i = 0; i < nr_shown;) {
+		if (!shown[i].n)
+			shown[i] = shown[--nr_shown];
+		else
+			i++;
+	}
+
+	if (nr_effects) {
+		const uint64_t period = frame_period();
+
+		/* Stay aligned to the first frame rather than drifting. */
+		next_frame += (now - next_frame) / period * period + period;
+	} else {
+		next_frame = 0;
+	}
+
+	return 1;
+}
+
+/*
+ * The time to wait for input (at most timeout ms, 0 for no limit) before
+ * the next frame. Only 0 if timeout is 0 and nothing is scheduled, since
+ * input_next_event() takes 0 to mean no timeout.
+ */
+int anim_timeout(int timeout)
+{
+	uint64_t now;
+	uint64_t wait;
+
+	if (!next_frame)
+		return timeout;
+
+	now = get_time_us();
+	if (now >= next_frame)
+		return 1;
+
+	wait = (next_frame - now + 999) / 1000;
+	if (timeout)
+		wait = MIN((uint64_t)timeout, wait);
+
+	return MAX(1, wait);
+}
+
+/*
+ * Play the active effects to completion, for callers which are about to
+ * stop driving the scheduler (e.g oneshot modes which exit right after a
+ * click).
+ */
+void anim_drain()
+{
+	while (next_frame) {
+		const uint64_t now = get_time_us();
+
+		if (now < next_frame)
+			usleep(next_frame - now);
+
+		if (anim_tick())
+			platform->commit();
+	}
+}
+
+/* Stop the effects on scr immediately (takes effect on commit()). */
+void anim_clear(screen_t scr)
+{
+	size_t i;
+
+	for (i = 0; i < nr_effects;) {
+		if (effects[i].scr == scr)
+			effects[i] = effects[--nr_effects];
+		else
+			i++;
+	}
+
+	for (i = 0; i < nr_shown; i++)
+		if (shown[i].scr == scr) {
+			platform->screen_draw_rings(scr, NULL, 0, shown[i].bounds,
+						    shown[i].n);
+			shown[i] = shown[--nr_shown];
+			break;
+		}
+
+	if (!nr_effects)
+		next_frame = 0;
+}
+
+/* Stop the effects on all screens (takes effect on commit()). */
+void anim_clear_all()
+{
+	while (nr_shown)
+		anim_clear(shown[0].scr);
+
+	nr_effects = 0;
+	next_frame = 0;
+}
+
+/* Drive the effects of platforms which can draw rings. */
+void init_anim()
+{
+	if (!platform->screen_draw_rings || platform->trigger_ripple)
+		return;
+
+	platform->trigger_ripple = anim_ripple;
+	platform->trigger_entry_pulse = anim_entry_pulse;
+	platform->screen_clear_ripples = anim_clear;
+}
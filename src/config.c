@@ -19,6 +19,8 @@ static struct {
     {"find_activation_key", "A-M-f", "Activate find mode (interactable hints).",
      OPT_KEY},
     {"hint2_activation_key", "A-M-X", "Activate two pass hint mode.", OPT_KEY},
+    {"text_activation_key", "A-M-t",
+     "Activate text hint mode (hints for the words on screen).", OPT_KEY},
     {"grid_activation_key", "A-M-g",
      "Activates grid mode and allows for further manipulation of the pointer "
      "using the mapped keys.",
@@ -76,6 +78,7 @@ static struct {
 	{"find_sticky", "F",
 	 "Activate sticky find mode for interactable hints (exit with esc).",
 	 OPT_KEY},
+	{"text", "T", "Activate text hint mode while in normal mode.", OPT_KEY},
 	{"grid", "g", "Activate (g)rid mode while in normal mode.", OPT_KEY},
     {"screen", "s", "Activate (s)creen selection while in normal mode.",
      OPT_KEY},
@@ -109,6 +112,11 @@ static struct {
     {"normal_large_step", "120",
      "Large step size (pixels) for word motions in normal mode.",
      OPT_INT},
+    {"normal_snap", "0",
+     "Make word motions stop at the next boundary on screen (e.g the edge "
+     "of a button or a line of text) rather than moving normal_large_step "
+     "pixels. Requires screen capture (X).",
+     OPT_INT},
 
     {"scroll_down", "e", "Scroll down key.", OPT_KEY},
     {"scroll_up", "r", "Scroll up key.", OPT_KEY},
@@ -206,6 +214,46 @@ static struct {
      OPT_STRING},
 
     {"hint_size", "20", "Hint size (range: 1-1000)", OPT_INT},
+    {"hint_scope", "screen",
+     "The area covered by hint mode, must be one of: screen, window (the "
+     "focused window).",
+     OPT_STRING},
+    {"hint_window_region", "none",
+     "The region ('<x> <y> <w> <h>' in screen coordinates) used by window "
+     "scoped hints on platforms which cannot report the focused window (e.g "
+     "wayland).",
+     OPT_STRING},
+    {"text_language", "eng",
+     "The tesseract language(s) used by text hint mode (e.g eng+deu).",
+     OPT_STRING},
+    {"find_source", "auto",
+     "Where find mode obtains targets, must be one of: accessibility, screen "
+     "(detected from the pixels on screen), auto (screen if accessibility "
+     "yields nothing).",
+     OPT_STRING},
+    {"find_detect_budget", "100",
+     "Time limit (ms) for detecting targets from the screen.", OPT_INT},
+    {"find_cache_ttl", "5000",
+     "Time (ms) for which find mode reuses the targets collected from an "
+     "unchanged window (0 disables caching).",
+     OPT_INT},
+    {"find_cache_warm_interval", "1000",
+     "Interval (ms) at which the daemon checks whether the focused window "
+     "has changed and settled while idle, and if so recollects its find "
+     "mode targets (0 disables).",
+     OPT_INT},
+    {"locate_threshold", "80",
+     "The minimum similarity (0-100) an on screen match must have to satisfy "
+     "--locate.",
+     OPT_INT},
+    {"wait_change_timeout", "5000",
+     "Default time (ms) for which --wait-change waits for the screen to "
+     "change.",
+     OPT_INT},
+    {"wait_change_settle", "100",
+     "Time (ms) the screen must remain unchanged for --wait-change to "
+     "consider it settled.",
+     OPT_INT},
     {"hint_border_radius", "3", "Border radius.", OPT_INT},
     {"hint_border_color", "#ffffff", "Hint border color (RGBA hex).",
      OPT_STRING},
@@ -227,6 +275,16 @@ static struct {
      "The spacing between hints in the secondary grid. (range: 1-1000)",
      OPT_INT},
     {"hint2_grid_size", "3", "The size of the secondary grid.", OPT_INT},
+    {"hint2_lens_zoom", "0",
+     "Magnify the neighbourhood of the cursor by this factor during the "
+     "second pass of hint2 so that small targets can be selected precisely "
+     "(the arrow keys pan the lens). 0 disables the lens. Requires screen "
+     "capture (X).",
+     OPT_INT},
+    {"hint2_lens_filter", "nearest",
+     "How the lens magnifies the screen: nearest (pixel boundaries remain "
+     "visible) or bilinear (smoother).",
+     OPT_STRING},
 
     {"screen_chars", "jkl;asdfg", "The characters used for screen selection.",
      OPT_STRING},
@@ -272,6 +330,18 @@ static struct {
      OPT_INT},
     {"ripple_max_radius", "50", "Maximum radius of ripple in pixels.", OPT_INT},
     {"ripple_line_width", "2", "Width of the ripple circle line.", OPT_INT},
+
+    {"x_hardware_cursor", "0",
+     "Display the normal mode cursor as the actual pointer image rather than "
+     "a window which follows it (X only). This changes the cursor of every "
+     "client, clients which use their own (unnamed) cursors will show those "
+     "instead.",
+     OPT_INT},
+    {"x_overlay", "1",
+     "Draw boxes into a single transparent window per screen rather than a "
+     "window per box (X only). Requires a compositor, if none is running "
+     "this has no effect.",
+     OPT_INT},
 };
 
 const char *config_get(const char *key)
@@ -3,6 +3,7 @@ static const char *activation_keys[] = {
     "activation_key",	    "hint_activation_key", "find_activation_key",
     "grid_activation_key",  "hint_oneshot_key",	   "screen_activation_key",
     "hint2_activation_key", "hint2_oneshot_key",   "history_activation_key",
+    "text_activation_key",
 };
 
 static struct input_event
@@ -22,6 +23,7 @@ static void reload_config(const char *path)
 
 	init_hints();
 	init_mouse();
+	init_targets();
 
 	for (i = 0; i < sizeof activation_keys / sizeof activation_keys[0]; i++)
 		input_parse_string(&activation_events[i],
@@ -34,10 +36,15 @@ void daemon_loop(const char *config_path)
 
 	platform->monitor_file(config_path);
 	reload_config(config_path);
+	start_target_warmer();
 
 	while (1) {
 		int mode = 0;
-		struct input_event *ev = platform->input_wait(
+		struct input_event *ev;
+
+		/* Targets are only warmed while no mode is active. */
+		targets_set_busy(0);
+		ev = platform->input_wait(
 		    activation_events,
 		    sizeof(activation_events) / sizeof(activation_events[0]));
 
@@ -46,6 +53,8 @@ void daemon_loop(const char *config_path)
 			continue;
 		}
 
+		targets_set_busy(1);
+
 		config_input_whitelist(activation_keys,
 				       sizeof activation_keys /
 					   sizeof activation_keys[0]);
@@ -64,6 +73,8 @@ void daemon_loop(const char *config_path)
 			mode = MODE_SCREEN_SELECTION;
 		else if (activation_event_match(ev, &activation_events[8]))
 			mode = MODE_HISTORY;
+		else if (activation_event_match(ev, &activation_events[9]))
+			mode = MODE_TEXT;
 		else if (activation_event_match(ev, &activation_events[7])) {
 			full_hint_mode(1);
 			continue;
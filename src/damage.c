@@ -0,0 +1,181 @@
+/*
+ * warpd - A modal keyboard-driven pointing system.
+ *
+ * © 2019 Raheman Vaiya (see: LICENSE).
+ */
+
+/*
+ * Fans platform damage out to independent consumers. Each consumer sees a
+ * per screen map of DAMAGE_TILE sized tiles which have changed since it last
+ * asked.
+ */
+
+#include "warpd.h"
+
+#ifndef WINDOWS
+#include <pthread.h>
+
+static pthread_mutex_t mtx = PTHREAD_MUTEX_INITIALIZER;
+
+#define lock()	 pthread_mutex_lock(&mtx)
+#define unlock() pthread_mutex_unlock(&mtx)
+#else
+#define lock()
+#define unlock()
+#endif
+
+struct damage_map {
+	screen_t scr;
+
+	int cols;
+	int rows;
+
+	uint8_t *tiles[NR_DAMAGE_CONSUMERS];
+};
+
+static struct damage_map maps[MAX_SCREENS];
+static size_t nr_maps = 0;
+
+/* Whether the platform reported precise damage on the last poll. */
+static int tracked = 0;
+
+/* Expects the lock to be held. */
+static struct damage_map *get_map(screen_t scr)
+{
+	struct damage_map *map;
+	int sw, sh;
+	size_t i;
+
+	for (i = 0; i < nr_maps; i++)
+		if (maps[i].scr == scr)
+			return &maps[i];
+
+	if (nr_maps == MAX_SCREENS)
+		return NULL;
+
+	platform->screen_get_dimensions(scr, &sw, &sh);
+
+	map = &maps[nr_maps];
+	map->scr = scr;
+	map->cols = (sw + DAMAGE_TILE - 1) / DAMAGE_TILE;
+	map->rows = (sh + DAMAGE_TILE - 1) / DAMAGE_TILE;
+
+	/* Everything starts out dirty. */
+	for (i = 0; i < NR_DAMAGE_CONSUMERS; i++) {
+		if (!(map->tiles[i] = malloc(map->cols * map->rows))) {
+			while (i--)
+				free(map->tiles[i]);
+			return NULL;
+		}
+
+		memset(map->tiles[i], 1, map->cols * map->rows);
+	}
+
+	nr_maps++;
+	return map;
+}
+
+static void mark(struct damage_map *map, int x, int y, int w, int h)
+{
+	int c0 = MAX(0, x / DAMAGE_TILE);
+	int r0 = MAX(0, y / DAMAGE_TILE);
+	int c1 = MIN(map->cols - 1, (x + w - 1) / DAMAGE_TILE);
+	int r1 = MIN(map->rows - 1, (y + h - 1) / DAMAGE_TILE);
+	int r, c;
+	size_t i;
+
+	for (i = 0; i < NR_DAMAGE_CONSUMERS; i++)
+		for (r = r0; r <= r1; r++)
+			for (c = c0; c <= c1; c++)
+				map->tiles[i][r * map->cols + c] = 1;
+}
+
+/* Expects the lock to be held. */
+static void poll_platform()
+{
+	static struct screen_rect rects[1024];
+	size_t i;
+	int n;
+
+	n = platform->screen_poll_damage
+		? platform->screen_poll_damage(
+		      rects, sizeof rects / sizeof rects[0])
+		: -1;
+
+	tracked = n >= 0;
+
+	if (n < 0) {
+		for (i = 0; i < nr_maps; i++)
+			mark(&maps[i], 0, 0, maps[i].cols * DAMAGE_TILE,
+			     maps[i].rows * DAMAGE_TILE);
+		return;
+	}
+
+	for (i = 0; i < (size_t)n; i++) {
+		struct damage_map *map = get_map(rects[i].scr);
+
+		if (map)
+			mark(map, rects[i].x, rects[i].y, rects[i].w,
+			     rects[i].h);
+	}
+}
+
+/*
+ * Copy the tiles of scr which changed since the consumer last asked into
+ * tiles (which must hold cols*rows entries, see damage_get_dimensions) and
+ * reset them. Returns the number of dirty tiles. Screens which can't be
+ * tracked are reported dirty in their entirety.
+ */
+size_t damage_get(screen_t scr, enum damage_consumer consumer, uint8_t *tiles)
+{
+	struct damage_map *map;
+	size_t i, n = 0;
+
+	lock();
+
+	if (!(map = get_map(scr))) {
+		int cols, rows;
+
+		unlock();
+
+		damage_get_dimensions(scr, &cols, &rows);
+		memset(tiles, 1, cols * rows);
+
+		return cols * rows;
+	}
+
+	poll_platform();
+
+	for (i = 0; i < (size_t)(map->cols * map->rows); i++)
+		n += (tiles[i] = map->tiles[consumer][i]);
+
+	memset(map->tiles[consumer], 0, map->cols * map->rows);
+
+	unlock();
+	return n;
+}
+
+void damage_get_dimensions(screen_t scr, int *cols, int *rows)
+{
+	int sw, sh;
+
+	platform->screen_get_dimensions(scr, &sw, &sh);
+
+	*cols = (sw + DAMAGE_TILE - 1) / DAMAGE_TILE;
+	*rows = (sh + DAMAGE_TILE - 1) / DAMAGE_TILE;
+}
+
+/*
+ * Whether damage is precise (as opposed to everything being reported dirty
+ * on each call). Only meaningful after damage_get.
+ */
+int damage_tracked()
+{
+	int ret;
+
+	lock();
+	ret = tracked;
+	unlock();
+
+	return ret;
+}
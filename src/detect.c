@@ -0,0 +1,164 @@
+/*
+ * warpd - A modal keyboard-driven pointing system.
+ *
+ * © 2019 Raheman Vaiya (see: LICENSE).
+ */
+
+/*
+ * Proposes interactable targets from the pixels on screen, for applications
+ * which expose nothing to the accessibility API. High contrast regions are
+ * grouped into connected components on a coarse grid, components which are
+ * roughly the size of a control (button, icon, word) become targets.
+ */
+
+#include "warpd.h"
+
+#define EDGE_THRESHOLD 24
+
+/* Pixels per grid cell, gaps narrower than this join neighbouring glyphs. */
+#define CELL 4
+
+struct component {
+	int x0, y0;
+	int x1, y1;
+};
+
+static int accept_component(const struct component *c, int sw, int sh)
+{
+	const int w = (c->x1 - c->x0 + 1) * CELL;
+	const int h = (c->y1 - c->y0 + 1) * CELL;
+
+	return w >= 8 && h >= 8 && w <= sw / 3 && h <= sh / 8 &&
+	       w <= h * 40;
+}
+
+size_t detect_interactable_hints(screen_t scr, struct hint *hints,
+				 size_t max_hints, int budget_ms)
+{
+	int sw, sh;
+	int cw, ch;
+	int x, y;
+	size_t n = 0;
+	size_t i;
+	size_t nr_components = 0;
+	size_t dropped = 0;
+
+	uint8_t *luma = NULL;
+	uint8_t *edges = NULL;
+	uint8_t *cells = NULL;
+	uint32_t *stack = NULL;
+	struct component *accepted = NULL;
+
+	const uint64_t start = get_time_us();
+	const uint64_t deadline = start + (uint64_t)budget_ms * 1000;
+
+	platform->screen_get_dimensions(scr, &sw, &sh);
+
+	cw = sw / CELL;
+	ch = sh / CELL;
+
+	if (!max_hints || cw < 3 || ch < 3)
+		return 0;
+
+	if (!(luma = image_capture_luma(scr, 0, 0, sw, sh)))
+		return 0;
+
+	edges = malloc((size_t)sw * sh);
+	cells = malloc((size_t)cw * ch);
+	stack = malloc((size_t)cw * ch * sizeof *stack);
+	accepted = malloc(max_hints * sizeof *accepted);
+
+	if (!edges || !cells || !stack || !accepted)
+		goto out;
+
+	image_edges(luma, edges, sw, sh, EDGE_THRESHOLD);
+	image_reduce(edges, cells, sw, sh, CELL);
+
+	/* Flood fill (8 connected) the marked cells. */
+	for (y = 0; y < ch; y++) {
+		if (get_time_us() > deadline)
+			goto out;
+
+		for (x = 0; x < cw; x++) {
+			struct component c = {x, y, x, y};
+			size_t sp = 0;
+
+			if (!cells[y * cw + x])
+				continue;
+
+			cells[y * cw + x] = 0;
+			stack[sp++] = y * cw + x;
+
+			while (sp) {
+				uint32_t idx = stack[--sp];
+				int px = idx % cw;
+				int py = idx / cw;
+				int dx, dy;
+
+				c.x0 = MIN(c.x0, px);
+				c.x1 = MAX(c.x1, px);
+				c.y0 = MIN(c.y0, py);
+				c.y1 = MAX(c.y1, py);
+
+				for (dy = -1; dy <= 1; dy++)
+					for (dx = -1; dx <= 1; dx++) {
+						int nx = px + dx;
+						int ny = py + dy;
+
+						if (nx < 0 || ny < 0 ||
+						    nx >= cw || ny >= ch ||
+						    !cells[ny * cw + nx])
+							continue;
+
+						cells[ny * cw + nx] = 0;
+						stack[sp++] = ny * cw + nx;
+					}
+			}
+
+			nr_components++;
+
+			if (!accept_component(&c, sw, sh) || n >= max_hints)
+				continue;
+
+			/*
+			 * Raster order visits the outline of a control before
+			 * its contents, so skip anything which lies within an
+			 * accepted component (e.g the label of a button).
+			 */
+			for (i = 0; i < n; i++) {
+				const struct component *a = &accepted[i];
+
+				if (c.x0 >= a->x0 && c.x1 <= a->x1 &&
+				    c.y0 >= a->y0 && c.y1 <= a->y1)
+					break;
+			}
+
+			if (i < n) {
+				dropped++;
+				continue;
+			}
+
+			accepted[n] = c;
+			hints[n].x = (c.x0 + c.x1 + 1) * CELL / 2;
+			hints[n].y = (c.y0 + c.y1 + 1) * CELL / 2;
+			n++;
+		}
+	}
+
+out:
+	if (getenv("WARPD_DETECT_DEBUG"))
+		fprintf(stderr,
+			"detect: components=%zu hints=%zu nested=%zu "
+			"ms=%.2f%s\n",
+			nr_components, n, dropped,
+			(get_time_us() - start) / 1000.0,
+			get_time_us() > deadline ? " (budget exceeded)" : "");
+
+	free(luma);
+	free(edges);
+	free(cells);
+	free(stack);
+	free(accepted);
+
+	return n;
+}
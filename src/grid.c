@@ -10,24 +10,48 @@ static int grid_width;
 static int grid_height;
 static screen_t scr;
 
-static void draw_grid(screen_t scr, const char *color, int sz, int nc, int nr,
-		      int x, int y, int w, int h)
+/* The lines of each grid are a single (multi rectangle) box. */
+static struct scene_box *border_box;
+static struct scene_box *line_box;
+static struct scene_box *cursor_box;
+
+static struct screen_rect *rects;
+static size_t rects_sz;
+
+static void draw_grid(struct scene_box *box, const char *color, int sz, int nc,
+		      int nr, int x, int y, int w, int h)
 {
-	int i;
+	const size_t n = nr + nc + 2;
+	size_t i = 0;
+	int j;
 
 	const int ygap = (h - ((nr + 1) * sz)) / nr;
 	const int xgap = (w - ((nc + 1) * sz)) / nc;
 
-	if (xgap < 0 || ygap < 0)
+	if (xgap < 0 || ygap < 0) {
+		scene_box_hide(box);
 		return;
+	}
+
+	if (n > rects_sz) {
+		struct screen_rect *r = realloc(rects, n * sizeof *r);
+
+		if (!r)
+			return;
 
-	for (i = 0; i < nr + 1; i++)
-		platform->screen_draw_box(scr, x, y + (ygap + sz) * i, w, sz,
-					  color);
+		rects = r;
+		rects_sz = n;
+	}
+
+	for (j = 0; j < nr + 1; j++)
+		rects[i++] = (struct screen_rect){scr, x, y + (ygap + sz) * j, w,
+						  sz};
+
+	for (j = 0; j < nc + 1; j++)
+		rects[i++] = (struct screen_rect){scr, x + (xgap + sz) * j, y, sz,
+						  h};
 
-	for (i = 0; i < nc + 1; i++)
-		platform->screen_draw_box(scr, x + (xgap + sz) * i, y, sz, h,
-					  color);
+	scene_box_set_rects(box, scr, rects, n, color);
 }
 
 static void redraw(int mx, int my, int force)
@@ -55,19 +79,29 @@ static void redraw(int mx, int my, int force)
 	omx = mx;
 	omy = my;
 
-	platform->screen_clear(scr);
+	if (!border_box)
+		border_box = scene_box_create();
+	if (!line_box)
+		line_box = scene_box_create();
+	if (!cursor_box)
+		cursor_box = scene_box_create();
 
-	/* Draw the border. */
-	draw_grid(scr, gbcol, gsz + gbsz * 2, nc, nr, x, y, gw, gh);
+	/* Draw the border (entirely covered by the grid if it is empty). */
+	if (gbsz > 0)
+		draw_grid(border_box, gbcol, gsz + gbsz * 2, nc, nr, x, y, gw,
+			  gh);
+	else
+		scene_box_hide(border_box);
 
 	/* Draw the grid. */
-	draw_grid(scr, gcol, gsz, nc, nr, x + gbsz, y + gbsz, gw - gbsz * 2,
-		  gh - gbsz * 2);
+	draw_grid(line_box, gcol, gsz, nc, nr, x + gbsz, y + gbsz,
+		  gw - gbsz * 2, gh - gbsz * 2);
 
-	platform->screen_draw_box(scr, x + gw / 2 - cursz / 2,
-				  y + gh / 2 - cursz / 2, cursz, cursz,
-				  config_get("cursor_color"));
+	scene_box_set(cursor_box, scr, x + gw / 2 - cursz / 2,
+		      y + gh / 2 - cursz / 2, cursz, cursz,
+		      config_get("cursor_color"));
 
+	scene_commit(scr);
 	platform->commit();
 }
 
@@ -108,9 +142,12 @@ struct input_event *grid_mode()
 	while (1) {
 		int idx;
 
-		ev = platform->input_next_event(10);
+		ev = platform->input_next_event(anim_timeout(10));
 		screen_get_cursor(NULL, &mx, &my, 0);
 
+		if (anim_tick())
+			platform->commit();
+
 		if (mouse_process_key(ev, "grid_up", "grid_down", "grid_left",
 				      "grid_right")) {
 			redraw(mx, my, 0);
@@ -219,6 +256,8 @@ struct input_event *grid_mode()
 
 exit:
 	config_input_whitelist(NULL, 0);
+	scene_clear();
+	scene_commit(scr);
 	platform->screen_clear(scr);
 	platform->mouse_show();
 
@@ -6,13 +6,36 @@
 
 #include "warpd.h"
 
+/* The hints being selected from (see hint_selection). */
+static struct hint_buf candidates;
+static struct hint_buf matched_buf;
+
 struct hint *hints;
-struct hint matched[MAX_HINTS];
+static struct hint *matched;
 
 static size_t nr_hints;
 static size_t nr_matched;
 static int hint_selected;
 
+/* Returns storage for at least n hints, or NULL on failure. */
+struct hint *hint_buf_reserve(struct hint_buf *b, size_t n)
+{
+	struct hint *h;
+	size_t sz;
+
+	if (b->hints && n <= b->sz)
+		return b->hints;
+
+	sz = MAX(n, 64);
+	if (!(h = realloc(b->hints, sz * sizeof *h)))
+		return NULL;
+
+	b->hints = h;
+	b->sz = sz;
+
+	return h;
+}
+
 char last_selected_hint[32];
 
 static void filter(screen_t scr, const char *s)
@@ -62,6 +85,16 @@ static int hint_label_length(size_t count, size_t alphabet_len)
 	return length;
 }
 
+static void label_from_index(char *label, size_t value, int label_len,
+			     const char *alphabet, size_t alphabet_len)
+{
+	for (int pos = label_len - 1; pos >= 0; pos--) {
+		label[pos] = alphabet[value % alphabet_len];
+		value /= alphabet_len;
+	}
+	label[label_len] = 0;
+}
+
 static void generate_hint_labels(struct hint *out_hints, size_t count,
 				 const char *alphabet)
 {
@@ -71,41 +104,216 @@ static void generate_hint_labels(struct hint *out_hints, size_t count,
 	if (!label_len)
 		return;
 
-	for (size_t i = 0; i < count; i++) {
-		size_t value = i;
-		for (int pos = label_len - 1; pos >= 0; pos--) {
-			out_hints[i].label[pos] =
-			    alphabet[value % alphabet_len];
-			value /= alphabet_len;
+	for (size_t i = 0; i < count; i++)
+		label_from_index(out_hints[i].label, i, label_len, alphabet,
+				 alphabet_len);
+}
+
+/* Returns the index of the given label, or -1 if it is not a valid label. */
+static ssize_t label_to_index(const char *label, const char *alphabet)
+{
+	size_t alphabet_len = strlen(alphabet);
+	ssize_t value = 0;
+
+	for (; *label; label++) {
+		const char *c = strchr(alphabet, *label);
+
+		if (!c)
+			return -1;
+
+		value = value * alphabet_len + (c - alphabet);
+	}
+
+	return value;
+}
+
+/*
+ * Like generate_hint_labels, but hints which coincide with one of the
+ * previous hints (within tolerance) inherit its label, new hints
+ * receive the lowest free labels. The previous label length is retained
+ * where possible since mixing lengths would break prefix matching.
+ */
+static void generate_stable_hint_labels(struct hint *out_hints, size_t count,
+					const struct hint *prev,
+					size_t nr_prev, int tolerance,
+					const char *alphabet)
+{
+	uint8_t *prev_used;
+	uint8_t *taken;
+	size_t nr_taken;
+
+	size_t alphabet_len = strlen(alphabet);
+	int label_len = hint_label_length(count, alphabet_len);
+	size_t next = 0;
+	size_t i, j;
+
+	if (!label_len)
+		return;
+
+	if (nr_prev) {
+		int prev_len = strlen(prev[0].label);
+		size_t capacity = 1;
+
+		for (i = 0; i < (size_t)prev_len && capacity < count; i++)
+			capacity *= alphabet_len;
+
+		if (prev_len >= label_len && capacity >= count)
+			label_len = prev_len;
+		else
+			nr_prev = 0;
+	}
+
+	/*
+	 * At most nr_prev labels are inherited, so the lowest count +
+	 * nr_prev indices always contain enough free ones.
+	 */
+	nr_taken = count + nr_prev;
+	prev_used = calloc(nr_prev + 1, 1);
+	taken = calloc(nr_taken, 1);
+
+	if (!prev_used || !taken) {
+		free(prev_used);
+		free(taken);
+		generate_hint_labels(out_hints, count, alphabet);
+		return;
+	}
+
+	for (i = 0; i < count; i++) {
+		struct hint *h = &out_hints[i];
+		int best_dist = tolerance + 1;
+		ssize_t best = -1;
+
+		h->label[0] = 0;
+
+		for (j = 0; j < nr_prev; j++) {
+			int dx = abs(prev[j].x - h->x);
+			int dy = abs(prev[j].y - h->y);
+
+			if (!prev_used[j] && dx <= tolerance &&
+			    dy <= tolerance && MAX(dx, dy) < best_dist) {
+				best = j;
+				best_dist = MAX(dx, dy);
+			}
 		}
-		out_hints[i].label[label_len] = 0;
+
+		if (best != -1) {
+			ssize_t idx = label_to_index(prev[best].label, alphabet);
+
+			prev_used[best] = 1;
+			strcpy(h->label, prev[best].label);
+
+			if (idx >= 0 && (size_t)idx < nr_taken)
+				taken[idx] = 1;
+		}
+	}
+
+	for (i = 0; i < count; i++) {
+		if (out_hints[i].label[0])
+			continue;
+
+		while (next < nr_taken && taken[next])
+			next++;
+
+		label_from_index(out_hints[i].label, next++, label_len,
+				 alphabet, alphabet_len);
+	}
+
+	free(prev_used);
+	free(taken);
+}
+
+static int hint_label_cmp(const void *a, const void *b)
+{
+	return strcmp(((const struct hint *)a)->label,
+		      ((const struct hint *)b)->label);
+}
+
+/*
+ * Obtain the region (in screen coordinates) covered by the hint lattice. When
+ * hint_scope is set to 'window' this is the focused window, or
+ * hint_window_region on platforms which cannot report one.
+ */
+static void get_hint_region(screen_t scr, int *x, int *y, int *w, int *h)
+{
+	int sw, sh;
+	int rx, ry, rw, rh;
+	const char *region = config_get("hint_window_region");
+
+	platform->screen_get_dimensions(scr, &sw, &sh);
+
+	*x = 0;
+	*y = 0;
+	*w = sw;
+	*h = sh;
+
+	if (strcmp(config_get("hint_scope"), "window"))
+		return;
+
+	if (platform->screen_get_focused_window) {
+		if (platform->screen_get_focused_window(scr, &rx, &ry, &rw,
+							&rh))
+			return;
+	} else if (sscanf(region, "%d %d %d %d", &rx, &ry, &rw, &rh) != 4) {
+		return;
 	}
+
+	if (rx < 0) {
+		rw += rx;
+		rx = 0;
+	}
+	if (ry < 0) {
+		rh += ry;
+		ry = 0;
+	}
+
+	rw = MIN(rw, sw - rx);
+	rh = MIN(rh, sh - ry);
+
+	if (rw <= 0 || rh <= 0)
+		return;
+
+	*x = rx;
+	*y = ry;
+	*w = rw;
+	*h = rh;
 }
 
-static size_t generate_fullscreen_hints(screen_t scr, struct hint *hints)
+/* Returns the number of hints stored in *out (0 on failure). */
+static size_t generate_fullscreen_hints(screen_t scr, struct hint **out)
 {
+	struct hint *hints;
 	int sw, sh;
+	int rx, ry, rw, rh;
 	int w, h;
 	int i, j;
 	size_t n = 0;
 
 	const char *chars = config_get("hint_chars");
+	const int nchars = strlen(chars);
+
 	get_hint_size(scr, &w, &h);
 	platform->screen_get_dimensions(scr, &sw, &sh);
+	get_hint_region(scr, &rx, &ry, &rw, &rh);
 
-	const int nr = strlen(chars);
-	const int nc = strlen(chars);
+	/*
+	 * Preserve the screen-wide hint density within smaller regions so
+	 * that a window scoped lattice yields fewer (and shorter) labels.
+	 */
+	const int nc = MAX(1, (nchars * rw + sw - 1) / sw);
+	const int nr = MAX(1, (nchars * rh + sh - 1) / sh);
 
-	const int colgap = sw / nc - w;
-	const int rowgap = sh / nr - h;
+	const int colgap = rw / nc - w;
+	const int rowgap = rh / nr - h;
 
-	const int x_offset = (sw - nc * w - (nc - 1) * colgap) / 2;
-	const int y_offset = (sh - nr * h - (nr - 1) * rowgap) / 2;
+	const int x_offset = rx + (rw - nc * w - (nc - 1) * colgap) / 2;
+	const int y_offset = ry + (rh - nr * h - (nr - 1) * rowgap) / 2;
 
 	int x = x_offset;
 	int y = y_offset;
 
-	get_hint_size(scr, &w, &h);
+	/* One for each character squared on a full screen lattice. */
+	if (!(hints = hint_buf_reserve(&candidates, (size_t)nc * nr)))
+		return 0;
 
 	for (i = 0; i < nc; i++) {
 		for (j = 0; j < nr; j++) {
@@ -117,10 +325,6 @@ static size_t generate_fullscreen_hints(screen_t scr, struct hint *hints)
 			hint->w = w;
 			hint->h = h;
 
-			hint->label[0] = chars[i];
-			hint->label[1] = chars[j];
-			hint->label[2] = 0;
-
 			y += rowgap + h;
 		}
 
@@ -128,11 +332,18 @@ static size_t generate_fullscreen_hints(screen_t scr, struct hint *hints)
 		x += colgap + w;
 	}
 
+	/* Column major, so a full screen lattice is labelled <col><row>. */
+	generate_hint_labels(hints, n, chars);
+
+	*out = hints;
 	return n;
 }
 
 static int hint_selection(screen_t scr, struct hint *_hints, size_t _nr_hints)
 {
+	if (!(matched = hint_buf_reserve(&matched_buf, _nr_hints)))
+		return -1;
+
 	hints = _hints;
 	nr_hints = _nr_hints;
 	hint_selected = 0;
@@ -157,9 +368,13 @@ static int hint_selection(screen_t scr, struct hint *_hints, size_t _nr_hints)
 		struct input_event *ev;
 		ssize_t len;
 
-		ev = platform->input_next_event(0);
+		ev = platform->input_next_event(anim_timeout(0));
 
-		if (!ev->pressed)
+		/* Play out ripples from e.g a previous sticky selection. */
+		if (anim_tick())
+			platform->commit();
+
+		if (!ev || !ev->pressed)
 			continue;
 
 		len = strlen(buf);
@@ -224,6 +439,192 @@ static int hint_selection(screen_t scr, struct hint *_hints, size_t _nr_hints)
 	return rc;
 }
 
+/*
+ * A variant of sift() which shows the neighbourhood of the cursor magnified
+ * by hint2_lens_zoom and lays the grid over the magnified image, so each
+ * cell corresponds to a proportionally smaller region of the screen. The
+ * arrow keys pan the lens by a single (source) pixel. Returns 1 if the
+ * lens can't be shown (e.g the screen can't be captured).
+ */
+static int lens_sift(int zoom)
+{
+	int gap = config_get_int("hint2_gap_size");
+	int hint_sz = config_get_int("hint2_size");
+
+	const char *chars = config_get("hint2_chars");
+	const size_t chars_len = strlen(chars);
+	const int grid_sz = config_get_int("hint2_grid_size");
+
+	const uint8_t left = platform->input_special_to_code("leftarrow");
+	const uint8_t right = platform->input_special_to_code("rightarrow");
+	const uint8_t up = platform->input_special_to_code("uparrow");
+	const uint8_t down = platform->input_special_to_code("downarrow");
+
+	const char *keys[] = {
+	    "hint_exit",
+	};
+
+	struct hint *lens_hints;
+	uint32_t *cap = NULL, *view = NULL, *zoomed = NULL;
+	int cap_x = 0, cap_y = 0, cap_w = 0, cap_h = 0;
+	int cx, cy;
+	int sw, sh;
+	int span, src, panel;
+	int rc = 1;
+	int bilinear = !strcmp(config_get("hint2_lens_filter"), "bilinear");
+	screen_t scr;
+
+	screen_get_cursor(&scr, &cx, &cy, 1);
+	platform->screen_get_dimensions(scr, &sw, &sh);
+
+	gap = (gap * sh) / 1000;
+	hint_sz = (hint_sz * sh) / 1000;
+
+	/* The region covered by the regular grid, shown zoom times larger. */
+	span = (hint_sz + gap) * grid_sz;
+	src = MIN(MIN(sw, sh), MAX(1, span / zoom));
+	panel = src * zoom;
+
+	view = malloc((size_t)src * src * sizeof *view);
+	zoomed = malloc((size_t)panel * panel * sizeof *zoomed);
+	cap = malloc((size_t)src * 4 * src * 4 * sizeof *cap);
+	lens_hints = hint_buf_reserve(&candidates, chars_len);
+
+	if (!view || !zoomed || !cap || !lens_hints)
+		goto out;
+
+	platform->input_grab_keyboard();
+	platform->mouse_hide();
+
+	while (1) {
+		struct input_event *ev;
+		int vx = MAX(0, MIN(sw - src, cx - src / 2));
+		int vy = MAX(0, MIN(sh - src, cy - src / 2));
+		int px = MAX(0, MIN(sw - panel, cx - panel / 2));
+		int py = MAX(0, MIN(sh - panel, cy - panel / 2));
+		int ox = px + (panel - span) / 2;
+		int oy = py + (panel - span) / 2;
+		int col, row, y;
+		size_t n = 0;
+
+		/*
+		 * Capture enough to pan without recapturing (which would
+		 * include the lens itself) on every key.
+		 */
+		if (vx < cap_x || vy < cap_y || vx + src > cap_x + cap_w ||
+		    vy + src > cap_y + cap_h) {
+			cap_w = MIN(sw, src * 4);
+			cap_h = MIN(sh, src * 4);
+			cap_x = MAX(0, MIN(sw - cap_w, cx - cap_w / 2));
+			cap_y = MAX(0, MIN(sh - cap_h, cy - cap_h / 2));
+
+			platform->screen_clear(scr);
+			platform->commit();
+
+			if (platform->screen_capture(scr, cap_x, cap_y, cap_w,
+						     cap_h, cap)) {
+				rc = 1;
+				break;
+			}
+		}
+
+		for (y = 0; y < src; y++)
+			memcpy(view + (size_t)y * src,
+			       cap + (size_t)(vy - cap_y + y) * cap_w +
+				   (vx - cap_x),
+			       src * sizeof *view);
+
+		if (bilinear)
+			image_zoom_bilinear(view, zoomed, src, src, zoom);
+		else
+			image_zoom(view, zoomed, src, src, zoom);
+
+		for (col = 0; col < grid_sz; col++)
+			for (row = 0; row < grid_sz; row++) {
+				size_t idx = (row * grid_sz) + col;
+
+				if (idx >= chars_len)
+					continue;
+
+				lens_hints[n].x = ox + (hint_sz + gap) * col;
+				lens_hints[n].y = oy + (hint_sz + gap) * row;
+				lens_hints[n].w = hint_sz;
+				lens_hints[n].h = hint_sz;
+				lens_hints[n].label[0] = chars[idx];
+				lens_hints[n].label[1] = 0;
+				n++;
+			}
+
+		platform->screen_clear(scr);
+		platform->screen_draw_image(scr, px, py, panel, panel, zoomed);
+		platform->hint_draw(scr, lens_hints, n);
+		platform->commit();
+
+		config_input_whitelist(keys, sizeof keys / sizeof keys[0]);
+
+		/* Animate without redrawing the lens. */
+		do {
+			ev = platform->input_next_event(anim_timeout(0));
+
+			if (anim_tick())
+				platform->commit();
+		} while (!ev);
+
+		if (!ev->pressed)
+			continue;
+
+		if (config_input_match(ev, "hint_exit")) {
+			rc = -1;
+			break;
+		} else if (ev->code == left) {
+			cx = MAX(0, cx - 1);
+		} else if (ev->code == right) {
+			cx = MIN(sw - 1, cx + 1);
+		} else if (ev->code == up) {
+			cy = MAX(0, cy - 1);
+		} else if (ev->code == down) {
+			cy = MIN(sh - 1, cy + 1);
+		} else {
+			char c = platform->input_code_to_qwerty(ev->code);
+			size_t i;
+
+			for (i = 0; c && i < n; i++)
+				if (lens_hints[i].label[0] == c)
+					break;
+
+			if (!c || i == n)
+				continue;
+
+			/* Map the center of the cell back to the source pixel. */
+			cx = vx + (lens_hints[i].x + hint_sz / 2 - px) / zoom;
+			cy = vy + (lens_hints[i].y + hint_sz / 2 - py) / zoom;
+
+			platform->screen_clear(scr);
+			platform->mouse_move(scr, cx + 1, cy + 1);
+			platform->mouse_move(scr, cx, cy);
+			if (platform->trigger_ripple)
+				platform->trigger_ripple(scr, cx, cy);
+
+			strcpy(last_selected_hint, lens_hints[i].label);
+			hint_selected = 1;
+			rc = 0;
+			break;
+		}
+	}
+
+	platform->input_ungrab_keyboard();
+	platform->screen_clear(scr);
+	platform->mouse_show();
+	platform->commit();
+
+out:
+	free(cap);
+	free(view);
+	free(zoomed);
+
+	return rc;
+}
+
 static int sift()
 {
 	int gap = config_get_int("hint2_gap_size");
@@ -242,7 +643,22 @@ static int sift()
 	size_t n = 0;
 	screen_t scr;
 
-	struct hint hints[MAX_HINTS];
+	struct hint *hints;
+
+	const int zoom = config_get_int("hint2_lens_zoom");
+
+	/* Falls back to the plain grid if the lens can't be shown. */
+	if (zoom > 1 && platform->screen_capture &&
+	    platform->screen_draw_image) {
+		int rc = lens_sift(zoom);
+
+		if (rc != 1)
+			return rc;
+	}
+
+	/* At most one for each character. */
+	if (!(hints = hint_buf_reserve(&candidates, chars_len)))
+		return -1;
 
 	screen_get_cursor(&scr, &x, &y, 1);
 	platform->screen_get_dimensions(scr, &sw, &sh);
@@ -289,17 +705,19 @@ int hintspec_mode()
 	int w, h;
 
 	int n = 0;
-	struct hint hints[MAX_HINTS];
+	struct hint *hints;
 
 	screen_get_cursor(&scr, NULL, NULL, 0);
 	platform->screen_get_dimensions(scr, &sw, &sh);
 
 	get_hint_size(scr, &w, &h);
 
-	n = platform->collect_interactable_hints(scr, hints, MAX_HINTS);
+	n = targets_collect(scr, &candidates);
 	if (!n)
 		return -1;
 
+	hints = candidates.hints;
+
 	for (size_t i = 0; i < n; i++) {
 		int max_x = sw - w;
 		int max_y = sh - h;
@@ -326,14 +744,16 @@ int full_hint_mode(int second_pass)
 {
 	int mx, my;
 	screen_t scr;
-	struct hint hints[MAX_HINTS];
+	struct hint *hints;
+	size_t n;
 
 	screen_get_cursor(&scr, &mx, &my, 0);
 	hist_add(mx, my);
 
-	nr_hints = generate_fullscreen_hints(scr, hints);
+	if (!(n = generate_fullscreen_hints(scr, &hints)))
+		return -1;
 
-	if (hint_selection(scr, hints, nr_hints))
+	if (hint_selection(scr, hints, n))
 		return -1;
 
 	if (second_pass)
@@ -342,16 +762,18 @@ int full_hint_mode(int second_pass)
 		return 0;
 }
 
-static int find_hint_mode_once()
+/* Hints shown during the previous sticky find iteration. */
+static struct hint_buf prev_find_hints;
+static size_t nr_prev_find_hints;
+static screen_t prev_find_screen;
+
+static int find_hint_mode_once(int stable)
 {
 	int w, h;
 	int sw, sh;
 	size_t n = 0;
 	screen_t scr;
-	struct hint hints[MAX_HINTS];
-
-	if (!platform->collect_interactable_hints)
-		return -1;
+	struct hint *hints;
 
 	screen_t prev_screen = screen_get_active();
 	screen_clear_active();
@@ -359,12 +781,14 @@ static int find_hint_mode_once()
 	platform->screen_get_dimensions(scr, &sw, &sh);
 	get_hint_size(scr, &w, &h);
 
-	n = platform->collect_interactable_hints(scr, hints, MAX_HINTS);
+	n = targets_collect(scr, &candidates);
 	if (!n) {
 		screen_set_active(prev_screen);
 		return -1;
 	}
 
+	hints = candidates.hints;
+
 	for (size_t i = 0; i < n; i++) {
 		int max_x = sw - w;
 		int max_y = sh - h;
@@ -383,17 +807,45 @@ static int find_hint_mode_once()
 	}
 
 	screen_set_active(prev_screen);
-	generate_hint_labels(hints, n, config_get("hint_chars"));
+
+	if (!stable) {
+		generate_hint_labels(hints, n, config_get("hint_chars"));
+		return hint_selection(scr, hints, n);
+	}
+
+	if (scr != prev_find_screen)
+		nr_prev_find_hints = 0;
+
+	/*
+	 * Keep the labels of targets which survived the last click and
+	 * order hints by label, so an unchanged target set yields an
+	 * identical hint array (which backends can redraw from cache).
+	 */
+	generate_stable_hint_labels(hints, n, prev_find_hints.hints,
+				    nr_prev_find_hints, MIN(w, h) / 2,
+				    config_get("hint_chars"));
+	qsort(hints, n, sizeof hints[0], hint_label_cmp);
+
+	/* Labels are simply not carried over if they can't be stored. */
+	if (hint_buf_reserve(&prev_find_hints, n)) {
+		memcpy(prev_find_hints.hints, hints, n * sizeof hints[0]);
+		nr_prev_find_hints = n;
+		prev_find_screen = scr;
+	} else {
+		nr_prev_find_hints = 0;
+	}
 
 	return hint_selection(scr, hints, n);
 }
 
-int find_hint_mode() { return find_hint_mode_once(); }
+int find_hint_mode() { return find_hint_mode_once(0); }
 
 int find_hint_mode_sticky()
 {
+	nr_prev_find_hints = 0;
+
 	while (1) {
-		if (find_hint_mode_once() < 0)
+		if (find_hint_mode_once(1) < 0)
 			return -1;
 		if (hint_selected) {
 			screen_t scr;
@@ -412,9 +864,44 @@ int find_hint_mode_sticky()
 	return 0;
 }
 
+int text_hint_mode()
+{
+	int w, h;
+	int sw, sh;
+	size_t n = 0;
+	screen_t scr;
+	struct hint *hints;
+
+	screen_get_cursor(&scr, NULL, NULL, 0);
+	platform->screen_get_dimensions(scr, &sw, &sh);
+	get_hint_size(scr, &w, &h);
+
+	n = ocr_collect_words(scr, &candidates);
+	if (!n)
+		return -1;
+
+	hints = candidates.hints;
+
+	for (size_t i = 0; i < n; i++) {
+		int max_x = MAX(0, sw - w);
+		int max_y = MAX(0, sh - h);
+		int x = hints[i].x - w / 2;
+		int y = hints[i].y - h / 2;
+
+		hints[i].w = w;
+		hints[i].h = h;
+		hints[i].x = MIN(max_x, x < 0 ? 0 : x);
+		hints[i].y = MIN(max_y, y < 0 ? 0 : y);
+	}
+
+	generate_hint_labels(hints, n, config_get("hint_chars"));
+
+	return hint_selection(scr, hints, n);
+}
+
 int history_hint_mode()
 {
-	struct hint hints[MAX_HINTS];
+	struct hint hints[MAX_HIST_ENTS];
 	struct histfile_ent *ents;
 	screen_t scr;
 	int w, h;
@@ -424,7 +911,8 @@ int history_hint_mode()
 	screen_get_cursor(&scr, NULL, NULL, 0);
 	platform->screen_get_dimensions(scr, &sw, &sh);
 
-	n = histfile_read(&ents);
+	/* The count comes from disk. */
+	n = MIN(histfile_read(&ents), MAX_HIST_ENTS);
 
 	get_hint_size(scr, &w, &h);
 
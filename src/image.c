@@ -0,0 +1,590 @@
+/*
+ * warpd - A modal keyboard-driven pointing system.
+ *
+ * © 2019 Raheman Vaiya (see: LICENSE).
+ */
+
+/*
+ * Image primitives shared by the features which operate on screen captures.
+ * The hot loops have SSE2 implementations (with scalar fallbacks), and
+ * are split into row bands which run on all available cores.
+ */
+
+#include "warpd.h"
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#ifndef WINDOWS
+#include <pthread.h>
+#endif
+
+#define MAX_THREADS 16
+
+struct band {
+	void (*fn)(void *arg, int y0, int y1);
+	void *arg;
+
+	int y0;
+	int y1;
+};
+
+#ifndef WINDOWS
+static void *band_thread(void *arg)
+{
+	struct band *b = arg;
+
+	b->fn(b->arg, b->y0, b->y1);
+	return NULL;
+}
+#endif
+
+void image_parallel_rows(int h, int min_rows,
+			 void (*fn)(void *arg, int y0, int y1), void *arg)
+{
+#ifndef WINDOWS
+	static int nr_cpus = 0;
+
+	pthread_t threads[MAX_THREADS];
+	struct band bands[MAX_THREADS];
+	int started[MAX_THREADS] = {0};
+	int n, i;
+
+	if (!nr_cpus) {
+		long v = sysconf(_SC_NPROCESSORS_ONLN);
+		nr_cpus = v < 1 ? 1 : MIN(v, MAX_THREADS);
+	}
+
+	n = MAX(1, MIN(nr_cpus, h / MAX(1, min_rows)));
+
+	for (i = 0; i < n; i++) {
+		bands[i].fn = fn;
+		bands[i].arg = arg;
+		bands[i].y0 = (h * i) / n;
+		bands[i].y1 = (h * (i + 1)) / n;
+	}
+
+	for (i = 1; i < n; i++)
+		started[i] =
+		    !pthread_create(&threads[i], NULL, band_thread, &bands[i]);
+
+	/* Run the first band (and any which failed to start) on this thread. */
+	fn(arg, bands[0].y0, bands[0].y1);
+	for (i = 1; i < n; i++) {
+		if (started[i])
+			pthread_join(threads[i], NULL);
+		else
+			fn(arg, bands[i].y0, bands[i].y1);
+	}
+#else
+	fn(arg, 0, h);
+#endif
+}
+
+/* Luma (BT.601, 8 bit fixed point) of XRGB pixels. */
+static void luma_row(const uint32_t *px, uint8_t *out, int w)
+{
+	int x = 0;
+
+#ifdef __SSE2__
+	const __m128i mask = _mm_set1_epi32(0xff);
+	const __m128i kr = _mm_set1_epi16(77);
+	const __m128i kg = _mm_set1_epi16(150);
+	const __m128i kb = _mm_set1_epi16(29);
+
+	for (; x + 16 <= w; x += 16) {
+		__m128i r[2], g[2], b[2], y[2];
+		int i;
+
+		for (i = 0; i < 2; i++) {
+			__m128i p0 = _mm_loadu_si128(
+			    (const __m128i *)(px + x + i * 8));
+			__m128i p1 = _mm_loadu_si128(
+			    (const __m128i *)(px + x + i * 8 + 4));
+
+			r[i] = _mm_packs_epi32(
+			    _mm_and_si128(_mm_srli_epi32(p0, 16), mask),
+			    _mm_and_si128(_mm_srli_epi32(p1, 16), mask));
+			g[i] = _mm_packs_epi32(
+			    _mm_and_si128(_mm_srli_epi32(p0, 8), mask),
+			    _mm_and_si128(_mm_srli_epi32(p1, 8), mask));
+			b[i] = _mm_packs_epi32(_mm_and_si128(p0, mask),
+					       _mm_and_si128(p1, mask));
+
+			/* The sum never exceeds 0xff00, so 16 bit lanes suffice. */
+			y[i] = _mm_srli_epi16(
+			    _mm_add_epi16(
+				_mm_add_epi16(_mm_mullo_epi16(r[i], kr),
+					      _mm_mullo_epi16(g[i], kg)),
+				_mm_mullo_epi16(b[i], kb)),
+			    8);
+		}
+
+		_mm_storeu_si128((__m128i *)(out + x),
+				 _mm_packus_epi16(y[0], y[1]));
+	}
+#endif
+
+	for (; x < w; x++) {
+		uint32_t p = px[x];
+
+		out[x] = (((p >> 16) & 0xff) * 77 + ((p >> 8) & 0xff) * 150 +
+			  (p & 0xff) * 29) >>
+			 8;
+	}
+}
+
+struct luma_job {
+	const uint32_t *pixels;
+	uint8_t *luma;
+	int w;
+};
+
+static void luma_band(void *arg, int y0, int y1)
+{
+	struct luma_job *job = arg;
+	int y;
+
+	for (y = y0; y < y1; y++)
+		luma_row(job->pixels + (size_t)y * job->w,
+			 job->luma + (size_t)y * job->w, job->w);
+}
+
+void image_luma(const uint32_t *pixels, uint8_t *luma, int w, int h)
+{
+	struct luma_job job = {pixels, luma, w};
+
+	image_parallel_rows(h, 64, luma_band, &job);
+}
+
+/*
+ * Mark pixels whose gradient magnitude (approximated by the sum of
+ * absolute central differences) exceeds threshold with 0xff.
+ */
+static void edge_row(const uint8_t *up, const uint8_t *row,
+		     const uint8_t *down, uint8_t *out, int w, int threshold)
+{
+	int x = 1;
+
+#ifdef __SSE2__
+	const __m128i t = _mm_set1_epi8((char)threshold);
+	const __m128i zero = _mm_setzero_si128();
+
+	for (; x + 16 < w; x += 16) {
+		__m128i l = _mm_loadu_si128((const __m128i *)(row + x - 1));
+		__m128i r = _mm_loadu_si128((const __m128i *)(row + x + 1));
+		__m128i u = _mm_loadu_si128((const __m128i *)(up + x));
+		__m128i d = _mm_loadu_si128((const __m128i *)(down + x));
+
+		__m128i gx = _mm_or_si128(_mm_subs_epu8(l, r),
+					  _mm_subs_epu8(r, l));
+		__m128i gy = _mm_or_si128(_mm_subs_epu8(u, d),
+					  _mm_subs_epu8(d, u));
+		__m128i mag = _mm_adds_epu8(gx, gy);
+
+		/* mag > t <=> saturating mag - t is non zero */
+		__m128i below = _mm_cmpeq_epi8(_mm_subs_epu8(mag, t), zero);
+
+		_mm_storeu_si128((__m128i *)(out + x),
+				 _mm_andnot_si128(below, _mm_set1_epi8(-1)));
+	}
+#endif
+
+	for (; x < w - 1; x++) {
+		int gx = abs(row[x + 1] - row[x - 1]);
+		int gy = abs(down[x] - up[x]);
+
+		out[x] = gx + gy > threshold ? 0xff : 0;
+	}
+
+	out[0] = 0;
+	if (w > 1)
+		out[w - 1] = 0;
+}
+
+struct edge_job {
+	const uint8_t *luma;
+	uint8_t *edges;
+	int w;
+	int h;
+	int threshold;
+};
+
+static void edge_band(void *arg, int y0, int y1)
+{
+	struct edge_job *job = arg;
+	const int w = job->w;
+	int y;
+
+	for (y = y0; y < y1; y++) {
+		uint8_t *out = job->edges + (size_t)y * w;
+
+		if (y == 0 || y == job->h - 1) {
+			memset(out, 0, w);
+			continue;
+		}
+
+		edge_row(job->luma + (size_t)(y - 1) * w,
+			 job->luma + (size_t)y * w,
+			 job->luma + (size_t)(y + 1) * w, out, w,
+			 job->threshold);
+	}
+}
+
+void image_edges(const uint8_t *luma, uint8_t *edges, int w, int h,
+		 int threshold)
+{
+	struct edge_job job = {luma, edges, w, h, MIN(255, threshold)};
+
+	image_parallel_rows(h, 64, edge_band, &job);
+}
+
+struct reduce_job {
+	const uint8_t *edges;
+	uint8_t *cells;
+	int w;
+	int h;
+	int cell;
+};
+
+static void reduce_band(void *arg, int y0, int y1)
+{
+	struct reduce_job *job = arg;
+	const int cw = job->w / job->cell;
+	int cy, cx, y, x;
+
+	for (cy = y0; cy < y1; cy++) {
+		uint8_t *out = job->cells + (size_t)cy * cw;
+
+		memset(out, 0, cw);
+
+		for (y = cy * job->cell; y < (cy + 1) * job->cell; y++) {
+			const uint8_t *row = job->edges + (size_t)y * job->w;
+
+			for (cx = 0; cx < cw; cx++) {
+				const uint8_t *p = row + cx * job->cell;
+
+				for (x = 0; x < job->cell && !out[cx]; x++)
+					out[cx] |= p[x];
+			}
+		}
+	}
+}
+
+void image_reduce(const uint8_t *edges, uint8_t *cells, int w, int h, int cell)
+{
+	struct reduce_job job = {edges, cells, w, h, cell};
+
+	image_parallel_rows(h / cell, 16, reduce_band, &job);
+}
+
+/*
+ * Capture the given region of the screen as luma. Returns NULL on failure,
+ * the result must be freed by the caller.
+ */
+uint8_t *image_capture_luma(screen_t scr, int x, int y, int w, int h)
+{
+	uint32_t *pixels;
+	uint8_t *luma;
+
+	if (!platform->screen_capture || w <= 0 || h <= 0)
+		return NULL;
+
+	pixels = malloc((size_t)w * h * sizeof *pixels);
+	luma = malloc((size_t)w * h);
+
+	if (!pixels || !luma ||
+	    platform->screen_capture(scr, x, y, w, h, pixels)) {
+		free(pixels);
+		free(luma);
+		return NULL;
+	}
+
+	image_luma(pixels, luma, w, h);
+	free(pixels);
+
+	return luma;
+}
+
+/* Expects a binary (P5/P6) netpbm file with a maxval of 255. */
+static uint8_t *load_pnm(FILE *fh, int *w, int *h)
+{
+	char magic[3] = {0};
+	int maxval;
+	int channels;
+	size_t i, n;
+	uint8_t *data, *luma;
+
+	if (fscanf(fh, "%2s %d %d %d", magic, w, h, &maxval) != 4 ||
+	    maxval != 255 || *w <= 0 || *h <= 0 || fgetc(fh) == EOF)
+		return NULL;
+
+	if (!strcmp(magic, "P5"))
+		channels = 1;
+	else if (!strcmp(magic, "P6"))
+		channels = 3;
+	else
+		return NULL;
+
+	n = (size_t)*w * *h;
+	data = malloc(n * channels);
+
+	if (!data || fread(data, channels, n, fh) != n) {
+		free(data);
+		return NULL;
+	}
+
+	if (channels == 1)
+		return data;
+
+	luma = malloc(n);
+	for (i = 0; luma && i < n; i++)
+		luma[i] = (data[i * 3] * 77 + data[i * 3 + 1] * 150 +
+			   data[i * 3 + 2] * 29) >>
+			  8;
+
+	free(data);
+	return luma;
+}
+
+#ifdef WARPD_PNG
+#include <png.h>
+
+static uint8_t *load_png(const char *path, int *w, int *h)
+{
+	png_image img;
+	uint8_t *luma;
+
+	memset(&img, 0, sizeof img);
+	img.version = PNG_IMAGE_VERSION;
+
+	if (!png_image_begin_read_from_file(&img, path))
+		return NULL;
+
+	img.format = PNG_FORMAT_GRAY;
+
+	if (!(luma = malloc(PNG_IMAGE_SIZE(img))) ||
+	    !png_image_finish_read(&img, NULL, luma, 0, NULL)) {
+		png_image_free(&img);
+		free(luma);
+		return NULL;
+	}
+
+	*w = img.width;
+	*h = img.height;
+
+	return luma;
+}
+#endif
+
+/*
+ * Load an image file (PNG or binary netpbm) as luma. Returns NULL on
+ * failure, the result must be freed by the caller.
+ */
+uint8_t *image_load_luma(const char *path, int *w, int *h)
+{
+	uint8_t sig[8] = {0};
+	uint8_t *luma = NULL;
+	FILE *fh = fopen(path, "rb");
+
+	if (!fh)
+		return NULL;
+
+	if (fread(sig, 1, sizeof sig, fh) == sizeof sig &&
+	    !memcmp(sig, "\x89PNG", 4)) {
+		fclose(fh);
+
+#ifdef WARPD_PNG
+		return load_png(path, w, h);
+#else
+		fprintf(stderr, "warpd was built without PNG support\n");
+		return NULL;
+#endif
+	}
+
+	rewind(fh);
+	luma = load_pnm(fh, w, h);
+	fclose(fh);
+
+	return luma;
+}
+
+/* Halve the dimensions of an image (2x2 box filter). */
+uint8_t *image_downsample(const uint8_t *src, int w, int h, int *ow, int *oh)
+{
+	uint8_t *dst;
+	int x, y;
+
+	*ow = w / 2;
+	*oh = h / 2;
+
+	if (!*ow || !*oh || !(dst = malloc((size_t)*ow * *oh)))
+		return NULL;
+
+	for (y = 0; y < *oh; y++) {
+		const uint8_t *r0 = src + (size_t)(y * 2) * w;
+		const uint8_t *r1 = r0 + w;
+		uint8_t *out = dst + (size_t)y * *ow;
+
+		x = 0;
+#ifdef __SSE2__
+		for (; x + 16 <= *ow; x += 16) {
+			__m128i a = _mm_avg_epu8(
+			    _mm_loadu_si128((const __m128i *)(r0 + x * 2)),
+			    _mm_loadu_si128((const __m128i *)(r1 + x * 2)));
+			__m128i b = _mm_avg_epu8(
+			    _mm_loadu_si128((const __m128i *)(r0 + x * 2 + 16)),
+			    _mm_loadu_si128((const __m128i *)(r1 + x * 2 + 16)));
+			__m128i mask = _mm_set1_epi16(0xff);
+
+			/* Average horizontally adjacent pairs. */
+			__m128i ea = _mm_and_si128(a, mask);
+			__m128i oa = _mm_srli_epi16(a, 8);
+			__m128i eb = _mm_and_si128(b, mask);
+			__m128i ob = _mm_srli_epi16(b, 8);
+
+			_mm_storeu_si128(
+			    (__m128i *)(out + x),
+			    _mm_avg_epu8(_mm_packus_epi16(ea, eb),
+					 _mm_packus_epi16(oa, ob)));
+		}
+#endif
+		for (; x < *ow; x++)
+			out[x] = (r0[x * 2] + r0[x * 2 + 1] + r1[x * 2] +
+				  r1[x * 2 + 1] + 2) /
+				 4;
+	}
+
+	return dst;
+}
+
+struct zoom_job {
+	const uint32_t *src;
+	uint32_t *dst;
+	int w;
+	int zoom;
+};
+
+static void zoom_band(void *arg, int y0, int y1)
+{
+	struct zoom_job *job = arg;
+	const int dw = job->w * job->zoom;
+	int x, y, i;
+
+	for (y = y0; y < y1; y++) {
+		const uint32_t *in = job->src + (size_t)y * job->w;
+		uint32_t *out = job->dst + (size_t)y * job->zoom * dw;
+
+		for (x = 0; x < job->w; x++) {
+			uint32_t *p = out + x * job->zoom;
+
+			i = 0;
+#ifdef __SSE2__
+			{
+				const __m128i v = _mm_set1_epi32(in[x]);
+
+				for (; i + 4 <= job->zoom; i += 4)
+					_mm_storeu_si128((__m128i *)(p + i), v);
+			}
+#endif
+			for (; i < job->zoom; i++)
+				p[i] = in[x];
+		}
+
+		for (i = 1; i < job->zoom; i++)
+			memcpy(out + (size_t)i * dw, out, dw * sizeof *out);
+	}
+}
+
+/*
+ * Magnify XRGB pixels by an integer factor (nearest neighbour, so the
+ * boundaries between source pixels remain visible). dst must hold
+ * w*zoom*h*zoom pixels.
+ */
+void image_zoom(const uint32_t *src, uint32_t *dst, int w, int h, int zoom)
+{
+	struct zoom_job job = {src, dst, w, zoom};
+
+	image_parallel_rows(h, 16, zoom_band, &job);
+}
+
+/* Blend two XRGB pixels, t is the weight of b in 256ths. */
+static uint32_t lerp(uint32_t a, uint32_t b, uint32_t t)
+{
+	const uint32_t rb = ((a & 0xff00ff) * (256 - t) +
+			     (b & 0xff00ff) * t) >> 8;
+	const uint32_t g = ((a & 0xff00) * (256 - t) + (b & 0xff00) * t) >> 8;
+
+	return (rb & 0xff00ff) | (g & 0xff00);
+}
+
+/*
+ * The source pixel to the left of (above) the center of destination pixel
+ * i, along with the weight of its successor in 256ths.
+ */
+static void bilinear_sample(int i, int zoom, int n, int *s, uint32_t *t)
+{
+	const int f = (2 * i + 1) * 128 / zoom - 128;
+
+	if (f < 0) {
+		*s = 0;
+		*t = 0;
+	} else if ((f >> 8) >= n - 1) {
+		*s = n - 1;
+		*t = 0;
+	} else {
+		*s = f >> 8;
+		*t = f & 255;
+	}
+}
+
+struct bilinear_job {
+	const uint32_t *src;
+	uint32_t *dst;
+	int w;
+	int h;
+	int zoom;
+};
+
+static void bilinear_band(void *arg, int y0, int y1)
+{
+	struct bilinear_job *job = arg;
+	const int dw = job->w * job->zoom;
+	int x, y;
+
+	for (y = y0; y < y1; y++) {
+		const uint32_t *r0, *r1;
+		uint32_t *out = job->dst + (size_t)y * dw;
+		uint32_t ty;
+		int sy;
+
+		bilinear_sample(y, job->zoom, job->h, &sy, &ty);
+
+		r0 = job->src + (size_t)sy * job->w;
+		r1 = r0 + (sy + 1 < job->h ? job->w : 0);
+
+		for (x = 0; x < dw; x++) {
+			uint32_t tx;
+			int sx, nx;
+
+			bilinear_sample(x, job->zoom, job->w, &sx, &tx);
+			nx = MIN(sx + 1, job->w - 1);
+
+			out[x] = lerp(lerp(r0[sx], r0[nx], tx),
+				      lerp(r1[sx], r1[nx], tx), ty);
+		}
+	}
+}
+
+/*
+ * Like image_zoom, but interpolates between source pixels (smoother, at
+ * the expense of pixel boundaries).
+ */
+void image_zoom_bilinear(const uint32_t *src, uint32_t *dst, int w, int h,
+			 int zoom)
+{
+	struct bilinear_job job = {src, dst, w, h, zoom};
+
+	image_parallel_rows(h * zoom, 16, bilinear_band, &job);
+}
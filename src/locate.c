@@ -0,0 +1,403 @@
+/*
+ * warpd - A modal keyboard-driven pointing system.
+ *
+ * © 2019 Raheman Vaiya (see: LICENSE).
+ */
+
+/*
+ * Finds the on screen location of a template image (--locate) using
+ * normalized cross-correlation. The search is coarse to fine: every
+ * position is scored at the coarsest level of an image pyramid and only
+ * the best few candidates are refined at each finer level.
+ */
+
+#include "warpd.h"
+
+#include <math.h>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#define MAX_LEVELS 6
+
+/* The pyramid stops once the template is this small (area or side). */
+#define COARSE_AREA  64
+#define MIN_TEMPLATE 6
+
+#define NR_CANDIDATES 16
+#define REFINE_RADIUS 2
+
+struct level {
+	uint8_t *img;
+	int w;
+	int h;
+
+	/* Widened to 16 bits for the SIMD dot product. */
+	int16_t *tpl;
+	int tw;
+	int th;
+
+	int64_t tsum;
+	double tnorm;
+};
+
+struct candidate {
+	int x;
+	int y;
+	double score;
+};
+
+#ifdef __SSE2__
+static int32_t hsum(__m128i v)
+{
+	v = _mm_add_epi32(v, _mm_shuffle_epi32(v, _MM_SHUFFLE(1, 0, 3, 2)));
+	v = _mm_add_epi32(v, _mm_shuffle_epi32(v, _MM_SHUFFLE(2, 3, 0, 1)));
+
+	return _mm_cvtsi128_si32(v);
+}
+#endif
+
+/* The NCC between the template and the window at (x, y), in [-1, 1]. */
+static double score(const struct level *l, int x, int y)
+{
+	const int n = l->tw * l->th;
+	int64_t s = 0, ss = 0, dot = 0;
+	double var;
+	int tx, ty;
+
+	for (ty = 0; ty < l->th; ty++) {
+		const uint8_t *row = l->img + (size_t)(y + ty) * l->w + x;
+		const int16_t *t = l->tpl + (size_t)ty * l->tw;
+
+		tx = 0;
+#ifdef __SSE2__
+		{
+			const __m128i zero = _mm_setzero_si128();
+			const __m128i ones = _mm_set1_epi16(1);
+			__m128i vs = zero, vss = zero, vdot = zero;
+
+			/* Per row 32 bit accumulators cannot overflow. */
+			for (; tx + 8 <= l->tw; tx += 8) {
+				__m128i p = _mm_unpacklo_epi8(
+				    _mm_loadl_epi64((const __m128i *)(row + tx)),
+				    zero);
+				__m128i q =
+				    _mm_loadu_si128((const __m128i *)(t + tx));
+
+				vs = _mm_add_epi32(vs, _mm_madd_epi16(p, ones));
+				vss = _mm_add_epi32(vss, _mm_madd_epi16(p, p));
+				vdot = _mm_add_epi32(vdot, _mm_madd_epi16(p, q));
+			}
+
+			s += hsum(vs);
+			ss += hsum(vss);
+			dot += hsum(vdot);
+		}
+#endif
+		for (; tx < l->tw; tx++) {
+			s += row[tx];
+			ss += row[tx] * row[tx];
+			dot += row[tx] * t[tx];
+		}
+	}
+
+	var = (double)ss - (double)s * s / n;
+
+	/* Flat regions carry no information. */
+	if (var < 1)
+		return 0;
+
+	return ((double)dot - (double)s * l->tsum / n) / (sqrt(var) * l->tnorm);
+}
+
+static int set_template(struct level *l, const uint8_t *tpl, int tw, int th)
+{
+	const int n = tw * th;
+	int64_t ss = 0;
+	int i;
+
+	if (!(l->tpl = malloc((size_t)n * sizeof *l->tpl)))
+		return -1;
+
+	l->tw = tw;
+	l->th = th;
+	l->tsum = 0;
+
+	for (i = 0; i < n; i++) {
+		l->tpl[i] = tpl[i];
+		l->tsum += tpl[i];
+		ss += tpl[i] * tpl[i];
+	}
+
+	l->tnorm = sqrt((double)ss - (double)l->tsum * l->tsum / n);
+	return 0;
+}
+
+/*
+ * Build the template half of the pyramid. Level 0 is full resolution.
+ * Returns the number of levels or 0 on failure.
+ */
+static int build_template_pyramid(struct level *levels, uint8_t *tpl, int tw,
+				  int th)
+{
+	uint8_t *const original = tpl;
+	int n = 0;
+
+	while (1) {
+		uint8_t *next;
+		int nw, nh;
+
+		if (set_template(&levels[n], tpl, tw, th))
+			break;
+
+		n++;
+
+		if (n == MAX_LEVELS || tw * th <= COARSE_AREA ||
+		    tw / 2 < MIN_TEMPLATE || th / 2 < MIN_TEMPLATE)
+			break;
+
+		if (!(next = image_downsample(tpl, tw, th, &nw, &nh)))
+			break;
+
+		if (tpl != original)
+			free(tpl);
+
+		tpl = next;
+		tw = nw;
+		th = nh;
+	}
+
+	/* set_template copies, only the downsampled levels are ours. */
+	if (tpl != original)
+		free(tpl);
+
+	return n;
+}
+
+struct search_job {
+	const struct level *l;
+
+	double *row_score;
+	int *row_x;
+};
+
+static void search_band(void *arg, int y0, int y1)
+{
+	struct search_job *job = arg;
+	const struct level *l = job->l;
+	int x, y;
+
+	for (y = y0; y < y1; y++) {
+		job->row_score[y] = -1;
+
+		for (x = 0; x + l->tw <= l->w; x++) {
+			double s = score(l, x, y);
+
+			if (s > job->row_score[y]) {
+				job->row_score[y] = s;
+				job->row_x[y] = x;
+			}
+		}
+	}
+}
+
+static double *sort_scores;
+
+static int row_cmp(const void *a, const void *b)
+{
+	double sa = sort_scores[*(const int *)a];
+	double sb = sort_scores[*(const int *)b];
+
+	return sa < sb ? 1 : sa > sb ? -1 : 0;
+}
+
+/*
+ * Exhaustively score the coarsest level, keeping the best match of each row
+ * and then the best rows which do not overlap one another.
+ */
+static size_t coarse_search(const struct level *l, struct candidate *cands)
+{
+	const int rows = l->h - l->th + 1;
+	struct search_job job;
+	size_t n = 0;
+	int *order;
+	int i;
+	size_t j;
+
+	job.l = l;
+	job.row_score = malloc(rows * sizeof *job.row_score);
+	job.row_x = malloc(rows * sizeof *job.row_x);
+	order = malloc(rows * sizeof *order);
+
+	if (!job.row_score || !job.row_x || !order)
+		goto out;
+
+	image_parallel_rows(rows, 8, search_band, &job);
+
+	for (i = 0; i < rows; i++)
+		order[i] = i;
+
+	sort_scores = job.row_score;
+	qsort(order, rows, sizeof *order, row_cmp);
+
+	for (i = 0; i < rows && n < NR_CANDIDATES; i++) {
+		int x = job.row_x[order[i]];
+		int y = order[i];
+
+		for (j = 0; j < n; j++)
+			if (abs(cands[j].x - x) < l->tw &&
+			    abs(cands[j].y - y) < l->th)
+				break;
+
+		if (j == n)
+			cands[n++] = (struct candidate){x, y, job.row_score[y]};
+	}
+
+out:
+	free(job.row_score);
+	free(job.row_x);
+	free(order);
+
+	return n;
+}
+
+/* Search the neighbourhood of a candidate carried over from the next level. */
+static void refine(const struct level *l, struct candidate *c)
+{
+	const int x0 = MAX(0, c->x * 2 - REFINE_RADIUS);
+	const int y0 = MAX(0, c->y * 2 - REFINE_RADIUS);
+	const int x1 = MIN(l->w - l->tw, c->x * 2 + REFINE_RADIUS);
+	const int y1 = MIN(l->h - l->th, c->y * 2 + REFINE_RADIUS);
+	int x, y;
+
+	c->score = -1;
+
+	for (y = y0; y <= y1; y++)
+		for (x = x0; x <= x1; x++) {
+			double s = score(l, x, y);
+
+			if (s > c->score) {
+				c->score = s;
+				c->x = x;
+				c->y = y;
+			}
+		}
+}
+
+/* Returns the best match on the given screen. */
+static struct candidate search_screen(screen_t scr, struct level *levels,
+				      int nr_levels)
+{
+	struct candidate best = {0, 0, -1};
+	struct candidate cands[NR_CANDIDATES];
+	size_t nr_cands, i;
+	int sw, sh;
+	int n;
+
+	platform->screen_get_dimensions(scr, &sw, &sh);
+
+	if (sw < levels[0].tw || sh < levels[0].th)
+		return best;
+
+	if (!(levels[0].img = image_capture_luma(scr, 0, 0, sw, sh)))
+		return best;
+
+	levels[0].w = sw;
+	levels[0].h = sh;
+
+	for (n = 1; n < nr_levels; n++) {
+		struct level *l = &levels[n];
+
+		l->img = image_downsample(levels[n - 1].img, levels[n - 1].w,
+					  levels[n - 1].h, &l->w, &l->h);
+
+		if (!l->img || l->w < l->tw || l->h < l->th) {
+			free(l->img);
+			break;
+		}
+	}
+
+	nr_cands = coarse_search(&levels[n - 1], cands);
+
+	for (i = 0; i < nr_cands; i++) {
+		int j;
+
+		for (j = n - 2; j >= 0; j--)
+			refine(&levels[j], &cands[i]);
+
+		if (cands[i].score > best.score)
+			best = cands[i];
+	}
+
+	while (n--)
+		free(levels[n].img);
+
+	return best;
+}
+
+/*
+ * Find the template stored at path on any of the screens and return the
+ * center of the best match. Returns -1 if there is no sufficiently close
+ * match.
+ */
+int locate_template(const char *path, screen_t *scr, int *x, int *y)
+{
+	struct level levels[MAX_LEVELS] = {0};
+	screen_t screens[MAX_SCREENS];
+	struct candidate best = {0, 0, -1};
+	const double threshold = config_get_int("locate_threshold") / 100.0;
+	uint64_t start = get_time_us();
+	size_t nr_screens, i;
+	uint8_t *tpl;
+	int tw, th;
+	int nr_levels;
+	int ret = -1;
+
+	if (!platform->screen_capture) {
+		fprintf(stderr, "ERROR: screen capture is not supported on "
+				"this platform\n");
+		return -1;
+	}
+
+	if (!(tpl = image_load_luma(path, &tw, &th))) {
+		fprintf(stderr, "ERROR: failed to load %s\n", path);
+		return -1;
+	}
+
+	nr_levels = build_template_pyramid(levels, tpl, tw, th);
+	free(tpl);
+
+	if (!nr_levels || levels[0].tnorm < 1) {
+		fprintf(stderr, "ERROR: %s has no contrast\n", path);
+		goto out;
+	}
+
+	platform->screen_list(screens, &nr_screens);
+
+	for (i = 0; i < nr_screens; i++) {
+		struct candidate c = search_screen(screens[i], levels, nr_levels);
+
+		if (c.score > best.score) {
+			best = c;
+			*scr = screens[i];
+		}
+	}
+
+	if (getenv("WARPD_LOCATE_DEBUG"))
+		fprintf(stderr, "locate: %dx%d levels=%d score=%.3f ms=%.2f\n",
+			tw, th, nr_levels, best.score,
+			(get_time_us() - start) / 1000.0);
+
+	if (best.score >= threshold) {
+		*x = best.x + tw / 2;
+		*y = best.y + th / 2;
+		ret = 0;
+	}
+
+out:
+	for (i = 0; i < (size_t)nr_levels; i++)
+		free(levels[i].tpl);
+
+	return ret;
+}
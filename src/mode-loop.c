@@ -34,6 +34,8 @@ int mode_loop(int initial_mode, int oneshot, int record_history)
 				mode = MODE_FIND;
 			else if (config_input_match(ev, "find_sticky"))
 				mode = MODE_FIND_STICKY;
+			else if (config_input_match(ev, "text"))
+				mode = MODE_TEXT;
 			else if (config_input_match(ev, "grid"))
 				mode = MODE_GRID;
 			else if (config_input_match(ev, "screen"))
@@ -72,6 +74,13 @@ int mode_loop(int initial_mode, int oneshot, int record_history)
 			mode = MODE_NORMAL;
 			break;
 		}
+		case MODE_TEXT:
+			if (text_hint_mode() < 0)
+				goto exit;
+
+			ev = NULL;
+			mode = MODE_NORMAL;
+			break;
 		case MODE_HINT2:
 		case MODE_HINT:
 			if (full_hint_mode(mode == MODE_HINT2) < 0)
@@ -111,10 +120,18 @@ int mode_loop(int initial_mode, int oneshot, int record_history)
 			else
 				printf("%d %d\n", x, y);
 
+			fflush(stdout);
+
+			/* Nothing drives the scheduler once we return. */
+			anim_drain();
+
 			return btn;
 		}
 	}
 
 exit:
+	anim_clear_all();
+	platform->commit();
+
 	return rc;
 }
@@ -20,10 +20,33 @@ static int is_using_custom_cursor(void)
 	return 0;
 }
 
+/* Set if the cursor is the pointer image itself (see cursor_set_box). */
+static int hw_cursor;
+
+static struct scene_box *rapid_borders[4];
+static struct scene_box *cursor_box;
+static struct scene_box *indicator_box;
+
+static void init_scene()
+{
+	size_t i;
+
+	/* Boxes which couldn't be created are retried. */
+	for (i = 0; i < 4; i++)
+		if (!rapid_borders[i])
+			rapid_borders[i] = scene_box_create();
+
+	if (!cursor_box)
+		cursor_box = scene_box_create();
+	if (!indicator_box)
+		indicator_box = scene_box_create();
+}
+
 static void redraw(screen_t scr, int x, int y, int hide_cursor,
 		   int show_rapid_indicator)
 {
 	int sw, sh;
+	size_t i;
 
 	platform->screen_get_dimensions(scr, &sw, &sh);
 
@@ -35,56 +58,73 @@ static void redraw(screen_t scr, int x, int y, int hide_cursor,
 	const char *indicator = config_get("indicator");
 	const int cursz = config_get_int("cursor_size");
 
-	platform->screen_clear(scr);
+	const int border_width = config_get_int("rapid_indicator_width");
+	const char *border_color = config_get("rapid_indicator_color");
+
+	/* Custom cursors are drawn immediately on top of the scene. */
+	const int custom_cursor =
+	    !platform->box_create && platform->screen_draw_cursor;
+
+	init_scene();
+
+	if (show_rapid_indicator && border_width > 0 &&
+	    border_width * 2 < sw && border_width * 2 < sh) {
+		scene_box_set(rapid_borders[0], scr, 0, 0, sw, border_width,
+			      border_color);
+		scene_box_set(rapid_borders[1], scr, 0, sh - border_width, sw,
+			      border_width, border_color);
+		scene_box_set(rapid_borders[2], scr, 0, 0, border_width, sh,
+			      border_color);
+		scene_box_set(rapid_borders[3], scr, sw - border_width, 0,
+			      border_width, sh, border_color);
+	} else {
+		for (i = 0; i < 4; i++)
+			scene_box_hide(rapid_borders[i]);
+	}
 
-	if (show_rapid_indicator) {
-		const int border_width =
-		    config_get_int("rapid_indicator_width");
-		const char *border_color = config_get("rapid_indicator_color");
-
-		if (border_width > 0 && border_width * 2 < sw &&
-		    border_width * 2 < sh) {
-			platform->screen_draw_box(scr, 0, 0, sw, border_width,
-						  border_color);
-			platform->screen_draw_box(scr, 0, sh - border_width, sw,
-						  border_width, border_color);
-			platform->screen_draw_box(scr, 0, 0, border_width, sh,
-						  border_color);
-			platform->screen_draw_box(scr, sw - border_width, 0,
-						  border_width, sh,
-						  border_color);
-		}
+	if (hw_cursor) {
+		if (hide_cursor)
+			platform->mouse_hide();
+		else
+			platform->mouse_show();
 	}
 
-	if (!hide_cursor) {
+	if (!hide_cursor && !custom_cursor && !hw_cursor)
+		scene_box_set(cursor_box, scr, x + 1, y - cursz / 2, cursz,
+			      cursz, curcol);
+	else
+		scene_box_hide(cursor_box);
+
+	if (!strcmp(indicator, "bottomleft"))
+		scene_box_set(indicator_box, scr, gap,
+			      sh - indicator_size - gap, indicator_size,
+			      indicator_size, indicator_color);
+	else if (!strcmp(indicator, "topleft"))
+		scene_box_set(indicator_box, scr, gap, gap, indicator_size,
+			      indicator_size, indicator_color);
+	else if (!strcmp(indicator, "topright"))
+		scene_box_set(indicator_box, scr, sw - indicator_size - gap,
+			      gap, indicator_size, indicator_size,
+			      indicator_color);
+	else if (!strcmp(indicator, "bottomright"))
+		scene_box_set(indicator_box, scr, sw - indicator_size - gap,
+			      sh - indicator_size - gap, indicator_size,
+			      indicator_size, indicator_color);
+	else
+		scene_box_hide(indicator_box);
+
+	scene_commit(scr);
+
+	if (!hide_cursor && custom_cursor) {
 		/* Draw halo behind cursor when using custom cursor */
 		if (is_using_custom_cursor() && platform->screen_draw_halo)
 			platform->screen_draw_halo(scr, x, y);
 
-		int drawn = 0;
-		if (platform->screen_draw_cursor)
-			drawn = platform->screen_draw_cursor(scr, x, y);
-		if (!drawn)
+		if (!platform->screen_draw_cursor(scr, x, y))
 			platform->screen_draw_box(scr, x + 1, y - cursz / 2,
 						  cursz, cursz, curcol);
 	}
 
-	if (!strcmp(indicator, "bottomleft"))
-		platform->screen_draw_box(scr, gap, sh - indicator_size - gap,
-					  indicator_size, indicator_size,
-					  indicator_color);
-	else if (!strcmp(indicator, "topleft"))
-		platform->screen_draw_box(scr, gap, gap, indicator_size,
-					  indicator_size, indicator_color);
-	else if (!strcmp(indicator, "topright"))
-		platform->screen_draw_box(scr, sw - indicator_size - gap, gap,
-					  indicator_size, indicator_size,
-					  indicator_color);
-	else if (!strcmp(indicator, "bottomright"))
-		platform->screen_draw_box(
-		    scr, sw - indicator_size - gap, sh - indicator_size - gap,
-		    indicator_size, indicator_size, indicator_color);
-
 	platform->commit();
 }
 
@@ -99,6 +139,7 @@ struct input_event *normal_mode(struct input_event *start_ev, int oneshot)
 {
 	const int cursz = config_get_int("cursor_size");
 	const int system_cursor = config_get_int("normal_system_cursor");
+	const int snap = config_get_int("normal_snap");
 	const char *blink_interval = config_get("normal_blink_interval");
 
 	int on_time, off_time;
@@ -133,6 +174,7 @@ struct input_event *normal_mode(struct input_event *start_ev, int oneshot)
 	    "exit",
 	    "find",
 	    "find_sticky",
+	    "text",
 	    "grid",
 	    "hint",
 	    "hint2",
@@ -167,7 +209,10 @@ struct input_event *normal_mode(struct input_event *start_ev, int oneshot)
 	screen_get_cursor(&scr, &mx, &my, 1);
 	platform->screen_get_dimensions(scr, &sw, &sh);
 
-	if (!system_cursor)
+	hw_cursor = !system_cursor && platform->cursor_set_box &&
+		    !platform->cursor_set_box(config_get("cursor_color"), cursz);
+
+	if (!system_cursor && !hw_cursor)
 		platform->mouse_hide();
 
 	mouse_reset();
@@ -178,13 +223,18 @@ struct input_event *normal_mode(struct input_event *start_ev, int oneshot)
 
 	redraw(scr, mx, my, !show_cursor, rapid_mode);
 
+	if (snap)
+		snap_prepare(scr);
+
 	uint64_t time = 0;
 	uint64_t last_blink_update = 0;
 	while (1) {
 		config_input_whitelist(keys, sizeof keys / sizeof keys[0]);
 		if (start_ev == NULL) {
-			ev = platform->input_next_event(10);
-			time += 10;
+			const int timeout = anim_timeout(10);
+
+			ev = platform->input_next_event(timeout);
+			time += timeout;
 		} else {
 			ev = start_ev;
 			start_ev = NULL;
@@ -192,6 +242,9 @@ struct input_event *normal_mode(struct input_event *start_ev, int oneshot)
 
 		screen_get_cursor(&scr, &mx, &my, 0);
 
+		if (anim_tick())
+			platform->commit();
+
 		if (!system_cursor && on_time) {
 			if (show_cursor &&
 			    (time - last_blink_update) >= on_time) {
@@ -399,6 +452,8 @@ struct input_event *normal_mode(struct input_event *start_ev, int oneshot)
 		if (config_input_match(ev, "word_left")) {
 			int step = config_get_int("normal_large_step");
 			int nx = mx - step;
+			if (snap)
+				nx = snap_motion(scr, mx, my, -1, 0, nx);
 			const int minx = 1;
 			const int maxx = sw - cursz;
 			if (nx < minx)
@@ -409,6 +464,8 @@ struct input_event *normal_mode(struct input_event *start_ev, int oneshot)
 		} else if (config_input_match(ev, "word_right")) {
 			int step = config_get_int("normal_large_step");
 			int nx = mx + step;
+			if (snap)
+				nx = snap_motion(scr, mx, my, 1, 0, nx);
 			const int minx = 1;
 			const int maxx = sw - cursz;
 			if (nx < minx)
@@ -419,6 +476,8 @@ struct input_event *normal_mode(struct input_event *start_ev, int oneshot)
 		} else if (config_input_match(ev, "word_up")) {
 			int step = config_get_int("normal_large_step");
 			int ny = my - step;
+			if (snap)
+				ny = snap_motion(scr, mx, my, 0, -1, ny);
 			const int miny = 1;
 			const int maxy = sh - cursz;
 			if (ny < miny)
@@ -429,6 +488,8 @@ struct input_event *normal_mode(struct input_event *start_ev, int oneshot)
 		} else if (config_input_match(ev, "word_down")) {
 			int step = config_get_int("normal_large_step");
 			int ny = my + step;
+			if (snap)
+				ny = snap_motion(scr, mx, my, 0, 1, ny);
 			const int miny = 1;
 			const int maxy = sh - cursz;
 			if (ny < miny)
@@ -488,6 +549,7 @@ struct input_event *normal_mode(struct input_event *start_ev, int oneshot)
 		} else if (config_input_match(ev, "exit") ||
 			   config_input_match(ev, "find") ||
 			   config_input_match(ev, "find_sticky") ||
+			   config_input_match(ev, "text") ||
 			   config_input_match(ev, "grid") ||
 			   config_input_match(ev, "screen") ||
 			   config_input_match(ev, "history") ||
@@ -557,7 +619,11 @@ exit:
 		if (held_buttons[i])
 			platform->mouse_up(i);
 	}
+	if (hw_cursor)
+		platform->cursor_reset();
 	platform->mouse_show();
+	scene_clear();
+	scene_commit(scr);
 	platform->screen_clear(scr);
 
 	platform->input_ungrab_keyboard();
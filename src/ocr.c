@@ -0,0 +1,298 @@
+/*
+ * warpd - A modal keyboard-driven pointing system.
+ *
+ * © 2019 Raheman Vaiya (see: LICENSE).
+ */
+
+/*
+ * Locates the words on screen for text hint mode. Recognised words are
+ * cached per screen, subsequent activations only re-recognise the regions
+ * which have been damaged in the meantime.
+ */
+
+#include "warpd.h"
+
+#ifdef WARPD_OCR
+#include <tesseract/capi.h>
+#endif
+
+/* Words with a lower confidence (0-100) are discarded. */
+#define MIN_CONFIDENCE 50
+
+/* Re-recognise everything once this fraction (%) of the screen is damaged. */
+#define FULL_THRESHOLD 50
+
+struct word {
+	int x;
+	int y;
+	int w;
+	int h;
+};
+
+struct rect {
+	int x0, y0;
+	int x1, y1;
+};
+
+struct ocr_cache {
+	screen_t scr;
+	int valid;
+
+	struct word *words;
+	size_t nr_words;
+	size_t sz;
+};
+
+static struct ocr_cache caches[MAX_SCREENS];
+static size_t nr_caches = 0;
+
+static struct ocr_cache *get_cache(screen_t scr)
+{
+	size_t i;
+
+	for (i = 0; i < nr_caches; i++)
+		if (caches[i].scr == scr)
+			return &caches[i];
+
+	if (nr_caches == MAX_SCREENS)
+		return NULL;
+
+	caches[nr_caches].scr = scr;
+	return &caches[nr_caches++];
+}
+
+static int word_intersects(const struct word *w, const struct rect *r)
+{
+	return w->x < r->x1 && w->x + w->w > r->x0 && w->y < r->y1 &&
+	       w->y + w->h > r->y0;
+}
+
+#ifdef WARPD_OCR
+static TessBaseAPI *api = NULL;
+
+static void add_word(struct ocr_cache *c, int x, int y, int w, int h)
+{
+	if (c->nr_words == c->sz) {
+		size_t sz = c->sz ? c->sz * 2 : 256;
+		struct word *words = realloc(c->words, sz * sizeof *words);
+
+		if (!words)
+			return;
+
+		c->words = words;
+		c->sz = sz;
+	}
+
+	c->words[c->nr_words++] = (struct word){x, y, w, h};
+}
+
+static int init_engine()
+{
+	static int failed = 0;
+
+	if (api || failed)
+		return api ? 0 : -1;
+
+	api = TessBaseAPICreate();
+
+	if (TessBaseAPIInit3(api, NULL, config_get("text_language"))) {
+		fprintf(stderr, "ERROR: failed to initialize tesseract (%s)\n",
+			config_get("text_language"));
+
+		TessBaseAPIDelete(api);
+		api = NULL;
+		failed = 1;
+		return -1;
+	}
+
+	/* UI text is scattered rather than laid out in columns. */
+	TessBaseAPISetPageSegMode(api, PSM_SPARSE_TEXT);
+	return 0;
+}
+
+/* Recognise the words within the given region (screen coordinates). */
+static void recognize(struct ocr_cache *c, const struct rect *r)
+{
+	TessResultIterator *it;
+	const int w = r->x1 - r->x0;
+	const int h = r->y1 - r->y0;
+	uint8_t *luma;
+
+	if (init_engine())
+		return;
+
+	if (!(luma = image_capture_luma(c->scr, r->x0, r->y0, w, h)))
+		return;
+
+	TessBaseAPISetImage(api, luma, w, h, 1, w);
+	TessBaseAPISetSourceResolution(api, 96);
+
+	if (!TessBaseAPIRecognize(api, NULL) &&
+	    (it = TessBaseAPIGetIterator(api))) {
+		TessPageIterator *pit = TessResultIteratorGetPageIterator(it);
+
+		do {
+			int x0, y0, x1, y1;
+
+			if (TessResultIteratorConfidence(it, RIL_WORD) <
+				MIN_CONFIDENCE ||
+			    !TessPageIteratorBoundingBox(pit, RIL_WORD, &x0,
+							 &y0, &x1, &y1))
+				continue;
+
+			add_word(c, r->x0 + x0, r->y0 + y0, x1 - x0, y1 - y0);
+		} while (TessResultIteratorNext(it, RIL_WORD));
+
+		TessResultIteratorDelete(it);
+	}
+
+	free(luma);
+}
+#else
+static void recognize(struct ocr_cache *c, const struct rect *r)
+{
+	static int warned = 0;
+
+	if (!warned)
+		fprintf(stderr, "warpd was built without OCR support (see "
+				"ENABLE_OCR)\n");
+	warned = 1;
+}
+#endif
+
+/*
+ * Group dirty tiles into rectangles: horizontal runs within each row,
+ * which are then merged with any rectangle they touch.
+ */
+static size_t dirty_rects(const uint8_t *tiles, int cols, int rows,
+			  struct rect *rects, size_t max)
+{
+	size_t n = 0;
+	size_t i, j;
+	int merged;
+	int r, c;
+
+	for (r = 0; r < rows; r++)
+		for (c = 0; c < cols; c++) {
+			int c0 = c;
+
+			if (!tiles[r * cols + c])
+				continue;
+
+			while (c + 1 < cols && tiles[r * cols + c + 1])
+				c++;
+
+			if (n == max)
+				return 0;
+
+			rects[n++] = (struct rect){c0, r, c + 1, r + 1};
+		}
+
+	do {
+		merged = 0;
+
+		for (i = 0; i < n; i++)
+			for (j = i + 1; j < n; j++) {
+				struct rect *a = &rects[i];
+				struct rect *b = &rects[j];
+
+				if (a->x0 > b->x1 || b->x0 > a->x1 ||
+				    a->y0 > b->y1 || b->y0 > a->y1)
+					continue;
+
+				a->x0 = MIN(a->x0, b->x0);
+				a->y0 = MIN(a->y0, b->y0);
+				a->x1 = MAX(a->x1, b->x1);
+				a->y1 = MAX(a->y1, b->y1);
+
+				rects[j--] = rects[--n];
+				merged = 1;
+			}
+	} while (merged);
+
+	return n;
+}
+
+/* Re-recognise a damaged region along with any words it cuts through. */
+static void update_region(struct ocr_cache *c, struct rect r, int sw, int sh)
+{
+	size_t i;
+
+	r.x0 *= DAMAGE_TILE;
+	r.y0 *= DAMAGE_TILE;
+	r.x1 = MIN(sw, r.x1 * DAMAGE_TILE);
+	r.y1 = MIN(sh, r.y1 * DAMAGE_TILE);
+
+	for (i = 0; i < c->nr_words; i++) {
+		const struct word *w = &c->words[i];
+
+		if (word_intersects(w, &r)) {
+			r.x0 = MIN(r.x0, w->x);
+			r.y0 = MIN(r.y0, w->y);
+			r.x1 = MAX(r.x1, w->x + w->w);
+			r.y1 = MAX(r.y1, w->y + w->h);
+		}
+	}
+
+	for (i = 0; i < c->nr_words; i++)
+		if (word_intersects(&c->words[i], &r))
+			c->words[i--] = c->words[--c->nr_words];
+
+	recognize(c, &r);
+}
+
+/*
+ * Populate buf (grown as needed) with the center points of the words on
+ * the given screen.
+ */
+size_t ocr_collect_words(screen_t scr, struct hint_buf *buf)
+{
+	static struct rect rects[256];
+
+	struct ocr_cache *c = get_cache(scr);
+	uint8_t *tiles;
+	int cols, rows;
+	int sw, sh;
+	size_t nr_dirty, nr_rects, i;
+	uint64_t start = get_time_us();
+
+	if (!c)
+		return 0;
+
+	platform->screen_get_dimensions(scr, &sw, &sh);
+	damage_get_dimensions(scr, &cols, &rows);
+
+	if (!(tiles = malloc(cols * rows)))
+		return 0;
+
+	nr_dirty = damage_get(scr, DAMAGE_OCR, tiles);
+	nr_rects = dirty_rects(tiles, cols, rows, rects,
+			       sizeof rects / sizeof rects[0]);
+
+	if (!c->valid || nr_dirty * 100 > (size_t)(cols * rows) * FULL_THRESHOLD ||
+	    (nr_dirty && !nr_rects)) {
+		c->nr_words = 0;
+		recognize(c, &(struct rect){0, 0, sw, sh});
+		c->valid = 1;
+	} else {
+		for (i = 0; i < nr_rects; i++)
+			update_region(c, rects[i], sw, sh);
+	}
+
+	free(tiles);
+
+	if (getenv("WARPD_OCR_DEBUG"))
+		fprintf(stderr, "ocr: dirty=%zu/%d regions=%zu words=%zu ms=%.2f\n",
+			nr_dirty, cols * rows, nr_rects, c->nr_words,
+			(get_time_us() - start) / 1000.0);
+
+	if (!hint_buf_reserve(buf, c->nr_words))
+		return 0;
+
+	for (i = 0; i < c->nr_words; i++) {
+		buf->hints[i].x = c->words[i].x + c->words[i].w / 2;
+		buf->hints[i].y = c->words[i].y + c->words[i].h / 2;
+	}
+
+	return i;
+}
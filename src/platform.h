@@ -20,7 +20,6 @@
 #define SCROLL_LEFT  3
 #define SCROLL_UP    4
 
-#define MAX_HINTS   2048
 #define MAX_SCREENS 32
 
 struct input_event {
@@ -42,6 +41,26 @@ struct hint {
 struct screen;
 typedef struct screen *screen_t;
 
+struct screen_rect {
+	screen_t scr;
+
+	int x;
+	int y;
+	int w;
+	int h;
+};
+
+/* An animated circle outline (see anim.c). */
+struct ring {
+	int x;
+	int y;
+	int radius;
+	int line_width;
+
+	/* Premultiplied ARGB (see raster_color). */
+	uint32_t color;
+};
+
 struct platform {
 	/* Input */
 
@@ -83,11 +102,79 @@ struct platform {
 	void (*mouse_hide)();
 
 	void (*screen_get_dimensions)(screen_t scr, int *w, int *h);
+
+	/*
+	 * Obtain the geometry of the focused window in screen coordinates,
+	 * clipped to the supplied screen. Returns 0 on success. May be NULL.
+	 */
+	int (*screen_get_focused_window)(screen_t scr, int *x, int *y, int *w,
+					 int *h);
 	void (*screen_draw_box)(screen_t scr, int x, int y, int w, int h,
 				const char *color);
 	int (*screen_draw_cursor)(screen_t scr, int x, int y);
+
+	/*
+	 * Replace the pointer image with a box of the given color and size
+	 * (the normal mode cursor) which then follows the pointer without
+	 * being redrawn. Returns 0 on success. Undone by cursor_reset. May be
+	 * NULL.
+	 */
+	int (*cursor_set_box)(const char *color, int size);
+	void (*cursor_reset)();
+
+	/*
+	 * Retained boxes which remain on screen until changed or hidden, so
+	 * only boxes which change need to be sent to the display server
+	 * (see scene.c). Changes take effect on commit(). Independent of
+	 * screen_clear. May be NULL, in which case the scene is redrawn with
+	 * screen_clear and screen_draw_box.
+	 */
+	void *(*box_create)();
+	void (*box_update)(void *box, screen_t scr, int x, int y, int w, int h,
+			   const char *color);
+	void (*box_hide)(void *box);
+
+	/*
+	 * Like box_update, but the box becomes the union of the given
+	 * rectangles (e.g the lines of a grid), which are drawn as a single
+	 * surface. Must be provided along with box_create.
+	 */
+	void (*box_update_rects)(void *box, screen_t scr,
+				 const struct screen_rect *rects, size_t n,
+				 const char *color);
 	void (*screen_clear_ripples)(screen_t scr);
 
+	/*
+	 * Capture a region (relative to the screen) as XRGB pixels (w*h
+	 * pixels, no padding). Must be safe to call from any thread.
+	 * Returns 0 on success. May be NULL.
+	 */
+	int (*screen_capture)(screen_t scr, int x, int y, int w, int h,
+			      uint32_t *pixels);
+
+	/*
+	 * Drain the regions (relative to each screen) which have changed
+	 * since the previous call. Returns the number of rectangles, or -1 if
+	 * the changes are unknown (e.g on the first call), in which case
+	 * everything should be considered changed. Must be safe to call from
+	 * any thread. May be NULL.
+	 */
+	int (*screen_poll_damage)(struct screen_rect *rects, size_t max);
+
+	/*
+	 * Block for up to timeout ms or until new damage may be available
+	 * from screen_poll_damage (spurious wakeups are fine). May be NULL.
+	 */
+	void (*screen_wait_damage)(int timeout);
+
+	/*
+	 * Draw XRGB pixels (w*h pixels, no padding) at the given position.
+	 * The image sits below any hints and is removed by screen_clear. May
+	 * be NULL.
+	 */
+	void (*screen_draw_image)(screen_t scr, int x, int y, int w, int h,
+				  const uint32_t *pixels);
+
 	void (*screen_clear)(screen_t scr);
 	void (*screen_list)(screen_t scr[MAX_SCREENS], size_t *n);
 
@@ -108,15 +195,41 @@ struct platform {
 	size_t (*collect_interactable_hints)(screen_t scr, struct hint *hints,
 					     size_t max_hints);
 
+	/*
+	 * Identify the focused window along with a counter which changes
+	 * whenever the targets within it may have moved (focus, configure,
+	 * damage or accessibility events). Must be safe to call from any
+	 * thread, collect_interactable_hints is then assumed to be as well.
+	 * Returns 0 on success. May be NULL (disables target caching).
+	 */
+	int (*target_state)(uint64_t *window, uint64_t *generation);
+
 	void (*scroll)(int direction);
 	void (*scroll_amount)(int direction, int amount);
 
 	/* Emulate a key tap (press and release) with optional modifiers */
 	void (*key_tap)(uint8_t code, uint8_t mods);
 
+	/*
+	 * Animated effects. Platforms which can draw rings need not
+	 * implement these, the shared scheduler (see anim.c) is then used.
+	 */
 	void (*trigger_ripple)(screen_t scr, int x, int y);
 	int (*has_active_ripples)(screen_t scr);
 
+	/*
+	 * Replace the rings shown on scr with the given ones. Only the area
+	 * within the damaged rectangles (which bound both the old and the
+	 * new rings) needs to be redrawn. Takes effect on commit(). May be
+	 * NULL.
+	 */
+	void (*screen_draw_rings)(screen_t scr, const struct ring *rings,
+				  size_t n, const struct screen_rect *damage,
+				  size_t nr_damage);
+
+	/* The refresh rate of scr in mHz, or 0 if unknown. May be NULL. */
+	int (*screen_get_refresh_rate)(screen_t scr);
+
 	/* Cursor visual effects (for non-default cursor styles) */
 	void (*screen_draw_halo)(screen_t scr, int x, int y);
 	void (*trigger_entry_pulse)(screen_t scr, int x, int y);
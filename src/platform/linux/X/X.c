@@ -6,8 +6,87 @@
 
 #include "X.h"
 
+#ifdef WARPD_ATSPI
+#include "../atspi/atspi.h"
+#endif
+
 Display *dpy = NULL;
 
+/*
+ * Connections used by background threads, or requests which may fail (see
+ * x_ignore_errors). The error handler is process wide, so it is installed
+ * once rather than swapped around individual requests.
+ */
+static pthread_mutex_t quiet_mtx = PTHREAD_MUTEX_INITIALIZER;
+static Display *quiet_displays[8];
+static int quiet_errors[8];
+static size_t nr_quiet_displays = 0;
+static int (*default_xerr)(Display *, XErrorEvent *) = NULL;
+
+static int xerr(Display *d, XErrorEvent *ev)
+{
+	size_t i;
+
+	pthread_mutex_lock(&quiet_mtx);
+	for (i = 0; i < nr_quiet_displays; i++)
+		if (quiet_displays[i] == d) {
+			quiet_errors[i] = 1;
+			pthread_mutex_unlock(&quiet_mtx);
+			return 0;
+		}
+	pthread_mutex_unlock(&quiet_mtx);
+
+	return default_xerr ? default_xerr(d, ev) : 0;
+}
+
+/*
+ * Ignore protocol errors on the given connection (e.g windows which vanish
+ * while they are being inspected).
+ */
+void x_ignore_errors(Display *d)
+{
+	pthread_mutex_lock(&quiet_mtx);
+	if (nr_quiet_displays < sizeof quiet_displays / sizeof quiet_displays[0])
+		quiet_displays[nr_quiet_displays++] = d;
+	pthread_mutex_unlock(&quiet_mtx);
+}
+
+/* Stop ignoring errors on d, e.g once a request which may fail is done. */
+void x_unignore_errors(Display *d)
+{
+	size_t i;
+
+	pthread_mutex_lock(&quiet_mtx);
+	for (i = 0; i < nr_quiet_displays; i++)
+		if (quiet_displays[i] == d) {
+			nr_quiet_displays--;
+			quiet_displays[i] = quiet_displays[nr_quiet_displays];
+			quiet_errors[i] = quiet_errors[nr_quiet_displays];
+			break;
+		}
+	pthread_mutex_unlock(&quiet_mtx);
+}
+
+/*
+ * Returns non-zero if an error was ignored on d (see x_ignore_errors) since
+ * the last call. Callers should XSync() first.
+ */
+int x_take_error(Display *d)
+{
+	size_t i;
+	int err = 0;
+
+	pthread_mutex_lock(&quiet_mtx);
+	for (i = 0; i < nr_quiet_displays; i++)
+		if (quiet_displays[i] == d) {
+			err = quiet_errors[i];
+			quiet_errors[i] = 0;
+		}
+	pthread_mutex_unlock(&quiet_mtx);
+
+	return err;
+}
+
 struct monitored_file monitored_files[32];
 size_t nr_monitored_files = 0;
 
@@ -46,28 +125,6 @@ int hex_to_rgba(const char *str, uint8_t *r, uint8_t *g, uint8_t *b, uint8_t *a)
 	return 0;
 }
 
-uint32_t parse_xcolor(const char *s, uint8_t *opacity)
-{
-	XColor col;
-
-	uint8_t r, g, b, a;
-
-	hex_to_rgba(s, &r, &g, &b, &a);
-
-	if (opacity)
-		*opacity = a;
-
-	col.red = (int)r << 8;
-	col.green = (int)g << 8;
-	col.blue = (int)b << 8;
-	col.flags = DoRed | DoGreen | DoBlue;
-
-	assert(
-	    XAllocColor(dpy, XDefaultColormap(dpy, DefaultScreen(dpy)), &col));
-
-	return col.pixel;
-}
-
 /*
  * Disable shadows for compton based compositors.
  *
@@ -223,10 +280,24 @@ void x_scroll_amount(int direction, int amount)
 	XSync(dpy, False);
 }
 
+/* Mark the window as one of ours (see damage.c) and disable shadows. */
+static void label_window(Window win)
+{
+	XClassHint *hint;
+
+	disable_compton_shadow(dpy, win);
+
+	hint = XAllocClassHint();
+	hint->res_name = "warpd";
+	hint->res_class = "warpd";
+	XSetClassHint(dpy, win, hint);
+
+	XFree(hint);
+}
+
 Window create_window(const char *color)
 {
 	uint32_t col = 0;
-	XClassHint *hint;
 	uint8_t opacity;
 
 	col = parse_xcolor(color, &opacity);
@@ -246,19 +317,44 @@ Window create_window(const char *color)
 	/* Requires a compositor. */
 	set_opacity(dpy, win, opacity);
 
-	disable_compton_shadow(dpy, win);
+	label_window(win);
 
-	hint = XAllocClassHint();
-	hint->res_name = "warpd";
-	hint->res_class = "warpd";
-	XSetClassHint(dpy, win, hint);
+	return win;
+}
 
-	XFree(hint);
+/*
+ * Create a transparent 32 bit (ARGB) window covering the given area which
+ * lets input pass through to the windows below it.
+ */
+Window create_argb_window(Visual *visual, int x, int y, int w, int h)
+{
+	Colormap cmap =
+	    XCreateColormap(dpy, DefaultRootWindow(dpy), visual, AllocNone);
+
+	Window win = XCreateWindow(
+	    dpy, DefaultRootWindow(dpy), x, y, w, h, 0, 32, InputOutput,
+	    visual,
+	    CWOverrideRedirect | CWBackPixel | CWBorderPixel | CWColormap,
+	    &(XSetWindowAttributes){
+		.background_pixel = 0,
+		.border_pixel = 0,
+		.colormap = cmap,
+		.override_redirect = 1,
+	    });
+
+	XShapeCombineRectangles(dpy, win, ShapeInput, 0, 0, NULL, 0, ShapeSet,
+				Unsorted);
+
+	label_window(win);
 
 	return win;
 }
 
-void x_commit() { XSync(dpy, False); }
+void x_commit()
+{
+	x_overlay_present();
+	XSync(dpy, False);
+}
 
 long x_get_mtime(const char *path)
 {
@@ -285,6 +381,16 @@ void x_monitor_file(const char *path)
 	nr_monitored_files++;
 }
 
+#ifdef WARPD_ATSPI
+static size_t x_collect_interactable_hints(struct screen *scr,
+					   struct hint *hints,
+					   size_t max_hints)
+{
+	return atspi_collect_interactable_hints(scr->x, scr->y, scr->w, scr->h,
+						hints, max_hints);
+}
+#endif
+
 void x_init(struct platform *platform)
 {
 	dpy = XOpenDisplay(NULL);
@@ -296,11 +402,20 @@ void x_init(struct platform *platform)
 	/* TODO: account for screen hotplugging */
 	init_xscreens();
 
+	default_xerr = XSetErrorHandler(xerr);
+
+	init_xcursor();
+
 	platform->monitor_file = x_monitor_file;
 	platform->commit = x_commit;
 	platform->copy_selection = x_copy_selection;
 	platform->hint_draw = x_hint_draw;
+#ifdef WARPD_ATSPI
+	platform->collect_interactable_hints = x_collect_interactable_hints;
+#else
 	platform->collect_interactable_hints = NULL;
+#endif
+	platform->target_state = x_target_state;
 	platform->init_hint = x_init_hint;
 	platform->input_grab_keyboard = x_input_grab_keyboard;
 	platform->input_lookup_code = x_input_lookup_code;
@@ -322,10 +437,24 @@ void x_init(struct platform *platform)
 	platform->screen_clear_ripples = NULL;
 	platform->screen_draw_box = x_screen_draw_box;
 	platform->screen_draw_cursor = NULL;
+	platform->cursor_set_box = x_cursor_set_box;
+	platform->cursor_reset = x_cursor_reset;
+	platform->box_create = x_box_create;
+	platform->box_update = x_box_update;
+	platform->box_hide = x_box_hide;
+	platform->box_update_rects = x_box_update_rects;
+	platform->screen_capture = x_screen_capture;
+	platform->screen_poll_damage = x_screen_poll_damage;
+	platform->screen_wait_damage = x_screen_wait_damage;
+	platform->screen_draw_image = x_screen_draw_image;
 	platform->screen_get_dimensions = x_screen_get_dimensions;
+	platform->screen_get_focused_window = x_screen_get_focused_window;
 	platform->screen_list = x_screen_list;
 	platform->scroll = x_scroll;
 	platform->scroll_amount = x_scroll_amount;
-	platform->trigger_ripple = NULL;     // TODO: Implement ripple for X11
-	platform->has_active_ripples = NULL; // TODO: Implement ripple for X11
+	platform->screen_draw_rings = x_screen_draw_rings;
+	platform->screen_get_refresh_rate = x_screen_get_refresh_rate;
+	/* Provided by anim.c. */
+	platform->trigger_ripple = NULL;
+	platform->has_active_ripples = NULL;
 }
@@ -15,27 +15,34 @@
 #include <X11/Xlib.h>
 #include <X11/Xutil.h>
 #include <X11/extensions/XInput2.h>
+#include <X11/extensions/XShm.h>
 #include <X11/extensions/XTest.h>
 #include <X11/extensions/Xfixes.h>
 #include <X11/extensions/Xinerama.h>
+#include <X11/extensions/Xrandr.h>
+#include <X11/extensions/Xrender.h>
 #include <X11/extensions/shape.h>
 #include <X11/keysym.h>
 #include <assert.h>
 #include <ctype.h>
 #include <libgen.h>
+#include <limits.h>
+#include <pthread.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/shm.h>
 #include <sys/time.h>
 #include <unistd.h>
 
-#define MAX_BOXES 64
-
 struct box {
 	Window win;
 	char color[32];
 	int mapped;
+
+	/* Set by x_box_update_rects. */
+	int shaped;
 };
 
 struct screen {
@@ -46,18 +53,39 @@ struct screen {
 	int w;
 	int h;
 
+	/* In mHz, 0 if unknown (see init_xscreens). */
+	int refresh_rate;
+
+	/* Hint windows and pixmaps, created on first use (see hint.c). */
 	Pixmap buf;
 
+	/* Shared with the server (see hint.c), created on first use. */
+	XImage *shm_img;
+	XShmSegmentInfo shm_info;
+	int shm_failed;
+
 	Window hintwin;
 
+	/* Created on first use. */
+	Window imagewin;
+
 	Window cached_hintwin;
 	Pixmap cached_hintbuf;
 
-	struct hint cached_hints[MAX_HINTS];
+	/* Grown as needed (see hint.c). */
+	struct hint *cached_hints;
 	size_t nr_cached_hints;
+	size_t cached_hints_sz;
 
-	struct box boxes[MAX_BOXES];
+	/* The hints hintwin currently displays (see hint.c). */
+	struct hint *shaped_hints;
+	size_t nr_shaped_hints;
+	size_t shaped_hints_sz;
+
+	/* Windows are created as boxes are first drawn. */
+	struct box *boxes;
 	size_t nr_boxes;
+	size_t boxes_sz;
 };
 
 struct monitored_file {
@@ -66,20 +94,33 @@ struct monitored_file {
 };
 
 Window create_window(const char *color);
+Window create_argb_window(Visual *visual, int x, int y, int w, int h);
 
 int hex_to_rgba(const char *str, uint8_t *r, uint8_t *g, uint8_t *b,
 		uint8_t *a);
-uint32_t parse_xcolor(const char *s, uint8_t *opacity);
 void init_xscreens();
+void init_xcursor();
+
+uint32_t parse_xcolor(const char *s, uint8_t *opacity);
+XftColor *x_xft_color(const char *s);
+XftFont *x_font(const char *name, int height);
+XftDraw *x_xft_draw(Drawable drw);
+GC x_gc(unsigned long fg, int line_width);
+void x_resources_flush();
+void x_resources_report();
 
 /* Globals. */
 extern Display *dpy;
 
-extern struct screen xscreens[32];
+/* One for each Xinerama screen (see init_xscreens). */
+extern struct screen *xscreens;
 extern size_t nr_xscreens;
 extern uint8_t x_active_mods;
 
 void x_init();
+void x_ignore_errors(Display *d);
+void x_unignore_errors(Display *d);
+int x_take_error(Display *d);
 
 void x_input_grab_keyboard();
 void x_input_ungrab_keyboard();
@@ -97,10 +138,31 @@ void x_mouse_click(int btn);
 void x_mouse_get_position(screen_t *scr, int *x, int *y);
 void x_mouse_show();
 void x_mouse_hide();
+int x_cursor_set_box(const char *color, int size);
+void x_cursor_reset();
 void x_screen_get_dimensions(screen_t scr, int *w, int *h);
+int x_screen_get_refresh_rate(screen_t scr);
+int x_target_state(uint64_t *window, uint64_t *gen);
+int x_screen_poll_damage(struct screen_rect *rects, size_t max);
+void x_damage_drain();
+void x_screen_wait_damage(int timeout);
+int x_screen_capture(struct screen *scr, int x, int y, int w, int h,
+		     uint32_t *pixels);
 void x_screen_draw_box(screen_t scr, int x, int y, int w, int h,
 		       const char *color);
+void x_screen_draw_image(screen_t scr, int x, int y, int w, int h,
+			 const uint32_t *pixels);
 void x_screen_clear(screen_t scr);
+void x_screen_draw_rings(screen_t scr, const struct ring *rings, size_t n,
+			 const struct screen_rect *damage, size_t nr_damage);
+void *x_box_create();
+void x_box_update(void *box, screen_t scr, int x, int y, int w, int h,
+		  const char *color);
+void x_box_hide(void *box);
+void x_box_update_rects(void *box, screen_t scr,
+			const struct screen_rect *rects, size_t n,
+			const char *color);
+int x_screen_get_focused_window(screen_t scr, int *x, int *y, int *w, int *h);
 void x_screen_list(screen_t scr[MAX_SCREENS], size_t *n);
 void x_init_hint(const char *bg, const char *fg, int border_radius,
 		 const char *border_color, int border_width,
@@ -110,6 +172,22 @@ void x_scroll(int direction);
 void x_scroll_amount(int direction, int amount);
 void x_copy_selection();
 void x_commit();
+
+int x_overlay_enabled();
+void x_overlay_draw_box(struct screen *scr, int x, int y, int w, int h,
+			const char *color);
+void x_overlay_clear(struct screen *scr);
+void x_overlay_draw_rings(struct screen *scr, const struct ring *rings,
+			  size_t n, const struct screen_rect *damage,
+			  size_t nr_damage);
+void *x_overlay_box_create();
+void x_overlay_box_update(void *box, struct screen *scr, int x, int y, int w,
+			  int h, const char *color);
+void x_overlay_box_hide(void *box);
+void x_overlay_box_update_rects(void *box, struct screen *scr,
+				const struct screen_rect *rects, size_t n,
+				const char *color);
+void x_overlay_present();
 void x_monitor_file(const char *path);
 long x_get_mtime(const char *path);
 
@@ -0,0 +1,156 @@
+/*
+ * warpd - A modal keyboard-driven pointing system.
+ *
+ * © 2019 Raheman Vaiya (see: LICENSE).
+ */
+
+#include "X.h"
+
+#include <X11/extensions/XShm.h>
+#include <sys/ipc.h>
+#include <sys/shm.h>
+
+/*
+ * Screen capture via MIT-SHM (falling back to XGetImage). Like targets.c
+ * this uses a private connection so it may be called from any thread.
+ */
+
+static pthread_mutex_t mtx = PTHREAD_MUTEX_INITIALIZER;
+
+static Display *cdpy = NULL;
+static int use_shm = 0;
+
+static XImage *img = NULL;
+static XShmSegmentInfo shminfo;
+
+static void destroy_shm_image()
+{
+	if (!img)
+		return;
+
+	XShmDetach(cdpy, &shminfo);
+	XDestroyImage(img);
+	shmdt(shminfo.shmaddr);
+
+	img = NULL;
+}
+
+/* The segment is retained between calls of the same size. */
+static XImage *get_shm_image(int w, int h)
+{
+	int scr = DefaultScreen(cdpy);
+
+	if (img && img->width == w && img->height == h)
+		return img;
+
+	destroy_shm_image();
+
+	img = XShmCreateImage(cdpy, DefaultVisual(cdpy, scr),
+			      DefaultDepth(cdpy, scr), ZPixmap, NULL, &shminfo,
+			      w, h);
+	if (!img)
+		return NULL;
+
+	shminfo.shmid = shmget(IPC_PRIVATE, img->bytes_per_line * img->height,
+			       IPC_CREAT | 0600);
+	if (shminfo.shmid == -1) {
+		XDestroyImage(img);
+		img = NULL;
+		return NULL;
+	}
+
+	shminfo.shmaddr = img->data = shmat(shminfo.shmid, NULL, 0);
+	shminfo.readOnly = False;
+
+	/* Freed once both ends have detached. */
+	shmctl(shminfo.shmid, IPC_RMID, NULL);
+
+	if (shminfo.shmaddr == (void *)-1) {
+		img->data = NULL;
+		XDestroyImage(img);
+		img = NULL;
+		return NULL;
+	}
+
+	x_take_error(cdpy);
+	XShmAttach(cdpy, &shminfo);
+	XSync(cdpy, False);
+
+	/* E.g remote displays, which still advertise MIT-SHM. */
+	if (x_take_error(cdpy)) {
+		shmdt(shminfo.shmaddr);
+		img->data = NULL;
+		XDestroyImage(img);
+		img = NULL;
+		use_shm = 0;
+		return NULL;
+	}
+
+	return img;
+}
+
+static void copy_pixels(XImage *src, uint32_t *pixels, int w, int h)
+{
+	int x, y;
+
+	if (src->bits_per_pixel == 32 && src->red_mask == 0xff0000 &&
+	    src->green_mask == 0xff00 && src->blue_mask == 0xff) {
+		for (y = 0; y < h; y++)
+			memcpy(pixels + (size_t)y * w,
+			       src->data + (size_t)y * src->bytes_per_line,
+			       w * sizeof *pixels);
+		return;
+	}
+
+	/* Slow path for unusual visuals. */
+	for (y = 0; y < h; y++)
+		for (x = 0; x < w; x++) {
+			unsigned long p = XGetPixel(src, x, y);
+			uint8_t r = (p & src->red_mask) * 255 / src->red_mask;
+			uint8_t g =
+			    (p & src->green_mask) * 255 / src->green_mask;
+			uint8_t b = (p & src->blue_mask) * 255 / src->blue_mask;
+
+			pixels[(size_t)y * w + x] = r << 16 | g << 8 | b;
+		}
+}
+
+int x_screen_capture(struct screen *scr, int x, int y, int w, int h,
+		     uint32_t *pixels)
+{
+	int ret = -1;
+	XImage *src;
+
+	if (x < 0 || y < 0 || w <= 0 || h <= 0 || x + w > scr->w ||
+	    y + h > scr->h)
+		return -1;
+
+	pthread_mutex_lock(&mtx);
+
+	if (!cdpy) {
+		if (!(cdpy = XOpenDisplay(NULL)))
+			goto out;
+
+		x_ignore_errors(cdpy);
+
+		use_shm = XShmQueryExtension(cdpy);
+	}
+
+	if (use_shm && (src = get_shm_image(w, h))) {
+		if (XShmGetImage(cdpy, DefaultRootWindow(cdpy), src,
+				 scr->x + x, scr->y + y, AllPlanes)) {
+			copy_pixels(src, pixels, w, h);
+			ret = 0;
+		}
+	} else if ((src = XGetImage(cdpy, DefaultRootWindow(cdpy),
+				    scr->x + x, scr->y + y, w, h, AllPlanes,
+				    ZPixmap))) {
+		copy_pixels(src, pixels, w, h);
+		XDestroyImage(src);
+		ret = 0;
+	}
+
+out:
+	pthread_mutex_unlock(&mtx);
+	return ret;
+}
@@ -0,0 +1,190 @@
+/*
+ * warpd - A modal keyboard-driven pointing system.
+ *
+ * © 2019 Raheman Vaiya (see: LICENSE).
+ */
+
+#include "X.h"
+
+#include <X11/Xcursor/Xcursor.h>
+#include <signal.h>
+
+/*
+ * The normal mode cursor as an actual (ARGB) pointer image, which the
+ * server moves with the pointer without any intervention on our part. X
+ * has no way to override the pointer globally, so the named cursors which
+ * most clients obtain from the cursor theme are replaced in place
+ * (XFixesChangeCursorByName) and restored from the theme afterwards.
+ *
+ * Since the change outlives us, the theme is also restored at startup (in
+ * case a previous instance was killed), at exit and on SIGINT/SIGTERM.
+ */
+
+static const char *names[] = {
+    "left_ptr", "default",  "arrow", "top_left_arrow", "xterm", "text",
+    "hand1",    "hand2",    "pointer", "watch",	   "progress", "crosshair",
+};
+
+/* Names which the theme provides (and can hence be restored). */
+static uint8_t themed[sizeof names / sizeof names[0]];
+
+static int active = 0;
+
+static void init_themed()
+{
+	const char *theme = XcursorGetTheme(dpy);
+	const int size = XcursorGetDefaultSize(dpy);
+	size_t i;
+
+	for (i = 0; i < sizeof names / sizeof names[0]; i++) {
+		XcursorImages *images =
+		    XcursorLibraryLoadImages(names[i], theme, size);
+
+		themed[i] = images != NULL;
+
+		if (images)
+			XcursorImagesDestroy(images);
+	}
+}
+
+/*
+ * Freshly loaded cursors carry the original image, and are named by
+ * Xcursor, so they are changed along with the rest.
+ */
+static void restore(Display *d)
+{
+	size_t i;
+
+	for (i = 0; i < sizeof names / sizeof names[0]; i++) {
+		Cursor cursor;
+
+		if (!themed[i])
+			continue;
+
+		if ((cursor = XcursorLibraryLoadCursor(d, names[i]))) {
+			XFixesChangeCursorByName(d, cursor, names[i]);
+			XFreeCursor(d, cursor);
+		}
+	}
+
+	XSync(d, False);
+}
+
+/*
+ * Waits for SIGINT/SIGTERM (blocked in every other thread), restores the
+ * cursors on a private connection (dpy may be in use) and then dies of the
+ * signal as it would have.
+ */
+static void *signal_thread(void *arg)
+{
+	sigset_t *set = arg;
+	Display *sdpy;
+	int sig;
+
+	if (sigwait(set, &sig))
+		return NULL;
+
+	if ((sdpy = XOpenDisplay(NULL))) {
+		restore(sdpy);
+		XCloseDisplay(sdpy);
+	}
+
+	signal(sig, SIG_DFL);
+	pthread_sigmask(SIG_UNBLOCK, set, NULL);
+	raise(sig);
+
+	return NULL;
+}
+
+static void cleanup()
+{
+	x_cursor_reset();
+}
+
+/* Expects to be called before any other thread is started. */
+void init_xcursor()
+{
+	static sigset_t set;
+	pthread_t tid;
+
+	init_themed();
+	restore(dpy);
+
+	atexit(cleanup);
+
+	sigemptyset(&set);
+	sigaddset(&set, SIGINT);
+	sigaddset(&set, SIGTERM);
+
+	if (pthread_sigmask(SIG_BLOCK, &set, NULL))
+		return;
+
+	if (pthread_create(&tid, NULL, signal_thread, &set))
+		pthread_sigmask(SIG_UNBLOCK, &set, NULL);
+	else
+		pthread_detach(tid);
+}
+
+/*
+ * Replace the pointer with a size x size box of the given color positioned
+ * where normal mode would draw it (see redraw() in normal.c).
+ */
+int x_cursor_set_box(const char *color, int size)
+{
+	uint8_t r = 0, g = 0, b = 0, a = 255;
+	unsigned int best_w, best_h;
+	XcursorImage *img;
+	Cursor cursor;
+	uint32_t pixel;
+	int x, y;
+	size_t i;
+
+	if (!config_get_int("x_hardware_cursor") || size <= 0 ||
+	    !XcursorSupportsARGB(dpy))
+		return -1;
+
+	/* Too large for the server, fall back to a window. */
+	XQueryBestCursor(dpy, DefaultRootWindow(dpy), size + 1, size, &best_w,
+			 &best_h);
+	if ((int)best_w < size + 1 || (int)best_h < size)
+		return -1;
+
+	hex_to_rgba(color, &r, &g, &b, &a);
+
+	/* Premultiplied ARGB. */
+	pixel = a << 24 | (r * a / 255) << 16 | (g * a / 255) << 8 |
+		(b * a / 255);
+
+	/* The box starts one pixel to the right of the hotspot. */
+	if (!(img = XcursorImageCreate(size + 1, size)))
+		return -1;
+
+	img->xhot = 0;
+	img->yhot = size / 2;
+
+	for (y = 0; y < size; y++)
+		for (x = 0; x < size + 1; x++)
+			img->pixels[y * (size + 1) + x] = x ? pixel : 0;
+
+	cursor = XcursorImageLoadCursor(dpy, img);
+	XcursorImageDestroy(img);
+
+	for (i = 0; i < sizeof names / sizeof names[0]; i++)
+		if (themed[i])
+			XFixesChangeCursorByName(dpy, cursor, names[i]);
+
+	XFreeCursor(dpy, cursor);
+	XSync(dpy, False);
+
+	active = 1;
+	return 0;
+}
+
+void x_cursor_reset()
+{
+	if (!active)
+		return;
+
+	restore(dpy);
+	active = 0;
+}
@@ -0,0 +1,374 @@
+/*
+ * warpd - A modal keyboard-driven pointing system.
+ *
+ * © 2019 Raheman Vaiya (see: LICENSE).
+ */
+
+#include "X.h"
+
+#include <X11/extensions/Xdamage.h>
+
+/*
+ * Screen damage tracking. Rather than monitoring the root window (which
+ * would include our own overlays), a damage object is attached to each
+ * top level window and changes to the stacking (map/unmap/move) are
+ * recorded separately. Windows belonging to warpd are ignored. Uses a
+ * private connection so it may be called from any thread.
+ */
+
+#define MAX_TOPLEVELS 512
+#define MAX_PENDING   256
+
+struct toplevel {
+	Window win;
+	Damage damage;
+
+	int x;
+	int y;
+	int w;
+	int h;
+
+	int mapped;
+	int damaged;
+
+	/* -1 until known (the class hint may not yet be set at creation). */
+	int ours;
+};
+
+static pthread_mutex_t mtx = PTHREAD_MUTEX_INITIALIZER;
+
+static Display *ddpy = NULL;
+static int failed = 0;
+static int damage_event_base;
+static XserverRegion parts;
+
+static struct toplevel toplevels[MAX_TOPLEVELS];
+static size_t nr_toplevels = 0;
+
+/* In root coordinates. */
+static XRectangle pending[MAX_PENDING];
+static size_t nr_pending = 0;
+static int overflow = 0;
+
+static void add_pending(int x, int y, int w, int h)
+{
+	if (w <= 0 || h <= 0)
+		return;
+
+	if (nr_pending == MAX_PENDING) {
+		overflow = 1;
+		return;
+	}
+
+	pending[nr_pending].x = x;
+	pending[nr_pending].y = y;
+	pending[nr_pending].width = w;
+	pending[nr_pending].height = h;
+	nr_pending++;
+}
+
+static int is_ours(struct toplevel *t)
+{
+	XClassHint hint;
+
+	if (t->ours != -1)
+		return t->ours;
+
+	t->ours = 0;
+	if (XGetClassHint(ddpy, t->win, &hint)) {
+		t->ours = hint.res_name && !strcmp(hint.res_name, "warpd");
+
+		XFree(hint.res_name);
+		XFree(hint.res_class);
+	}
+
+	return t->ours;
+}
+
+static void mark_toplevel(struct toplevel *t)
+{
+	if (t->mapped && !is_ours(t))
+		add_pending(t->x, t->y, t->w, t->h);
+}
+
+static struct toplevel *lookup(Window win)
+{
+	size_t i;
+
+	for (i = 0; i < nr_toplevels; i++)
+		if (toplevels[i].win == win)
+			return &toplevels[i];
+
+	return NULL;
+}
+
+static void add_toplevel(Window win)
+{
+	XWindowAttributes attr;
+	struct toplevel *t;
+
+	if (lookup(win))
+		return;
+
+	if (nr_toplevels == MAX_TOPLEVELS) {
+		overflow = 1;
+		return;
+	}
+
+	if (!XGetWindowAttributes(ddpy, win, &attr))
+		return;
+
+	t = &toplevels[nr_toplevels++];
+
+	t->win = win;
+	t->x = attr.x;
+	t->y = attr.y;
+	t->w = attr.width + 2 * attr.border_width;
+	t->h = attr.height + 2 * attr.border_width;
+	t->mapped = attr.map_state == IsViewable;
+	t->damaged = 0;
+	t->ours = -1;
+	t->damage = XDamageCreate(ddpy, win, XDamageReportNonEmpty);
+
+	mark_toplevel(t);
+}
+
+static void remove_toplevel(struct toplevel *t)
+{
+	mark_toplevel(t);
+	XDamageDestroy(ddpy, t->damage);
+
+	*t = toplevels[--nr_toplevels];
+}
+
+static int init()
+{
+	int event_base, error_base;
+	Window root, parent, *children;
+	unsigned int i, n;
+
+	if (!(ddpy = XOpenDisplay(NULL)))
+		return -1;
+
+	/* Windows may disappear at any point. */
+	x_ignore_errors(ddpy);
+
+	if (!XDamageQueryExtension(ddpy, &damage_event_base, &error_base) ||
+	    !XFixesQueryExtension(ddpy, &event_base, &error_base)) {
+		XCloseDisplay(ddpy);
+		ddpy = NULL;
+		return -1;
+	}
+
+	parts = XFixesCreateRegion(ddpy, NULL, 0);
+
+	XSelectInput(ddpy, DefaultRootWindow(ddpy), SubstructureNotifyMask);
+
+	if (XQueryTree(ddpy, DefaultRootWindow(ddpy), &root, &parent,
+		       &children, &n)) {
+		for (i = 0; i < n; i++)
+			add_toplevel(children[i]);
+
+		XFree(children);
+	}
+
+	return 0;
+}
+
+static void process_event(XEvent *ev)
+{
+	struct toplevel *t;
+	Window root = DefaultRootWindow(ddpy);
+
+	switch (ev->type) {
+	case CreateNotify:
+		if (ev->xcreatewindow.parent == root)
+			add_toplevel(ev->xcreatewindow.window);
+		break;
+	case DestroyNotify:
+		if ((t = lookup(ev->xdestroywindow.window)))
+			remove_toplevel(t);
+		break;
+	case ReparentNotify:
+		if (ev->xreparent.parent == root)
+			add_toplevel(ev->xreparent.window);
+		else if ((t = lookup(ev->xreparent.window)))
+			remove_toplevel(t);
+		break;
+	case MapNotify:
+		if ((t = lookup(ev->xmap.window))) {
+			t->mapped = 1;
+			mark_toplevel(t);
+		}
+		break;
+	case UnmapNotify:
+		if ((t = lookup(ev->xunmap.window))) {
+			mark_toplevel(t);
+			t->mapped = 0;
+		}
+		break;
+	case ConfigureNotify:
+		if ((t = lookup(ev->xconfigure.window))) {
+			/* Both the vacated and newly occupied areas change. */
+			mark_toplevel(t);
+
+			t->x = ev->xconfigure.x;
+			t->y = ev->xconfigure.y;
+			t->w = ev->xconfigure.width +
+			       2 * ev->xconfigure.border_width;
+			t->h = ev->xconfigure.height +
+			       2 * ev->xconfigure.border_width;
+
+			mark_toplevel(t);
+		}
+		break;
+	default:
+		if (ev->type == damage_event_base + XDamageNotify) {
+			XDamageNotifyEvent *dev = (XDamageNotifyEvent *)ev;
+
+			if ((t = lookup(dev->drawable)))
+				t->damaged = 1;
+		}
+		break;
+	}
+}
+
+/* Expects the lock to be held. */
+static void drain()
+{
+	while (XPending(ddpy)) {
+		XEvent ev;
+
+		XNextEvent(ddpy, &ev);
+		process_event(&ev);
+	}
+}
+
+/*
+ * Process the events queued since the last poll, so they don't pile up on
+ * the connection while no consumer is polling (e.g while the daemon is
+ * idle). Damage itself is only fetched on the next poll.
+ */
+void x_damage_drain()
+{
+	pthread_mutex_lock(&mtx);
+
+	if (ddpy)
+		drain();
+
+	pthread_mutex_unlock(&mtx);
+}
+
+void x_screen_wait_damage(int timeout)
+{
+	struct timeval tv = {timeout / 1000, (timeout % 1000) * 1000};
+	fd_set fds;
+	int fd;
+
+	pthread_mutex_lock(&mtx);
+
+	if (!ddpy || XEventsQueued(ddpy, QueuedAfterFlush)) {
+		pthread_mutex_unlock(&mtx);
+		return;
+	}
+
+	fd = XConnectionNumber(ddpy);
+	pthread_mutex_unlock(&mtx);
+
+	FD_ZERO(&fds);
+	FD_SET(fd, &fds);
+
+	select(fd + 1, &fds, NULL, NULL, &tv);
+}
+
+/* Translate pending rectangles into screen relative ones. */
+static int flush_pending(struct screen_rect *rects, size_t max)
+{
+	size_t i, j;
+	size_t n = 0;
+
+	for (i = 0; i < nr_pending; i++) {
+		const XRectangle *r = &pending[i];
+
+		for (j = 0; j < nr_xscreens; j++) {
+			struct screen *scr = &xscreens[j];
+
+			int x0 = MAX(r->x, scr->x);
+			int y0 = MAX(r->y, scr->y);
+			int x1 = MIN(r->x + r->width, scr->x + scr->w);
+			int y1 = MIN(r->y + r->height, scr->y + scr->h);
+
+			if (x1 <= x0 || y1 <= y0)
+				continue;
+
+			if (n == max)
+				return -1;
+
+			rects[n].scr = scr;
+			rects[n].x = x0 - scr->x;
+			rects[n].y = y0 - scr->y;
+			rects[n].w = x1 - x0;
+			rects[n].h = y1 - y0;
+			n++;
+		}
+	}
+
+	return n;
+}
+
+int x_screen_poll_damage(struct screen_rect *rects, size_t max)
+{
+	int ret = -1;
+	size_t i;
+
+	pthread_mutex_lock(&mtx);
+
+	if (failed)
+		goto out;
+
+	if (!ddpy) {
+		if (init()) {
+			failed = 1;
+			goto out;
+		}
+
+		/* Nothing is known about changes which predate tracking. */
+		overflow = 1;
+	}
+
+	XSync(ddpy, False);
+	drain();
+
+	for (i = 0; i < nr_toplevels; i++) {
+		struct toplevel *t = &toplevels[i];
+		XRectangle *r;
+		int j, n;
+
+		if (!t->damaged)
+			continue;
+
+		t->damaged = 0;
+		XDamageSubtract(ddpy, t->damage, None, parts);
+
+		if (!t->mapped || is_ours(t))
+			continue;
+
+		r = XFixesFetchRegion(ddpy, parts, &n);
+		for (j = 0; j < n; j++)
+			add_pending(t->x + r[j].x, t->y + r[j].y, r[j].width,
+				    r[j].height);
+
+		if (r)
+			XFree(r);
+	}
+
+	if (!overflow)
+		ret = flush_pending(rects, max);
+
+	overflow = 0;
+	nr_pending = 0;
+
+out:
+	pthread_mutex_unlock(&mtx);
+	return ret;
+}
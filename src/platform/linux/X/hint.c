@@ -6,6 +6,8 @@
 
 #include "X.h"
 
+#include <math.h>
+
 static int border_radius;
 static int border_width;
 static const char *font_family;
@@ -13,95 +15,320 @@ static const char *fgcolor;
 static const char *bgcolor;
 static const char *border_color;
 
-static XftColor parse_xft_color(const char *s)
+static int draw_text(Drawable drw, int x, int y, int w, int h,
+		     const char *fontname, const char *s)
 {
-	uint8_t r, g, b, a;
-	XftColor color;
-	XRenderColor rc;
+	XftDraw *xftdrw;
+	XftColor *col;
 
-	int scr = DefaultScreen(dpy);
+	XftFont *font;
 
-	hex_to_rgba(s, &r, &g, &b, &a);
+	XGlyphInfo e;
+	int font_height;
 
-	rc.red = r * 257;
-	rc.green = g * 257;
-	rc.blue = b * 257;
-	rc.alpha = ~0;
+	font = x_font(fontname, h - 3);
+	col = x_xft_color(fgcolor);
+	xftdrw = x_xft_draw(drw);
 
-	XftColorAllocValue(dpy, DefaultVisual(dpy, scr),
-			   DefaultColormap(dpy, scr), &rc, &color);
-	return color;
+	XftTextExtentsUtf8(dpy, font, (FcChar8 *)s, strlen(s), &e);
+	font_height = font->ascent + font->descent;
+
+	x += (w - e.width) / 2;
+	y += (h - font_height) / 2 + font->ascent;
+
+	XftDrawStringUtf8(xftdrw, col, font, x, y, (FcChar8 *)s, strlen(s));
+
+	return 0;
 }
 
-static XftFont *get_font(const char *name, int height)
+/* Supplies the glyphs of the hint font to the software rasterizer. */
+static int render_glyphs(struct raster_atlas *atlas, const char *name, int w,
+			 int h)
 {
-	static XftFont *font;
-	static char cached_name[256];
-	static int cached_height;
+	XftFont *font = x_font(name, h - 3);
+	FT_Face face;
+	int c;
 
-	char xftname[256];
-	int h;
+	if (!(face = XftLockFace(font)))
+		return -1;
 
-	if (!strcmp(cached_name, name) && cached_height == height)
-		return font;
+	raster_atlas_set_metrics(atlas, font->ascent, font->descent);
 
-	strcpy(cached_name, name);
-	cached_height = height;
+	for (c = 32; c < 127; c++) {
+		FT_GlyphSlot g;
 
-	h = height;
-	do {
-		snprintf(xftname, sizeof xftname, "%s:pixelsize=%d", name, h);
-		font = XftFontOpenName(dpy, DefaultScreen(dpy), xftname);
+		if (FT_Load_Char(face, c, FT_LOAD_RENDER))
+			continue;
 
-		h--;
-	} while (font->height > height);
+		g = face->glyph;
 
-	return font;
+		if (g->bitmap.rows && (g->bitmap.pixel_mode != FT_PIXEL_MODE_GRAY ||
+				       g->bitmap.pitch < 0))
+			continue;
+
+		raster_atlas_add_glyph(atlas, c, g->bitmap.buffer,
+				       g->bitmap.width, g->bitmap.rows,
+				       g->bitmap.pitch, g->bitmap_left,
+				       g->bitmap_top, (g->advance.x + 32) >> 6);
+	}
+
+	XftUnlockFace(font);
+	return 0;
 }
 
-static int draw_text(Drawable drw, int x, int y, int w, int h,
-		     const char *fontname, const char *s)
+/*
+ * Obtain the screen sized image shared with the server, or NULL if shared
+ * memory is unavailable (e.g remote displays).
+ */
+static XImage *get_shm_image(struct screen *scr)
 {
-	XftDraw *xftdrw;
-	XftColor col;
+	const int depth = DefaultDepth(dpy, DefaultScreen(dpy));
+	int err;
+	XShmSegmentInfo *info = &scr->shm_info;
+	XImage *img;
 
-	XftFont *font;
+	if (scr->shm_img || scr->shm_failed)
+		return scr->shm_img;
 
-	XGlyphInfo e;
-	int font_height;
+	scr->shm_failed = 1;
 
-	font = get_font(fontname, h - 3);
-	col = parse_xft_color(fgcolor);
+	if (!XShmQueryExtension(dpy) || depth < 24)
+		return NULL;
 
-	xftdrw = XftDrawCreate(dpy, drw, DefaultVisual(dpy, DefaultScreen(dpy)),
-			       DefaultColormap(dpy, DefaultScreen(dpy)));
+	img = XShmCreateImage(dpy, DefaultVisual(dpy, DefaultScreen(dpy)),
+			      depth, ZPixmap, NULL, info, scr->w, scr->h);
 
-	XftTextExtentsUtf8(dpy, font, (FcChar8 *)s, strlen(s), &e);
-	font_height = font->ascent + font->descent;
+	/* The rasterizer produces 32 bit pixels. */
+	if (!img || img->bits_per_pixel != 32) {
+		if (img)
+			XDestroyImage(img);
+		return NULL;
+	}
 
-	x += (w - e.width) / 2;
-	y += (h - font_height) / 2 + font->ascent;
+	info->shmid = shmget(IPC_PRIVATE, img->bytes_per_line * img->height,
+			     IPC_CREAT | 0600);
+	if (info->shmid == -1) {
+		XDestroyImage(img);
+		return NULL;
+	}
+
+	info->shmaddr = img->data = shmat(info->shmid, NULL, 0);
+	info->readOnly = False;
+
+	/* Freed once both sides have detached. */
+	shmctl(info->shmid, IPC_RMID, NULL);
+
+	if (info->shmaddr == (void *)-1) {
+		img->data = NULL;
+		XDestroyImage(img);
+		return NULL;
+	}
+
+	/* Fails for e.g remote displays. */
+	x_ignore_errors(dpy);
+	XShmAttach(dpy, info);
+	XSync(dpy, False);
+	err = x_take_error(dpy);
+	x_unignore_errors(dpy);
+
+	if (err) {
+		shmdt(info->shmaddr);
+		img->data = NULL;
+		XDestroyImage(img);
+		return NULL;
+	}
+
+	scr->shm_failed = 0;
+	scr->shm_img = img;
+
+	return img;
+}
 
-	XftDrawStringUtf8(xftdrw, &col, font, x, y, (FcChar8 *)s, strlen(s));
+static uint32_t opaque_color(const char *s)
+{
+	uint8_t r = 0, g = 0, b = 0, a = 255;
+
+	hex_to_rgba(s, &r, &g, &b, &a);
+
+	/* Hint window opacity is applied by the compositor. */
+	return raster_color(r, g, b, 255);
+}
+
+/*
+ * Render the hints into buf with the software rasterizer (see raster.c) and
+ * upload them through shared memory. Returns 0 on success.
+ */
+static int raster_hint_draw(struct screen *scr, struct hint *hints, size_t n,
+			    Pixmap buf)
+{
+	/* The last upload which the server may still be reading. */
+	static unsigned long pending = 0;
+
+	struct raster_style style = {
+	    .bg = opaque_color(bgcolor),
+	    .fg = opaque_color(fgcolor),
+	    .border = opaque_color(border_color),
+	    .border_width = border_width,
+	    .border_radius = border_radius,
+	};
+	XImage *img = get_shm_image(scr);
+	int x0 = scr->w, y0 = scr->h;
+	int x1 = 0, y1 = 0;
+	size_t i;
+
+	if (!img)
+		return -1;
+
+	/* Usually already the case, since commit() syncs. */
+	if (pending && LastKnownRequestProcessed(dpy) < pending)
+		XSync(dpy, False);
+
+	if (raster_draw_hints((uint32_t *)img->data, img->bytes_per_line / 4,
+			      scr->w, scr->h, 0, hints, n, &style, font_family,
+			      render_glyphs))
+		return -1;
+
+	for (i = 0; i < n; i++) {
+		x0 = MIN(x0, MAX(0, hints[i].x));
+		y0 = MIN(y0, MAX(0, hints[i].y));
+		x1 = MAX(x1, MIN(scr->w, hints[i].x + hints[i].w));
+		y1 = MAX(y1, MIN(scr->h, hints[i].y + hints[i].h));
+	}
+
+	if (x1 <= x0 || y1 <= y0)
+		return 0;
+
+	pending = NextRequest(dpy);
+	XShmPutImage(dpy, buf, x_gc(0, 0), img, x0, y0, x0, y0, x1 - x0,
+		     y1 - y0, False);
 
 	return 0;
 }
 
-static void draw_rounded_rectangle(Drawable drw, GC gc, unsigned int x,
-				   unsigned int y, unsigned int w,
-				   unsigned int h, unsigned int r)
+/*
+ * Append the rectangles which make up the (rounded) area of the hint to
+ * rects. Each rounded corner is approximated by one span per distinct
+ * inset, so at most 2 * border_radius + 1 rectangles are produced.
+ */
+static size_t hint_rects(struct hint *h, XRectangle *rects)
+{
+	const int r = MIN(border_radius, MIN(h->w, h->h) / 2);
+	size_t n = 0;
+	int dy = 0;
+
+	while (dy < r) {
+		const double d = r - dy - 0.5;
+		const int inset = r - (int)(sqrt(r * r - d * d) + 0.5);
+		int end = dy + 1;
+
+		/* Merge rows with the same inset into a single span. */
+		while (end < r) {
+			const double e = r - end - 0.5;
+
+			if (r - (int)(sqrt(r * r - e * e) + 0.5) != inset)
+				break;
+			end++;
+		}
+
+		rects[n++] = (XRectangle){h->x + inset, h->y + dy,
+					  h->w - 2 * inset, end - dy};
+		rects[n++] = (XRectangle){h->x + inset, h->y + h->h - end,
+					  h->w - 2 * inset, end - dy};
+		dy = end;
+	}
+
+	rects[n++] = (XRectangle){h->x, h->y + r, h->w, h->h - 2 * r};
+
+	return n;
+}
+
+/* Apply (op) the area covered by the given hints to the shape of win. */
+static void shape_hints(Window win, struct hint *hints, size_t n, int op)
 {
+	XRectangle *rects;
+	size_t nr_rects = 0;
+	size_t i;
+
+	if (!(rects = malloc((n * (2 * border_radius + 1) + 1) * sizeof *rects)))
+		return;
 
-	XFillArc(dpy, drw, gc, x, y, 2 * r, 2 * r, 64 * 90 * 1, 64 * 90);
-	XFillArc(dpy, drw, gc, x + w - 2 * r, y, 2 * r, 2 * r, 64 * 90 * 0,
-		 64 * 90);
-	XFillArc(dpy, drw, gc, x + w - 2 * r, y + h - 2 * r, 2 * r, 2 * r,
-		 64 * 90 * 3, 64 * 90);
-	XFillArc(dpy, drw, gc, x, y + h - 2 * r, 2 * r, 2 * r, 64 * 90 * 2,
-		 64 * 90);
+	for (i = 0; i < n; i++)
+		nr_rects += hint_rects(&hints[i], rects + nr_rects);
 
-	XFillRectangle(dpy, drw, gc, x + r, y, w - 2 * r, h);
-	XFillRectangle(dpy, drw, gc, x, y + r, w, h - 2 * r);
+	XShapeCombineRectangles(dpy, win, ShapeBounding, 0, 0, rects, nr_rects,
+				op, Unsorted);
+	free(rects);
+}
+
+static void present(struct screen *scr, Window win, Pixmap buf)
+{
+	XMoveWindow(dpy, win, scr->x, scr->y);
+	XCopyArea(dpy, buf, win, x_gc(0, 0), 0, 0, scr->w, scr->h, 0, 0);
+	XRaiseWindow(dpy, win);
+}
+
+/* Grow *hints to hold at least n hints, returns 0 on success. */
+static int reserve_hints(struct hint **hints, size_t *sz, size_t n)
+{
+	struct hint *h;
+
+	if (n <= *sz)
+		return 0;
+
+	if (!(h = realloc(*hints, n * sizeof *h)))
+		return -1;
+
+	*hints = h;
+	*sz = n;
+
+	return 0;
+}
+
+static int overlaps(struct hint *a, struct hint *b)
+{
+	return a->x < b->x + b->w && b->x < a->x + a->w &&
+	       a->y < b->y + b->h && b->y < a->y + a->h;
+}
+
+/*
+ * If hints is a subset of those displayed by hintwin (e.g after filtering),
+ * the remaining ones are already drawn and it suffices to subtract the
+ * removed ones from the shape. Returns 0 on success.
+ */
+static int shape_subtract(struct screen *scr, struct hint *hints, size_t n)
+{
+	struct hint *removed;
+	size_t nr_removed = 0;
+	size_t i = 0, j;
+	int rc = -1;
+
+	if (!(removed = malloc((scr->nr_shaped_hints + 1) * sizeof *removed)))
+		return -1;
+
+	for (j = 0; j < scr->nr_shaped_hints; j++) {
+		if (i < n && !memcmp(&hints[i], &scr->shaped_hints[j],
+				     sizeof(struct hint)))
+			i++;
+		else
+			removed[nr_removed++] = scr->shaped_hints[j];
+	}
+
+	if (i != n)
+		goto out;
+
+	/* Subtracting would also remove the shared area. */
+	for (i = 0; i < nr_removed; i++)
+		for (j = 0; j < n; j++)
+			if (overlaps(&removed[i], &hints[j]))
+				goto out;
+
+	if (nr_removed)
+		shape_hints(scr->hintwin, removed, nr_removed, ShapeSubtract);
+
+	rc = 0;
+out:
+	free(removed);
+	return rc;
 }
 
 /* Draw the hints. */
@@ -109,40 +336,24 @@ void do_hint_draw(struct screen *scr, Window win, struct hint *hints, size_t n,
 		  Pixmap buf)
 {
 	size_t i = 0;
-
-	Pixmap mask = XCreatePixmap(dpy, win, scr->w, scr->h, 1);
-	GC gc = XCreateGC(dpy, mask, 0, NULL);
-	GC mgc =
-	    XCreateGC(dpy, DefaultRootWindow(dpy), GCForeground | GCFillStyle,
-		      &(XGCValues){
-			  .foreground = parse_xcolor(bgcolor, NULL),
-			  .fill_style = FillSolid,
-		      });
 	GC border_gc = 0;
-	if (border_width > 0) {
-		border_gc = XCreateGC(
-		    dpy, DefaultRootWindow(dpy),
-		    GCForeground | GCLineWidth | GCFillStyle,
-		    &(XGCValues){
-			.foreground = parse_xcolor(border_color, NULL),
-			.line_width = border_width,
-			.fill_style = FillSolid,
-		    });
-		XSetLineAttributes(dpy, border_gc, border_width, LineSolid,
-				   CapButt, JoinMiter);
+	GC mgc;
+
+	if (!raster_hint_draw(scr, hints, n, buf)) {
+		shape_hints(win, hints, n, ShapeSet);
+		present(scr, win, buf);
+		return;
 	}
 
-	XSetForeground(dpy, gc, 0);
-	XFillRectangle(dpy, mask, gc, 0, 0, scr->w, scr->h);
-	XSetForeground(dpy, gc, 1);
+	mgc = x_gc(parse_xcolor(bgcolor, NULL), 0);
+	if (border_width > 0)
+		border_gc = x_gc(parse_xcolor(border_color, NULL), border_width);
 
 	XFillRectangle(dpy, buf, mgc, 0, 0, scr->w, scr->h);
 
 	for (i = 0; i < n; i++) {
 		struct hint *h = &hints[i];
 
-		draw_rounded_rectangle(mask, gc, h->x, h->y, h->w, h->h,
-				       border_radius);
 		if (border_gc)
 			XDrawRectangle(dpy, buf, border_gc, h->x, h->y, h->w,
 				       h->h);
@@ -150,24 +361,43 @@ void do_hint_draw(struct screen *scr, Window win, struct hint *hints, size_t n,
 		draw_text(buf, h->x, h->y, h->w, h->h, font_family, h->label);
 	}
 
-	/* Expensive for large masks. */
-	XShapeCombineMask(dpy, win, ShapeBounding, 0, 0, mask, ShapeSet);
+	shape_hints(win, hints, n, ShapeSet);
+	present(scr, win, buf);
+}
 
-	XMoveWindow(dpy, win, scr->x, scr->y);
-	XCopyArea(dpy, buf, win, mgc, 0, 0, scr->w, scr->h, 0, 0);
-	XRaiseWindow(dpy, win);
+/* Hint windows and their pixmaps are created when first drawn. */
+static void init_screen_hints(struct screen *scr)
+{
+	const int depth = DefaultDepth(dpy, DefaultScreen(dpy));
+
+	if (scr->hintwin)
+		return;
+
+	scr->hintwin = create_window(bgcolor);
+	scr->cached_hintwin = create_window(bgcolor);
+
+	scr->buf = XCreatePixmap(dpy, DefaultRootWindow(dpy), scr->w, scr->h,
+				 depth);
+	scr->cached_hintbuf = XCreatePixmap(dpy, DefaultRootWindow(dpy),
+					    scr->w, scr->h, depth);
+
+	XMoveResizeWindow(dpy, scr->hintwin, -1E6, -1E6, scr->w, scr->h);
+	XMoveResizeWindow(dpy, scr->cached_hintwin, -1E6, -1E6, scr->w,
+			  scr->h);
 
-	XFreePixmap(dpy, mask);
-	XFreeGC(dpy, gc);
-	XFreeGC(dpy, mgc);
-	if (border_gc)
-		XFreeGC(dpy, border_gc);
+	XMapWindow(dpy, scr->hintwin);
+	XMapWindow(dpy, scr->cached_hintwin);
 }
 
 void x_hint_draw(struct screen *scr, struct hint *hints, size_t n)
 {
-	Window win = scr->hintwin;
-	Pixmap buf = scr->buf;
+	Window win;
+	Pixmap buf;
+
+	init_screen_hints(scr);
+
+	win = scr->hintwin;
+	buf = scr->buf;
 
 	XMoveWindow(dpy, scr->hintwin, -1E6, -1E6);
 	XMoveWindow(dpy, scr->cached_hintwin, -1E6, -1E6);
@@ -175,24 +405,12 @@ void x_hint_draw(struct screen *scr, struct hint *hints, size_t n)
 	/* Use the cached window, if it exists. */
 	if (n == scr->nr_cached_hints &&
 	    !memcmp(scr->cached_hints, hints, sizeof(struct hint) * n)) {
-		GC gc = XCreateGC(dpy, DefaultRootWindow(dpy),
-				  GCForeground | GCFillStyle,
-				  &(XGCValues){
-				      .foreground = parse_xcolor(bgcolor, NULL),
-				      .fill_style = FillSolid,
-				  });
-
-		XMoveWindow(dpy, scr->cached_hintwin, scr->x, scr->y);
-		XCopyArea(dpy, scr->cached_hintbuf, scr->cached_hintwin, gc, 0,
-			  0, scr->w, scr->h, 0, 0);
-		XRaiseWindow(dpy, scr->cached_hintwin);
-
-		XFreeGC(dpy, gc);
+		present(scr, scr->cached_hintwin, scr->cached_hintbuf);
 		return;
 	}
 
 	/*
-	 * OPT: Cache large hint sets to avoid expensive shape calls. Note that
+	 * OPT: Cache large hint sets to avoid redrawing them. Note that
 	 * using a single cached window makes assumptions about the
 	 * call pattern, namely that it will consist of intermittent
 	 * large, and identical hint sets, with successive calls below
@@ -203,18 +421,33 @@ void x_hint_draw(struct screen *scr, struct hint *hints, size_t n)
 		win = scr->cached_hintwin;
 		buf = scr->cached_hintbuf;
 
+		if (reserve_hints(&scr->cached_hints, &scr->cached_hints_sz,
+				  n))
+			return;
+
 		memcpy(scr->cached_hints, hints, n * sizeof(struct hint));
 		scr->nr_cached_hints = n;
+
+		do_hint_draw(scr, win, hints, n, buf);
+		return;
 	}
 
-	do_hint_draw(scr, win, hints, n, buf);
+	if (reserve_hints(&scr->shaped_hints, &scr->shaped_hints_sz, n))
+		return;
+
+	if (shape_subtract(scr, hints, n))
+		do_hint_draw(scr, win, hints, n, buf);
+	else
+		present(scr, win, buf);
+
+	memcpy(scr->shaped_hints, hints, n * sizeof(struct hint));
+	scr->nr_shaped_hints = n;
 }
 
 void x_init_hint(const char *bgcol, const char *fgcol, int _border_radius,
 		 const char *border_col, int _border_width,
 		 const char *_font_family)
 {
-	static int init = 0;
 	size_t i;
 
 	bgcolor = bgcol;
@@ -224,30 +457,17 @@ void x_init_hint(const char *bgcol, const char *fgcol, int _border_radius,
 	border_width = _border_width;
 	font_family = _font_family;
 
-	if (!init) {
-		for (i = 0; i < nr_xscreens; i++) {
-			struct screen *scr = &xscreens[i];
+	/* The config may have changed, drop anything derived from it. */
+	x_resources_flush();
 
-			scr->hintwin = create_window(bgcol);
-			scr->cached_hintwin = create_window(bgcol);
+	for (i = 0; i < nr_xscreens; i++) {
+		struct screen *scr = &xscreens[i];
 
-			scr->buf = XCreatePixmap(
-			    dpy, DefaultRootWindow(dpy), scr->w, scr->h,
-			    DefaultDepth(dpy, DefaultScreen(dpy)));
-			scr->cached_hintbuf = XCreatePixmap(
-			    dpy, DefaultRootWindow(dpy), scr->w, scr->h,
-			    DefaultDepth(dpy, DefaultScreen(dpy)));
+		scr->nr_cached_hints = 0;
+		scr->nr_shaped_hints = 0;
 
-			XMoveResizeWindow(dpy, scr->hintwin, -1E6, -1E6, scr->w,
-					  scr->h);
-			XMoveResizeWindow(dpy, scr->cached_hintwin, -1E6, -1E6,
-					  scr->w, scr->h);
-
-			XMapWindow(dpy, scr->hintwin);
-			XMapWindow(dpy, scr->cached_hintwin);
-		}
+		/* The style may have changed, so start from nothing. */
+		if (scr->hintwin)
+			shape_hints(scr->hintwin, NULL, 0, ShapeSet);
 	}
-
-	for (i = 0; i < nr_xscreens; i++)
-		xscreens[i].nr_cached_hints = 0;
 }
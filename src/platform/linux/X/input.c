@@ -177,12 +177,14 @@ static const char *input_tostr(struct input_event *ev)
 
 static void xgrab_key(uint8_t code, uint8_t mods, int grab)
 {
-	XSetErrorHandler(input_xerr);
+	int (*handler)(Display *, XErrorEvent *);
 	int xmods = 0;
 
 	if (!code)
 		return;
 
+	handler = XSetErrorHandler(input_xerr);
+
 	if (mods & PLATFORM_MOD_CONTROL)
 		xmods |= ControlMask;
 	if (mods & PLATFORM_MOD_SHIFT)
@@ -207,7 +209,7 @@ static void xgrab_key(uint8_t code, uint8_t mods, int grab)
 
 	XSync(dpy, False);
 
-	XSetErrorHandler(NULL);
+	XSetErrorHandler(handler);
 }
 
 void x_input_grab_keyboard()
@@ -279,6 +281,8 @@ void x_input_ungrab_keyboard()
 
 	nr_grabbed_device_ids = 0;
 	XSync(dpy, False);
+
+	x_resources_report();
 }
 
 uint8_t xmods_to_mods(int xmods)
@@ -387,6 +391,9 @@ struct input_event *x_input_wait(struct input_event *events, size_t sz)
 			goto exit;
 		} else {
 			size_t i;
+
+			x_damage_drain();
+
 			for (i = 0; i < nr_monitored_files; i++) {
 				long mtime = x_get_mtime(monitored_files[i].path);
 				if (mtime != monitored_files[i].mtime) {
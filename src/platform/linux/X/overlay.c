@@ -0,0 +1,430 @@
+/*
+ * warpd - A modal keyboard-driven pointing system.
+ *
+ * © 2019 Raheman Vaiya (see: LICENSE).
+ */
+
+#include "X.h"
+
+/*
+ * Composited box rendering. Rather than a window per box, each screen has
+ * a single ARGB window (which input passes through) whose background is a
+ * backing pixmap. Boxes are filled into the pixmap with XRender and only
+ * the damaged regions are repainted and presented on commit. Requires a
+ * compositor, otherwise the window per box path in screen.c is used.
+ *
+ * The rings of animated effects are rasterized client side into a
+ * separate layer which is composited over the boxes.
+ */
+
+/* Beyond this the whole screen is repainted. */
+#define MAX_DAMAGE 64
+
+struct obox {
+	struct screen *scr;
+
+	int x;
+	int y;
+	int w;
+	int h;
+	XRenderColor color;
+
+	int visible;
+
+	/* Retained boxes only. */
+	struct obox *next;
+
+	/* Set for boxes made up of several rectangles (x, y, w, h bound them). */
+	XRectangle *rects;
+	size_t nr_rects;
+	size_t rects_sz;
+};
+
+struct overlay {
+	Window win;
+	Pixmap pixmap;
+	Picture pic;
+	int mapped;
+
+	/* Drawn since the last screen_clear. */
+	struct obox *boxes;
+	size_t nr_boxes;
+	size_t sz;
+
+	XRectangle damage[MAX_DAMAGE];
+	size_t nr_damage;
+	int full_damage;
+
+	/* Created on first use. */
+	Pixmap rings;
+	Picture rings_pic;
+	GC rings_gc;
+	size_t nr_rings;
+};
+
+/* One for each screen, allocated once the overlay is enabled. */
+static struct overlay *overlays;
+static struct obox *retained = NULL;
+static struct obox *retained_tail = NULL;
+
+static int enabled = -1;
+static Visual *argb_visual;
+static XRenderPictFormat *argb_format;
+
+/* Overlays are only created for screens which are drawn on. */
+static struct overlay *get_overlay(struct screen *scr)
+{
+	struct overlay *o = &overlays[scr - xscreens];
+
+	if (o->win)
+		return o;
+
+	o->win = create_argb_window(argb_visual, scr->x, scr->y, scr->w,
+				    scr->h);
+	o->pixmap = XCreatePixmap(dpy, o->win, scr->w, scr->h, 32);
+	o->pic = XRenderCreatePicture(dpy, o->pixmap, argb_format, 0, NULL);
+
+	XRenderFillRectangle(dpy, PictOpSrc, o->pic, &(XRenderColor){0}, 0, 0,
+			     scr->w, scr->h);
+
+	/* Presenting is then just a matter of exposing the window. */
+	XSetWindowBackgroundPixmap(dpy, o->win, o->pixmap);
+
+	return o;
+}
+
+static int compositor_running()
+{
+	char name[32];
+
+	snprintf(name, sizeof name, "_NET_WM_CM_S%d", DefaultScreen(dpy));
+	return XGetSelectionOwner(dpy, XInternAtom(dpy, name, False)) != None;
+}
+
+static int init()
+{
+	XVisualInfo vi;
+	XRenderPictFormat *fmt;
+	int event_base, error_base;
+
+	if (!config_get_int("x_overlay") ||
+	    !XRenderQueryExtension(dpy, &event_base, &error_base) ||
+	    !XMatchVisualInfo(dpy, DefaultScreen(dpy), 32, TrueColor, &vi) ||
+	    !compositor_running())
+		return -1;
+
+	if (!(fmt = XRenderFindStandardFormat(dpy, PictStandardARGB32)))
+		return -1;
+
+	if (!(overlays = calloc(nr_xscreens, sizeof *overlays)))
+		return -1;
+
+	argb_visual = vi.visual;
+	argb_format = fmt;
+
+	return 0;
+}
+
+int x_overlay_enabled()
+{
+	if (enabled == -1)
+		enabled = !init();
+
+	return enabled;
+}
+
+static void add_damage(struct screen *scr, int x, int y, int w, int h)
+{
+	struct overlay *o = get_overlay(scr);
+	int x0 = MAX(0, x);
+	int y0 = MAX(0, y);
+	int x1 = MIN(scr->w, x + w);
+	int y1 = MIN(scr->h, y + h);
+
+	if (x1 <= x0 || y1 <= y0 || o->full_damage)
+		return;
+
+	if (o->nr_damage == MAX_DAMAGE) {
+		o->full_damage = 1;
+		return;
+	}
+
+	o->damage[o->nr_damage++] = (XRectangle){x0, y0, x1 - x0, y1 - y0};
+}
+
+static XRenderColor render_color(const char *s)
+{
+	uint8_t r = 0, g = 0, b = 0, a = 255;
+
+	hex_to_rgba(s, &r, &g, &b, &a);
+
+	/* XRender expects premultiplied alpha. */
+	return (XRenderColor){
+	    .red = r * 257 * a / 255,
+	    .green = g * 257 * a / 255,
+	    .blue = b * 257 * a / 255,
+	    .alpha = a * 257,
+	};
+}
+
+void x_overlay_draw_box(struct screen *scr, int x, int y, int w, int h,
+			const char *color)
+{
+	struct overlay *o = get_overlay(scr);
+
+	if (o->nr_boxes == o->sz) {
+		size_t sz = o->sz ? o->sz * 2 : 64;
+		struct obox *boxes = realloc(o->boxes, sz * sizeof *boxes);
+
+		if (!boxes)
+			return;
+
+		o->boxes = boxes;
+		o->sz = sz;
+	}
+
+	o->boxes[o->nr_boxes++] = (struct obox){
+	    .scr = scr,
+	    .x = x,
+	    .y = y,
+	    .w = w,
+	    .h = h,
+	    .color = render_color(color),
+	    .visible = 1,
+	};
+	add_damage(scr, x, y, w, h);
+}
+
+void x_overlay_clear(struct screen *scr)
+{
+	struct overlay *o = get_overlay(scr);
+	size_t i;
+
+	for (i = 0; i < o->nr_boxes; i++)
+		add_damage(scr, o->boxes[i].x, o->boxes[i].y, o->boxes[i].w,
+			   o->boxes[i].h);
+
+	o->nr_boxes = 0;
+}
+
+void *x_overlay_box_create()
+{
+	struct obox *box = calloc(1, sizeof *box);
+
+	if (!box)
+		return NULL;
+
+	if (retained_tail)
+		retained_tail->next = box;
+	else
+		retained = box;
+
+	retained_tail = box;
+	return box;
+}
+
+void x_overlay_box_hide(void *_box)
+{
+	struct obox *box = _box;
+
+	if (box->visible)
+		add_damage(box->scr, box->x, box->y, box->w, box->h);
+
+	box->visible = 0;
+}
+
+void x_overlay_box_update(void *_box, struct screen *scr, int x, int y, int w,
+			  int h, const char *color)
+{
+	struct obox *box = _box;
+
+	x_overlay_box_hide(box);
+
+	box->scr = scr;
+	box->x = x;
+	box->y = y;
+	box->w = w;
+	box->h = h;
+	box->color = render_color(color);
+	box->visible = 1;
+	box->nr_rects = 0;
+
+	add_damage(scr, x, y, w, h);
+}
+
+void x_overlay_box_update_rects(void *_box, struct screen *scr,
+				const struct screen_rect *rects, size_t n,
+				const char *color)
+{
+	struct obox *box = _box;
+	int x0 = INT_MAX, y0 = INT_MAX;
+	int x1 = INT_MIN, y1 = INT_MIN;
+	size_t i;
+
+	x_overlay_box_hide(box);
+
+	if (n > box->rects_sz) {
+		XRectangle *r = realloc(box->rects, n * sizeof *r);
+
+		if (!r)
+			return;
+
+		box->rects = r;
+		box->rects_sz = n;
+	}
+
+	for (i = 0; i < n; i++) {
+		box->rects[i] = (XRectangle){rects[i].x, rects[i].y,
+					     rects[i].w, rects[i].h};
+
+		x0 = MIN(x0, rects[i].x);
+		y0 = MIN(y0, rects[i].y);
+		x1 = MAX(x1, rects[i].x + rects[i].w);
+		y1 = MAX(y1, rects[i].y + rects[i].h);
+	}
+
+	box->scr = scr;
+	box->x = x0;
+	box->y = y0;
+	box->w = x1 - x0;
+	box->h = y1 - y0;
+	box->color = render_color(color);
+	box->visible = 1;
+	box->nr_rects = n;
+
+	add_damage(scr, box->x, box->y, box->w, box->h);
+}
+
+/*
+ * Replace the rings of scr, rasterizing them within each of the damaged
+ * rectangles (which bound the old and new rings).
+ */
+void x_overlay_draw_rings(struct screen *scr, const struct ring *rings,
+			  size_t n, const struct screen_rect *damage,
+			  size_t nr_damage)
+{
+	struct overlay *o = get_overlay(scr);
+	size_t i, j;
+
+	if (!o->rings) {
+		o->rings = XCreatePixmap(dpy, o->win, scr->w, scr->h, 32);
+		o->rings_pic = XRenderCreatePicture(dpy, o->rings, argb_format,
+						    0, NULL);
+		o->rings_gc = XCreateGC(dpy, o->rings, 0, NULL);
+	}
+
+	for (i = 0; i < nr_damage; i++) {
+		int x = MAX(0, damage[i].x);
+		int y = MAX(0, damage[i].y);
+		int w = MIN(scr->w, damage[i].x + damage[i].w) - x;
+		int h = MIN(scr->h, damage[i].y + damage[i].h) - y;
+		uint32_t *buf;
+		XImage *img;
+
+		if (w <= 0 || h <= 0 || !(buf = calloc(w * h, sizeof *buf)))
+			continue;
+
+		for (j = 0; j < n; j++)
+			raster_draw_ring(buf, w, w, h, x, y, &rings[j]);
+
+		img = XCreateImage(dpy, argb_visual, 32, ZPixmap, 0, (char *)buf,
+				   w, h, 32, 0);
+		XPutImage(dpy, o->rings, o->rings_gc, img, 0, 0, x, y, w, h);
+
+		/* Frees buf. */
+		XDestroyImage(img);
+
+		add_damage(scr, x, y, w, h);
+	}
+
+	o->nr_rings = n;
+}
+
+static void fill(struct overlay *o, struct obox *box, XserverRegion damage)
+{
+	XserverRegion region;
+
+	if (!box->nr_rects) {
+		XRenderFillRectangle(dpy, PictOpOver, o->pic, &box->color,
+				     box->x, box->y, box->w, box->h);
+		return;
+	}
+
+	/* Overlapping rectangles (e.g grid lines) are only blended once. */
+	region = XFixesCreateRegion(dpy, box->rects, box->nr_rects);
+	XFixesIntersectRegion(dpy, region, region, damage);
+
+	XFixesSetPictureClipRegion(dpy, o->pic, 0, 0, region);
+	XRenderFillRectangle(dpy, PictOpOver, o->pic, &box->color, box->x,
+			     box->y, box->w, box->h);
+	XFixesSetPictureClipRegion(dpy, o->pic, 0, 0, damage);
+
+	XFixesDestroyRegion(dpy, region);
+}
+
+/* Repaint and expose the damaged regions of each screen. */
+void x_overlay_present()
+{
+	size_t i, j;
+
+	if (enabled != 1)
+		return;
+
+	for (i = 0; i < nr_xscreens; i++) {
+		struct screen *scr = &xscreens[i];
+		struct overlay *o = &overlays[i];
+		XRectangle full = {0, 0, scr->w, scr->h};
+		XRectangle *rects = o->full_damage ? &full : o->damage;
+		size_t nr_rects = o->full_damage ? 1 : o->nr_damage;
+		size_t nr_visible = o->nr_boxes;
+		XserverRegion damage;
+		struct obox *box;
+
+		if (!nr_rects)
+			continue;
+
+		/* Only pixels within the damaged regions are touched. */
+		damage = XFixesCreateRegion(dpy, rects, nr_rects);
+		XFixesSetPictureClipRegion(dpy, o->pic, 0, 0, damage);
+		XRenderFillRectangle(dpy, PictOpSrc, o->pic,
+				     &(XRenderColor){0}, 0, 0, scr->w, scr->h);
+
+		for (box = retained; box; box = box->next)
+			if (box->visible && box->scr == scr) {
+				fill(o, box, damage);
+				nr_visible++;
+			}
+
+		for (j = 0; j < o->nr_boxes; j++)
+			fill(o, &o->boxes[j], damage);
+
+		if (o->nr_rings) {
+			XRenderComposite(dpy, PictOpOver, o->rings_pic, None,
+					 o->pic, 0, 0, 0, 0, 0, 0, scr->w,
+					 scr->h);
+			nr_visible += o->nr_rings;
+		}
+
+		XFixesDestroyRegion(dpy, damage);
+
+		if (nr_visible) {
+			if (!o->mapped) {
+				XMapWindow(dpy, o->win);
+				o->mapped = 1;
+			}
+
+			XRaiseWindow(dpy, o->win);
+
+			for (j = 0; j < nr_rects; j++)
+				XClearArea(dpy, o->win, rects[j].x, rects[j].y,
+					   rects[j].width, rects[j].height,
+					   False);
+		} else if (o->mapped) {
+			XUnmapWindow(dpy, o->win);
+			o->mapped = 0;
+		}
+
+		o->nr_damage = 0;
+		o->full_damage = 0;
+	}
+}
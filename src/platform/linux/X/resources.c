@@ -0,0 +1,381 @@
+/*
+ * warpd - A modal keyboard-driven pointing system.
+ *
+ * © 2019 Raheman Vaiya (see: LICENSE).
+ */
+
+#include "X.h"
+
+/*
+ * Server resources (colors, fonts, Xft draws and GCs) are interned here
+ * so that hot paths (e.g hint drawing) neither allocate them on every call
+ * nor wait on the server once they have been warmed up. Everything is
+ * released by x_resources_flush() when the config is (re)loaded. A full
+ * table evicts its least recently used entry, so handles obtained from
+ * other tables (or recently from the same one) remain valid.
+ *
+ * Setting WARPD_X_RESOURCE_DEBUG prints the counters at the end of each
+ * activation.
+ */
+
+#define MAX_COLORS 64
+#define MAX_FONTS  16
+#define MAX_DRAWS  16
+#define MAX_GCS	   32
+
+struct color {
+	uint64_t used;
+	char name[32];
+
+	unsigned long pixel;
+	int has_pixel;
+
+	XftColor xft;
+	int has_xft;
+};
+
+struct font {
+	uint64_t used;
+	char name[256];
+	int height;
+	XftFont *font;
+};
+
+struct draw {
+	uint64_t used;
+	Drawable drw;
+	XftDraw *draw;
+};
+
+struct gc {
+	uint64_t used;
+	unsigned long fg;
+	int line_width;
+	GC gc;
+};
+
+static struct color colors[MAX_COLORS];
+static size_t nr_colors;
+
+static struct font fonts[MAX_FONTS];
+static size_t nr_fonts;
+
+static struct draw draws[MAX_DRAWS];
+static size_t nr_draws;
+
+static struct gc gcs[MAX_GCS];
+static size_t nr_gcs;
+
+/* Advanced on every lookup, orders entries by use. */
+static uint64_t tick;
+
+static struct {
+	size_t hits;
+	size_t misses;
+
+	/* Requests which block on a reply from the server. */
+	size_t round_trips;
+} stats;
+
+static void free_color(struct color *c)
+{
+	if (c->has_xft)
+		XftColorFree(dpy, DefaultVisual(dpy, DefaultScreen(dpy)),
+			     DefaultColormap(dpy, DefaultScreen(dpy)), &c->xft);
+}
+
+static struct color *get_color(const char *s)
+{
+	struct color *c;
+	size_t i;
+
+	for (i = 0; i < nr_colors; i++)
+		if (!strcmp(colors[i].name, s)) {
+			colors[i].used = ++tick;
+			return &colors[i];
+		}
+
+	if (nr_colors < MAX_COLORS) {
+		c = &colors[nr_colors++];
+	} else {
+		/* Full (unlikely), evict the least recently used. */
+		c = &colors[0];
+		for (i = 1; i < nr_colors; i++)
+			if (colors[i].used < c->used)
+				c = &colors[i];
+
+		free_color(c);
+	}
+
+	memset(c, 0, sizeof *c);
+	snprintf(c->name, sizeof c->name, "%s", s);
+	c->used = ++tick;
+
+	return c;
+}
+
+/* Pixels of TrueColor visuals can be computed without asking the server. */
+static int true_color_pixel(uint8_t r, uint8_t g, uint8_t b,
+			    unsigned long *pixel)
+{
+	Visual *vis = DefaultVisual(dpy, DefaultScreen(dpy));
+	const unsigned long masks[] = {vis->red_mask, vis->green_mask,
+				       vis->blue_mask};
+	const uint8_t values[] = {r, g, b};
+	size_t i;
+
+	if (vis->class != TrueColor)
+		return -1;
+
+	*pixel = 0;
+	for (i = 0; i < 3; i++) {
+		unsigned long mask = masks[i];
+		int shift = 0;
+
+		if (!mask)
+			return -1;
+
+		while (!(mask & 1)) {
+			mask >>= 1;
+			shift++;
+		}
+
+		*pixel |= (values[i] * mask / 255) << shift;
+	}
+
+	return 0;
+}
+
+uint32_t parse_xcolor(const char *s, uint8_t *opacity)
+{
+	struct color *c = get_color(s);
+	uint8_t r = 0, g = 0, b = 0, a = 255;
+
+	hex_to_rgba(s, &r, &g, &b, &a);
+
+	if (opacity)
+		*opacity = a;
+
+	if (c->has_pixel) {
+		stats.hits++;
+		return c->pixel;
+	}
+
+	stats.misses++;
+
+	if (true_color_pixel(r, g, b, &c->pixel)) {
+		XColor col;
+
+		col.red = (int)r << 8;
+		col.green = (int)g << 8;
+		col.blue = (int)b << 8;
+		col.flags = DoRed | DoGreen | DoBlue;
+
+		assert(XAllocColor(dpy, XDefaultColormap(dpy, DefaultScreen(dpy)),
+				   &col));
+
+		c->pixel = col.pixel;
+		stats.round_trips++;
+	}
+
+	c->has_pixel = 1;
+	return c->pixel;
+}
+
+XftColor *x_xft_color(const char *s)
+{
+	struct color *c = get_color(s);
+	uint8_t r = 0, g = 0, b = 0, a = 255;
+	XRenderColor rc;
+
+	if (c->has_xft) {
+		stats.hits++;
+		return &c->xft;
+	}
+
+	stats.misses++;
+
+	hex_to_rgba(s, &r, &g, &b, &a);
+
+	rc.red = r * 257;
+	rc.green = g * 257;
+	rc.blue = b * 257;
+	rc.alpha = ~0;
+
+	XftColorAllocValue(dpy, DefaultVisual(dpy, DefaultScreen(dpy)),
+			   DefaultColormap(dpy, DefaultScreen(dpy)), &rc,
+			   &c->xft);
+
+	c->has_xft = 1;
+	return &c->xft;
+}
+
+/* The largest size of the named font which is no taller than height. */
+XftFont *x_font(const char *name, int height)
+{
+	struct font *f;
+	XftFont *font;
+	char xftname[256];
+	size_t i;
+	int h;
+
+	for (i = 0; i < nr_fonts; i++)
+		if (fonts[i].height == height && !strcmp(fonts[i].name, name)) {
+			fonts[i].used = ++tick;
+			stats.hits++;
+			return fonts[i].font;
+		}
+
+	stats.misses++;
+
+	for (h = height;; h--) {
+		snprintf(xftname, sizeof xftname, "%s:pixelsize=%d", name, h);
+		font = XftFontOpenName(dpy, DefaultScreen(dpy), xftname);
+		stats.round_trips++;
+
+		if (font->height <= height || h <= 1)
+			break;
+
+		XftFontClose(dpy, font);
+	}
+
+	if (nr_fonts < MAX_FONTS) {
+		f = &fonts[nr_fonts++];
+	} else {
+		f = &fonts[0];
+		for (i = 1; i < nr_fonts; i++)
+			if (fonts[i].used < f->used)
+				f = &fonts[i];
+
+		XftFontClose(dpy, f->font);
+	}
+
+	snprintf(f->name, sizeof f->name, "%s", name);
+	f->height = height;
+	f->font = font;
+	f->used = ++tick;
+
+	return font;
+}
+
+XftDraw *x_xft_draw(Drawable drw)
+{
+	struct draw *d;
+	XftDraw *draw;
+	size_t i;
+
+	for (i = 0; i < nr_draws; i++)
+		if (draws[i].drw == drw) {
+			draws[i].used = ++tick;
+			stats.hits++;
+			return draws[i].draw;
+		}
+
+	stats.misses++;
+
+	if (nr_draws < MAX_DRAWS) {
+		d = &draws[nr_draws++];
+	} else {
+		d = &draws[0];
+		for (i = 1; i < nr_draws; i++)
+			if (draws[i].used < d->used)
+				d = &draws[i];
+
+		XftDrawDestroy(d->draw);
+	}
+
+	draw = XftDrawCreate(dpy, drw, DefaultVisual(dpy, DefaultScreen(dpy)),
+			     DefaultColormap(dpy, DefaultScreen(dpy)));
+
+	d->drw = drw;
+	d->draw = draw;
+	d->used = ++tick;
+
+	return draw;
+}
+
+/*
+ * A solid GC with the given foreground and line width, usable with any
+ * drawable of the default depth.
+ */
+GC x_gc(unsigned long fg, int line_width)
+{
+	struct gc *g;
+	GC gc;
+	size_t i;
+
+	for (i = 0; i < nr_gcs; i++)
+		if (gcs[i].fg == fg && gcs[i].line_width == line_width) {
+			gcs[i].used = ++tick;
+			stats.hits++;
+			return gcs[i].gc;
+		}
+
+	stats.misses++;
+
+	gc = XCreateGC(dpy, DefaultRootWindow(dpy),
+		       GCForeground | GCLineWidth | GCFillStyle,
+		       &(XGCValues){
+			   .foreground = fg,
+			   .line_width = line_width,
+			   .fill_style = FillSolid,
+		       });
+
+	if (line_width)
+		XSetLineAttributes(dpy, gc, line_width, LineSolid, CapButt,
+				   JoinMiter);
+
+	if (nr_gcs < MAX_GCS) {
+		g = &gcs[nr_gcs++];
+	} else {
+		g = &gcs[0];
+		for (i = 1; i < nr_gcs; i++)
+			if (gcs[i].used < g->used)
+				g = &gcs[i];
+
+		XFreeGC(dpy, g->gc);
+	}
+
+	g->fg = fg;
+	g->line_width = line_width;
+	g->gc = gc;
+	g->used = ++tick;
+
+	return gc;
+}
+
+void x_resources_flush()
+{
+	size_t i;
+
+	for (i = 0; i < nr_colors; i++)
+		free_color(&colors[i]);
+
+	for (i = 0; i < nr_fonts; i++)
+		XftFontClose(dpy, fonts[i].font);
+
+	for (i = 0; i < nr_draws; i++)
+		XftDrawDestroy(draws[i].draw);
+
+	for (i = 0; i < nr_gcs; i++)
+		XFreeGC(dpy, gcs[i].gc);
+
+	nr_colors = 0;
+	nr_fonts = 0;
+	nr_draws = 0;
+	nr_gcs = 0;
+}
+
+void x_resources_report()
+{
+	if (!getenv("WARPD_X_RESOURCE_DEBUG"))
+		return;
+
+	fprintf(stderr,
+		"resources: hits=%zu misses=%zu round_trips=%zu colors=%zu "
+		"fonts=%zu draws=%zu gcs=%zu\n",
+		stats.hits, stats.misses, stats.round_trips, nr_colors,
+		nr_fonts, nr_draws, nr_gcs);
+
+	memset(&stats, 0, sizeof stats);
+}
@@ -1,6 +1,6 @@
 #include "X.h"
 
-struct screen xscreens[32];
+struct screen *xscreens;
 size_t nr_xscreens = 0;
 
 static void window_set_color(Window w, const char *color)
@@ -14,21 +14,63 @@ static void window_set_color(Window w, const char *color)
 	XClearWindow(dpy, w);
 }
 
+/*
+ * The refresh rate (mHz) of the fastest CRTC which scans out the given
+ * screen, used to pace animations (see anim.c).
+ */
+static int get_refresh_rate(XRRScreenResources *res, struct screen *scr)
+{
+	int rate = 0;
+	int i, j;
+
+	for (i = 0; i < res->ncrtc; i++) {
+		XRRCrtcInfo *crtc = XRRGetCrtcInfo(dpy, res, res->crtcs[i]);
+
+		if (!crtc)
+			continue;
+
+		for (j = 0; crtc->mode != None && j < res->nmode; j++) {
+			XRRModeInfo *m = &res->modes[j];
+			uint64_t lines = m->vTotal;
+
+			if (m->id != crtc->mode)
+				continue;
+
+			if (m->modeFlags & RR_DoubleScan)
+				lines *= 2;
+			if (m->modeFlags & RR_Interlace)
+				lines /= 2;
+
+			if (crtc->x == scr->x && crtc->y == scr->y &&
+			    m->hTotal && lines)
+				rate = MAX(rate, (int)((uint64_t)m->dotClock *
+						       1000 / (m->hTotal * lines)));
+		}
+
+		XRRFreeCrtcInfo(crtc);
+	}
+
+	return rate;
+}
+
+/*
+ * Only the geometry is obtained here, windows and pixmaps are created when
+ * something is first drawn on the screen (so e.g --move never creates any).
+ */
 void init_xscreens()
 {
-	Window chld, root;
-	int n, x, y, _;
-	unsigned int _u;
+	int n;
+	int ev, err;
 	XineramaScreenInfo *screens;
-
-	/* Obtain absolute pointer coordinates */
-	XQueryPointer(dpy, DefaultRootWindow(dpy), &root, &chld, &x, &y, &_, &_,
-		      &_u);
+	XRRScreenResources *res = NULL;
 
 	screens = XineramaQueryScreens(dpy, &n);
-	for (int i = 0; i < n; i++) {
-		size_t j;
+	n = MIN(n, MAX_SCREENS);
 
+	xscreens = calloc(n, sizeof *xscreens);
+	assert(!n || xscreens);
+
+	for (int i = 0; i < n; i++) {
 		struct screen *scr = &xscreens[nr_xscreens++];
 
 		scr->y = screens[i].y_org;
@@ -36,14 +78,20 @@ void init_xscreens()
 
 		scr->w = screens[i].width;
 		scr->h = screens[i].height;
-
-		for (j = 0; j < MAX_BOXES; j++) {
-			scr->boxes[j].win = create_window("#000000");
-			XMapWindow(dpy, scr->boxes[j].win);
-		}
 	}
 
 	XFree(screens);
+
+	if (XRRQueryExtension(dpy, &ev, &err))
+		res = XRRGetScreenResourcesCurrent(dpy, DefaultRootWindow(dpy));
+
+	if (res) {
+		for (size_t i = 0; i < nr_xscreens; i++)
+			xscreens[i].refresh_rate =
+			    get_refresh_rate(res, &xscreens[i]);
+
+		XRRFreeScreenResources(res);
+	}
 }
 
 void x_screen_list(struct screen *rscreens[MAX_SCREENS], size_t *n)
@@ -62,31 +110,293 @@ void x_screen_get_dimensions(struct screen *scr, int *w, int *h)
 	*h = scr->h;
 }
 
+int x_screen_get_refresh_rate(struct screen *scr)
+{
+	return scr->refresh_rate;
+}
+
 void x_screen_clear(struct screen *scr)
 {
 	size_t i;
 
+	if (x_overlay_enabled())
+		x_overlay_clear(scr);
+
 	for (i = 0; i < scr->nr_boxes; i++)
 		XMoveWindow(dpy, scr->boxes[i].win, -1E6, -1E6);
 
-	XMoveWindow(dpy, scr->hintwin, -1E6, -1E6);
-	XMoveWindow(dpy, scr->cached_hintwin, -1E6, -1E6);
+	if (scr->hintwin) {
+		XMoveWindow(dpy, scr->hintwin, -1E6, -1E6);
+		XMoveWindow(dpy, scr->cached_hintwin, -1E6, -1E6);
+	}
+
+	if (scr->imagewin)
+		XMoveWindow(dpy, scr->imagewin, -1E6, -1E6);
 
 	scr->nr_boxes = 0;
 }
 
+/*
+ * Obtain the geometry of the window named by _NET_ACTIVE_WINDOW, clipped to
+ * the supplied screen. Returns -1 if no such window exists or it does not
+ * intersect the screen.
+ */
+int x_screen_get_focused_window(struct screen *scr, int *x, int *y, int *w,
+				int *h)
+{
+	static Atom _NET_ACTIVE_WINDOW = None;
+
+	Atom type;
+	int format;
+	unsigned long nitems, remaining;
+	unsigned char *data = NULL;
+
+	Window win, chld;
+	XWindowAttributes attr;
+	int wx, wy;
+	int x0, y0, x1, y1;
+	int ok;
+
+	if (_NET_ACTIVE_WINDOW == None)
+		_NET_ACTIVE_WINDOW =
+		    XInternAtom(dpy, "_NET_ACTIVE_WINDOW", False);
+
+	if (XGetWindowProperty(dpy, DefaultRootWindow(dpy), _NET_ACTIVE_WINDOW,
+			       0, 1, False, XA_WINDOW, &type, &format, &nitems,
+			       &remaining, &data) != Success ||
+	    !data)
+		return -1;
+
+	win = nitems ? *(Window *)data : None;
+	XFree(data);
+
+	if (win == None)
+		return -1;
+
+	/* The window may disappear underneath us. */
+	x_ignore_errors(dpy);
+	ok = XGetWindowAttributes(dpy, win, &attr) &&
+	     XTranslateCoordinates(dpy, win, DefaultRootWindow(dpy), 0, 0, &wx,
+				   &wy, &chld);
+	XSync(dpy, False);
+	ok = !x_take_error(dpy) && ok;
+	x_unignore_errors(dpy);
+
+	if (!ok || attr.map_state != IsViewable)
+		return -1;
+
+	x0 = wx > scr->x ? wx : scr->x;
+	y0 = wy > scr->y ? wy : scr->y;
+	x1 = wx + attr.width < scr->x + scr->w ? wx + attr.width
+					       : scr->x + scr->w;
+	y1 = wy + attr.height < scr->y + scr->h ? wy + attr.height
+						: scr->y + scr->h;
+
+	if (x1 <= x0 || y1 <= y0)
+		return -1;
+
+	*x = x0 - scr->x;
+	*y = y0 - scr->y;
+	*w = x1 - x0;
+	*h = y1 - y0;
+
+	return 0;
+}
+
 void x_screen_draw_box(struct screen *scr, int x, int y, int w, int h, const char *color)
 {
-	assert(scr->nr_boxes < MAX_BOXES);
+	/* The overlay has no limit on the number of boxes. */
+	if (x_overlay_enabled()) {
+		x_overlay_draw_box(scr, x, y, w, h, color);
+		return;
+	}
+
+	if (scr->nr_boxes == scr->boxes_sz) {
+		size_t sz = scr->boxes_sz ? scr->boxes_sz * 2 : 8;
+		struct box *boxes = realloc(scr->boxes, sz * sizeof *boxes);
+
+		if (!boxes)
+			return;
+
+		memset(boxes + scr->boxes_sz, 0,
+		       (sz - scr->boxes_sz) * sizeof *boxes);
+
+		scr->boxes = boxes;
+		scr->boxes_sz = sz;
+	}
 
 	struct box *box = &scr->boxes[scr->nr_boxes++];
 
+	if (!box->win) {
+		box->win = create_window("#000000");
+		strcpy(box->color, "#000000");
+	}
+
 	if (strcmp(box->color, color)) {
 		window_set_color(box->win, color);
 		strcpy(box->color, color);
 	};
 
 	XMoveResizeWindow(dpy, box->win, scr->x + x, scr->y + y, w, h);
+
+	if (!box->mapped) {
+		XMapWindow(dpy, box->win);
+		box->mapped = 1;
+	}
+
+	XRaiseWindow(dpy, box->win);
+}
+
+
+void x_screen_draw_image(struct screen *scr, int x, int y, int w, int h,
+			 const uint32_t *pixels)
+{
+	XImage *img;
+
+	if (!scr->imagewin) {
+		scr->imagewin = create_window("#000000");
+		XMapWindow(dpy, scr->imagewin);
+	}
+
+	/* Matches the layout produced by x_screen_capture. */
+	img = XCreateImage(dpy, DefaultVisual(dpy, DefaultScreen(dpy)),
+			   DefaultDepth(dpy, DefaultScreen(dpy)), ZPixmap, 0,
+			   (char *)pixels, w, h, 32, w * sizeof *pixels);
+	if (!img)
+		return;
+
+	XMoveResizeWindow(dpy, scr->imagewin, scr->x + x, scr->y + y, w, h);
+	XRaiseWindow(dpy, scr->imagewin);
+	XPutImage(dpy, scr->imagewin, x_gc(0, 0), img, 0, 0, 0, 0, w, h);
+
+	/* The pixels belong to the caller. */
+	img->data = NULL;
+	XDestroyImage(img);
+}
+
+/* Rings need to be blended, which requires the composited overlay. */
+void x_screen_draw_rings(struct screen *scr, const struct ring *rings,
+			 size_t n, const struct screen_rect *damage,
+			 size_t nr_damage)
+{
+	if (x_overlay_enabled())
+		x_overlay_draw_rings(scr, rings, n, damage, nr_damage);
+}
+
+/*
+ * Retained boxes (see scene.c), each backed by its own window unless the
+ * overlay is in use.
+ */
+void *x_box_create()
+{
+	struct box *box;
+
+	if (x_overlay_enabled())
+		return x_overlay_box_create();
+
+	if (!(box = calloc(1, sizeof *box)))
+		return NULL;
+
+	box->win = create_window("#000000");
+	strcpy(box->color, "#000000");
+
+	return box;
+}
+
+void x_box_update(void *_box, struct screen *scr, int x, int y, int w, int h,
+		  const char *color)
+{
+	struct box *box = _box;
+
+	if (x_overlay_enabled()) {
+		x_overlay_box_update(box, scr, x, y, w, h, color);
+		return;
+	}
+
+	if (strcmp(box->color, color)) {
+		window_set_color(box->win, color);
+		snprintf(box->color, sizeof box->color, "%s", color);
+	}
+
+	if (box->shaped) {
+		XShapeCombineMask(dpy, box->win, ShapeBounding, 0, 0, None,
+				  ShapeSet);
+		box->shaped = 0;
+	}
+
+	XMoveResizeWindow(dpy, box->win, scr->x + x, scr->y + y, w, h);
+
+	if (!box->mapped) {
+		XMapWindow(dpy, box->win);
+		box->mapped = 1;
+	}
+
 	XRaiseWindow(dpy, box->win);
 }
 
+void x_box_hide(void *_box)
+{
+	struct box *box = _box;
+
+	if (x_overlay_enabled()) {
+		x_overlay_box_hide(box);
+		return;
+	}
+
+	XMoveWindow(dpy, box->win, -1E6, -1E6);
+}
+
+/*
+ * A box made up of several rectangles is a single window spanning them
+ * which is shaped to their union, so it is updated in one operation.
+ */
+void x_box_update_rects(void *_box, struct screen *scr,
+			const struct screen_rect *rects, size_t n,
+			const char *color)
+{
+	struct box *box = _box;
+	XRectangle *xrects;
+	int x0 = INT_MAX, y0 = INT_MAX;
+	int x1 = INT_MIN, y1 = INT_MIN;
+	size_t i;
+
+	if (x_overlay_enabled()) {
+		x_overlay_box_update_rects(box, scr, rects, n, color);
+		return;
+	}
+
+	if (!(xrects = malloc(n * sizeof *xrects)))
+		return;
+
+	for (i = 0; i < n; i++) {
+		x0 = MIN(x0, rects[i].x);
+		y0 = MIN(y0, rects[i].y);
+		x1 = MAX(x1, rects[i].x + rects[i].w);
+		y1 = MAX(y1, rects[i].y + rects[i].h);
+	}
+
+	for (i = 0; i < n; i++)
+		xrects[i] = (XRectangle){rects[i].x - x0, rects[i].y - y0,
+					 rects[i].w, rects[i].h};
+
+	if (strcmp(box->color, color)) {
+		window_set_color(box->win, color);
+		snprintf(box->color, sizeof box->color, "%s", color);
+	}
+
+	/* Shape before moving so the bounding box is never visible. */
+	XShapeCombineRectangles(dpy, box->win, ShapeBounding, 0, 0, xrects, n,
+				ShapeSet, Unsorted);
+	XMoveResizeWindow(dpy, box->win, scr->x + x0, scr->y + y0, x1 - x0,
+			  y1 - y0);
+
+	if (!box->mapped) {
+		XMapWindow(dpy, box->win);
+		box->mapped = 1;
+	}
+
+	XRaiseWindow(dpy, box->win);
+
+	box->shaped = 1;
+	free(xrects);
+}
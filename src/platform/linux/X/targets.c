@@ -0,0 +1,149 @@
+/*
+ * warpd - A modal keyboard-driven pointing system.
+ *
+ * © 2019 Raheman Vaiya (see: LICENSE).
+ */
+
+#include "X.h"
+
+#include <X11/extensions/Xdamage.h>
+
+#ifdef WARPD_ATSPI
+#include "../atspi/atspi.h"
+#endif
+
+/*
+ * Tracks changes to the focused window on behalf of the target cache. This
+ * may be called from a background thread, so it uses its own connection
+ * rather than the shared one.
+ */
+
+static pthread_mutex_t mtx = PTHREAD_MUTEX_INITIALIZER;
+
+static Display *wdpy = NULL;
+static Atom active_window_atom;
+static int damage_event_base = -1;
+
+static Window active = None;
+static Damage damage = None;
+static uint64_t generation = 0;
+
+static Window get_active_window()
+{
+	Atom type;
+	int format;
+	unsigned long nitems, bytes_after;
+	unsigned char *data = NULL;
+	Window win = None;
+
+	if (XGetWindowProperty(wdpy, DefaultRootWindow(wdpy),
+			       active_window_atom, 0, 1, False, XA_WINDOW,
+			       &type, &format, &nitems, &bytes_after,
+			       &data) == Success &&
+	    data && nitems == 1 && format == 32)
+		win = *(Window *)data;
+
+	if (data)
+		XFree(data);
+
+	return win;
+}
+
+/* Move change notifications over to the currently focused window. */
+static void track_active_window()
+{
+	Window win = get_active_window();
+
+	if (win == active)
+		return;
+
+	if (active != None)
+		XSelectInput(wdpy, active, 0);
+	if (damage != None)
+		XDamageDestroy(wdpy, damage);
+
+	damage = None;
+	active = win;
+
+	if (active != None) {
+		XSelectInput(wdpy, active, StructureNotifyMask);
+
+		if (damage_event_base != -1)
+			damage =
+			    XDamageCreate(wdpy, active, XDamageReportNonEmpty);
+	}
+
+	generation++;
+}
+
+static int init()
+{
+	int error_base;
+
+	if (!(wdpy = XOpenDisplay(NULL)))
+		return -1;
+
+	/* The tracked window may be destroyed at any point. */
+	x_ignore_errors(wdpy);
+
+	active_window_atom = XInternAtom(wdpy, "_NET_ACTIVE_WINDOW", False);
+
+	if (!XDamageQueryExtension(wdpy, &damage_event_base, &error_base))
+		damage_event_base = -1;
+
+	XSelectInput(wdpy, DefaultRootWindow(wdpy), PropertyChangeMask);
+	track_active_window();
+
+	return 0;
+}
+
+int x_target_state(uint64_t *window, uint64_t *gen)
+{
+	int ret = 0;
+
+	pthread_mutex_lock(&mtx);
+
+	if (!wdpy && init()) {
+		ret = -1;
+		goto out;
+	}
+
+	while (XPending(wdpy)) {
+		XEvent ev;
+
+		XNextEvent(wdpy, &ev);
+
+		switch (ev.type) {
+		case PropertyNotify:
+			if (ev.xproperty.atom == active_window_atom)
+				track_active_window();
+			break;
+		case ConfigureNotify:
+		case MapNotify:
+		case UnmapNotify:
+		case DestroyNotify:
+			generation++;
+			break;
+		default:
+			if (damage_event_base != -1 &&
+			    ev.type == damage_event_base + XDamageNotify) {
+				if (damage != None)
+					XDamageSubtract(wdpy, damage, None,
+							None);
+				generation++;
+			}
+			break;
+		}
+	}
+
+	*window = active;
+	*gen = generation;
+
+#ifdef WARPD_ATSPI
+	*gen += atspi_generation();
+#endif
+
+out:
+	pthread_mutex_unlock(&mtx);
+	return ret;
+}
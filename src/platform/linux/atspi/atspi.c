@@ -0,0 +1,935 @@
+/*
+ * warpd - A modal keyboard-driven pointing system.
+ *
+ * © 2019 Raheman Vaiya (see: LICENSE).
+ */
+
+/*
+ * AT-SPI counterpart to macos/ax_traverse.m.
+ *
+ * The accessibility tree of the active window is walked breadth first by a
+ * small pool of workers. Each worker owns a private connection to the
+ * accessibility bus, so the round trips for independent subtrees overlap
+ * instead of being serialized on a single socket. Collection is abandoned
+ * once the deadline (WARPD_ATSPI_DEADLINE_MS) has passed.
+ */
+
+#include "atspi.h"
+#include "../../../warpd.h"
+
+#include <dbus/dbus.h>
+#include <limits.h>
+#include <pthread.h>
+
+#define MAX_WORKERS 8
+#define QUEUE_SIZE  1024
+
+#define ATSPI_REGISTRY	 "org.a11y.atspi.Registry"
+#define ATSPI_ROOT	 "/org/a11y/atspi/accessible/root"
+#define ATSPI_ACCESSIBLE "org.a11y.atspi.Accessible"
+#define ATSPI_COMPONENT	 "org.a11y.atspi.Component"
+#define ATSPI_ACTION	 "org.a11y.atspi.Action"
+
+/* Subset of AtspiRole (atspi-constants.h). */
+enum {
+	ROLE_CHECK_BOX = 7,
+	ROLE_CHECK_MENU_ITEM = 8,
+	ROLE_COMBO_BOX = 11,
+	ROLE_ICON = 26,
+	ROLE_IMAGE = 27,
+	ROLE_LABEL = 29,
+	ROLE_LIST_ITEM = 32,
+	ROLE_MENU = 33,
+	ROLE_MENU_BAR = 34,
+	ROLE_MENU_ITEM = 35,
+	ROLE_PAGE_TAB = 37,
+	ROLE_PASSWORD_TEXT = 40,
+	ROLE_PUSH_BUTTON = 43,
+	ROLE_RADIO_BUTTON = 44,
+	ROLE_RADIO_MENU_ITEM = 45,
+	ROLE_SLIDER = 51,
+	ROLE_SPIN_BUTTON = 52,
+	ROLE_TABLE_CELL = 56,
+	ROLE_TEXT = 61,
+	ROLE_TOGGLE_BUTTON = 62,
+	ROLE_ENTRY = 79,
+	ROLE_LINK = 88,
+	ROLE_TREE_ITEM = 91,
+	ROLE_STATIC = 116,
+};
+
+/* Subset of AtspiStateType (bit indices into the GetState() bitfield). */
+enum {
+	STATE_ACTIVE = 1,
+	STATE_EDITABLE = 7,
+	STATE_SENSITIVE = 24,
+	STATE_SHOWING = 25,
+	STATE_VISIBLE = 30,
+};
+
+#define HAS_STATE(states, s) ((states)[(s) / 32] & (1u << ((s) % 32)))
+
+struct node {
+	char bus[32];
+	char path[128];
+
+	int parent_actionable;
+};
+
+struct atspi_profile {
+	size_t nodes_visited;
+	size_t hints_added;
+	size_t dup_skipped;
+	size_t offscreen_skipped;
+	size_t queue_dropped;
+};
+
+static struct {
+	pthread_mutex_t mtx;
+	pthread_cond_t cond;
+
+	/* Ring buffer of pending nodes. */
+	struct node queue[QUEUE_SIZE];
+	size_t head;
+	size_t tail;
+	int busy;
+
+	/* Absolute screen rectangle. */
+	int sx;
+	int sy;
+	int sw;
+	int sh;
+
+	struct hint *hints;
+	size_t count;
+	size_t max_hints;
+
+	uint64_t deadline_us;
+	struct atspi_profile prof;
+} ctx = {
+    .mtx = PTHREAD_MUTEX_INITIALIZER,
+    .cond = PTHREAD_COND_INITIALIZER,
+};
+
+static DBusConnection *conns[MAX_WORKERS];
+
+static int env_int(const char *name, int default_value)
+{
+	const char *val = getenv(name);
+	char *end = NULL;
+	long parsed;
+
+	if (!val || !val[0])
+		return default_value;
+
+	parsed = strtol(val, &end, 10);
+	if (end == val || parsed < 0 || parsed > INT_MAX)
+		return default_value;
+
+	return (int)parsed;
+}
+
+static int remaining_ms()
+{
+	uint64_t now = get_time_us();
+
+	if (now >= ctx.deadline_us)
+		return 0;
+
+	return (ctx.deadline_us - now) / 1000 + 1;
+}
+
+/*
+ * The timeout for a call made after checking remaining_ms(), by which
+ * point the deadline may have passed. libdbus would take 0 to mean the
+ * call expires immediately, so it is at least 1.
+ */
+static int call_timeout()
+{
+	return MAX(1, remaining_ms());
+}
+
+/* Returns the address of the accessibility bus (which is distinct from the session bus). */
+static const char *a11y_bus_address()
+{
+	static pthread_mutex_t mtx = PTHREAD_MUTEX_INITIALIZER;
+	static char address[512];
+
+	DBusError err;
+	DBusConnection *session;
+	DBusMessage *msg, *reply;
+	const char *s = NULL;
+
+	pthread_mutex_lock(&mtx);
+
+	if (address[0])
+		goto out;
+
+	if (getenv("AT_SPI_BUS_ADDRESS")) {
+		snprintf(address, sizeof address, "%s",
+			 getenv("AT_SPI_BUS_ADDRESS"));
+		goto out;
+	}
+
+	dbus_error_init(&err);
+
+	session = dbus_bus_get_private(DBUS_BUS_SESSION, &err);
+	if (!session) {
+		fprintf(stderr, "atspi: failed to connect to session bus: %s\n",
+			err.message);
+		dbus_error_free(&err);
+		goto out;
+	}
+
+	dbus_connection_set_exit_on_disconnect(session, FALSE);
+
+	msg = dbus_message_new_method_call("org.a11y.Bus", "/org/a11y/bus",
+					   "org.a11y.Bus", "GetAddress");
+	reply = dbus_connection_send_with_reply_and_block(session, msg, 1000,
+							  &err);
+	dbus_message_unref(msg);
+
+	if (reply) {
+		if (dbus_message_get_args(reply, &err, DBUS_TYPE_STRING, &s,
+					  DBUS_TYPE_INVALID))
+			snprintf(address, sizeof address, "%s", s);
+
+		dbus_message_unref(reply);
+	}
+
+	if (dbus_error_is_set(&err)) {
+		fprintf(stderr, "atspi: failed to obtain bus address: %s\n",
+			err.message);
+		dbus_error_free(&err);
+	}
+
+	dbus_connection_close(session);
+	dbus_connection_unref(session);
+
+out:
+	pthread_mutex_unlock(&mtx);
+	return address[0] ? address : NULL;
+}
+
+/* Connections persist for the lifetime of the process. */
+static DBusConnection *get_conn(int idx)
+{
+	DBusError err;
+	const char *address;
+	DBusConnection *conn = conns[idx];
+
+	if (conn && dbus_connection_get_is_connected(conn))
+		return conn;
+
+	if (conn) {
+		dbus_connection_close(conn);
+		dbus_connection_unref(conn);
+		conns[idx] = NULL;
+	}
+
+	if (!(address = a11y_bus_address()))
+		return NULL;
+
+	dbus_error_init(&err);
+
+	conn = dbus_connection_open_private(address, &err);
+	if (!conn || !dbus_bus_register(conn, &err)) {
+		fprintf(stderr, "atspi: failed to connect to %s: %s\n",
+			address, err.message);
+		dbus_error_free(&err);
+
+		if (conn) {
+			dbus_connection_close(conn);
+			dbus_connection_unref(conn);
+		}
+
+		return NULL;
+	}
+
+	dbus_connection_set_exit_on_disconnect(conn, FALSE);
+	conns[idx] = conn;
+
+	return conn;
+}
+
+/*
+ * Queue a method call without waiting for the reply, this allows all
+ * of the queries for a given node to share a single round trip.
+ */
+static DBusPendingCall *send_call(DBusConnection *conn, const struct node *n,
+				  const char *iface, const char *method,
+				  const uint32_t *arg, int timeout)
+{
+	DBusMessage *msg;
+	DBusPendingCall *pc = NULL;
+
+	msg = dbus_message_new_method_call(n->bus, n->path, iface, method);
+	if (!msg)
+		return NULL;
+
+	if (arg)
+		dbus_message_append_args(msg, DBUS_TYPE_UINT32, arg,
+					 DBUS_TYPE_INVALID);
+
+	if (!dbus_connection_send_with_reply(conn, msg, &pc, timeout))
+		pc = NULL;
+
+	dbus_message_unref(msg);
+	return pc;
+}
+
+/* Returns NULL on failure (including error replies). */
+static DBusMessage *finish_call(DBusPendingCall *pc)
+{
+	DBusMessage *reply;
+
+	if (!pc)
+		return NULL;
+
+	dbus_pending_call_block(pc);
+	reply = dbus_pending_call_steal_reply(pc);
+	dbus_pending_call_unref(pc);
+
+	if (reply &&
+	    dbus_message_get_type(reply) != DBUS_MESSAGE_TYPE_METHOD_RETURN) {
+		dbus_message_unref(reply);
+		return NULL;
+	}
+
+	return reply;
+}
+
+static int parse_uint32(DBusMessage *reply, uint32_t *val)
+{
+	DBusMessageIter it;
+
+	if (!reply || !dbus_message_iter_init(reply, &it) ||
+	    dbus_message_iter_get_arg_type(&it) != DBUS_TYPE_UINT32)
+		return -1;
+
+	dbus_message_iter_get_basic(&it, val);
+	return 0;
+}
+
+static int parse_int32_variant(DBusMessage *reply, int32_t *val)
+{
+	DBusMessageIter it, var;
+
+	if (!reply || !dbus_message_iter_init(reply, &it) ||
+	    dbus_message_iter_get_arg_type(&it) != DBUS_TYPE_VARIANT)
+		return -1;
+
+	dbus_message_iter_recurse(&it, &var);
+	if (dbus_message_iter_get_arg_type(&var) != DBUS_TYPE_INT32)
+		return -1;
+
+	dbus_message_iter_get_basic(&var, val);
+	return 0;
+}
+
+static int parse_states(DBusMessage *reply, uint32_t states[2])
+{
+	DBusMessageIter it, arr;
+	size_t i = 0;
+
+	states[0] = 0;
+	states[1] = 0;
+
+	if (!reply || !dbus_message_iter_init(reply, &it) ||
+	    dbus_message_iter_get_arg_type(&it) != DBUS_TYPE_ARRAY)
+		return -1;
+
+	dbus_message_iter_recurse(&it, &arr);
+	while (i < 2 &&
+	       dbus_message_iter_get_arg_type(&arr) == DBUS_TYPE_UINT32) {
+		dbus_message_iter_get_basic(&arr, &states[i++]);
+		dbus_message_iter_next(&arr);
+	}
+
+	return 0;
+}
+
+static int parse_extents(DBusMessage *reply, int *x, int *y, int *w, int *h)
+{
+	DBusMessageIter it, st;
+	int32_t v[4];
+	size_t i;
+
+	if (!reply || !dbus_message_iter_init(reply, &it) ||
+	    dbus_message_iter_get_arg_type(&it) != DBUS_TYPE_STRUCT)
+		return -1;
+
+	dbus_message_iter_recurse(&it, &st);
+	for (i = 0; i < 4; i++) {
+		if (dbus_message_iter_get_arg_type(&st) != DBUS_TYPE_INT32)
+			return -1;
+
+		dbus_message_iter_get_basic(&st, &v[i]);
+		dbus_message_iter_next(&st);
+	}
+
+	*x = v[0];
+	*y = v[1];
+	*w = v[2];
+	*h = v[3];
+
+	return 0;
+}
+
+static int has_interface(DBusMessage *reply, const char *iface)
+{
+	DBusMessageIter it, arr;
+
+	if (!reply || !dbus_message_iter_init(reply, &it) ||
+	    dbus_message_iter_get_arg_type(&it) != DBUS_TYPE_ARRAY)
+		return 0;
+
+	dbus_message_iter_recurse(&it, &arr);
+	while (dbus_message_iter_get_arg_type(&arr) == DBUS_TYPE_STRING) {
+		const char *s;
+
+		dbus_message_iter_get_basic(&arr, &s);
+		if (!strcmp(s, iface))
+			return 1;
+
+		dbus_message_iter_next(&arr);
+	}
+
+	return 0;
+}
+
+/*
+ * Parse an a(so) array of object references (e.g the reply to GetChildren).
+ * Returns the number of references stored in out.
+ */
+static size_t parse_refs(DBusMessage *reply, struct node *out, size_t max)
+{
+	DBusMessageIter it, arr;
+	size_t n = 0;
+
+	if (!reply || !dbus_message_iter_init(reply, &it) ||
+	    dbus_message_iter_get_arg_type(&it) != DBUS_TYPE_ARRAY)
+		return 0;
+
+	dbus_message_iter_recurse(&it, &arr);
+	while (n < max &&
+	       dbus_message_iter_get_arg_type(&arr) == DBUS_TYPE_STRUCT) {
+		DBusMessageIter st;
+		const char *bus, *path;
+
+		dbus_message_iter_recurse(&arr, &st);
+		dbus_message_iter_get_basic(&st, &bus);
+		dbus_message_iter_next(&st);
+		dbus_message_iter_get_basic(&st, &path);
+
+		/* Skip null references and anything which won't fit. */
+		if (strlen(bus) < sizeof out[n].bus &&
+		    strlen(path) < sizeof out[n].path &&
+		    strcmp(path, "/org/a11y/atspi/null")) {
+			strcpy(out[n].bus, bus);
+			strcpy(out[n].path, path);
+			out[n].parent_actionable = 0;
+			n++;
+		}
+
+		dbus_message_iter_next(&arr);
+	}
+
+	return n;
+}
+
+static int role_is_actionable(uint32_t role, const uint32_t states[2])
+{
+	switch (role) {
+	case ROLE_CHECK_BOX:
+	case ROLE_CHECK_MENU_ITEM:
+	case ROLE_COMBO_BOX:
+	case ROLE_LIST_ITEM:
+	case ROLE_MENU:
+	case ROLE_MENU_ITEM:
+	case ROLE_PAGE_TAB:
+	case ROLE_PASSWORD_TEXT:
+	case ROLE_PUSH_BUTTON:
+	case ROLE_RADIO_BUTTON:
+	case ROLE_RADIO_MENU_ITEM:
+	case ROLE_SLIDER:
+	case ROLE_SPIN_BUTTON:
+	case ROLE_TABLE_CELL:
+	case ROLE_TOGGLE_BUTTON:
+	case ROLE_ENTRY:
+	case ROLE_LINK:
+	case ROLE_TREE_ITEM:
+		return 1;
+	case ROLE_TEXT:
+		return HAS_STATE(states, STATE_EDITABLE) != 0;
+	default:
+		return 0;
+	}
+}
+
+static int role_is_text_or_image(uint32_t role)
+{
+	return role == ROLE_LABEL || role == ROLE_STATIC ||
+	       role == ROLE_TEXT || role == ROLE_IMAGE || role == ROLE_ICON;
+}
+
+/* Expects ctx.mtx to be held. */
+static int position_exists(int x, int y)
+{
+	const int tolerance = 5;
+	size_t i;
+
+	for (i = 0; i < ctx.count; i++) {
+		int dx = ctx.hints[i].x - x;
+		int dy = ctx.hints[i].y - y;
+
+		if (dx >= -tolerance && dx <= tolerance && dy >= -tolerance &&
+		    dy <= tolerance)
+			return 1;
+	}
+
+	return 0;
+}
+
+/* Expects ctx.mtx to be held. */
+static void add_hint(int x, int y)
+{
+	if (ctx.count >= ctx.max_hints)
+		return;
+
+	if (position_exists(x, y)) {
+		ctx.prof.dup_skipped++;
+		return;
+	}
+
+	ctx.hints[ctx.count].x = x;
+	ctx.hints[ctx.count].y = y;
+	ctx.count++;
+	ctx.prof.hints_added++;
+}
+
+/* Expects ctx.mtx to be held. */
+static void enqueue(const struct node *n)
+{
+	if (ctx.tail - ctx.head >= QUEUE_SIZE) {
+		ctx.prof.queue_dropped++;
+		return;
+	}
+
+	ctx.queue[ctx.tail++ % QUEUE_SIZE] = *n;
+}
+
+static void process_node(DBusConnection *conn, const struct node *n)
+{
+	static const uint32_t coord_type_screen = 0;
+	int timeout = remaining_ms();
+	DBusPendingCall *pc[5];
+	DBusMessage *role_reply, *state_reply, *extents_reply, *iface_reply,
+	    *children_reply;
+
+	uint32_t role = 0;
+	uint32_t states[2] = {0};
+	int x = 0, y = 0, w = 0, h = 0;
+	int has_extents;
+	int actionable;
+	int interactable;
+	int traverse = 1;
+
+	if (!timeout)
+		return;
+
+	pc[0] = send_call(conn, n, ATSPI_ACCESSIBLE, "GetRole", NULL, timeout);
+	pc[1] =
+	    send_call(conn, n, ATSPI_ACCESSIBLE, "GetState", NULL, timeout);
+	pc[2] = send_call(conn, n, ATSPI_COMPONENT, "GetExtents",
+			  &coord_type_screen, timeout);
+	pc[3] = send_call(conn, n, ATSPI_ACCESSIBLE, "GetInterfaces", NULL,
+			  timeout);
+	pc[4] =
+	    send_call(conn, n, ATSPI_ACCESSIBLE, "GetChildren", NULL, timeout);
+
+	dbus_connection_flush(conn);
+
+	role_reply = finish_call(pc[0]);
+	state_reply = finish_call(pc[1]);
+	extents_reply = finish_call(pc[2]);
+	iface_reply = finish_call(pc[3]);
+	children_reply = finish_call(pc[4]);
+
+	parse_uint32(role_reply, &role);
+	parse_states(state_reply, states);
+	has_extents = !parse_extents(extents_reply, &x, &y, &w, &h);
+
+	if (!HAS_STATE(states, STATE_SHOWING) ||
+	    !HAS_STATE(states, STATE_VISIBLE))
+		traverse = 0;
+
+	if (traverse && has_extents) {
+		if (w <= 0 || h <= 0 || x + w < ctx.sx ||
+		    x > ctx.sx + ctx.sw || y + h < ctx.sy ||
+		    y > ctx.sy + ctx.sh)
+			traverse = 0;
+	}
+
+	actionable = role_is_actionable(role, states);
+
+	if (!actionable && has_interface(iface_reply, ATSPI_ACTION)) {
+		DBusMessage *msg, *reply;
+		const char *iface = ATSPI_ACTION;
+		const char *prop = "NActions";
+		int32_t nactions = 0;
+
+		/* The interface alone is not enough (many containers export it with no actions). */
+		msg = dbus_message_new_method_call(
+		    n->bus, n->path, "org.freedesktop.DBus.Properties", "Get");
+		dbus_message_append_args(msg, DBUS_TYPE_STRING, &iface,
+					 DBUS_TYPE_STRING, &prop,
+					 DBUS_TYPE_INVALID);
+		reply = dbus_connection_send_with_reply_and_block(
+		    conn, msg, call_timeout(), NULL);
+		dbus_message_unref(msg);
+
+		if (reply) {
+			parse_int32_variant(reply, &nactions);
+			dbus_message_unref(reply);
+		}
+
+		actionable = nactions > 0;
+	}
+
+	interactable = actionable ||
+		       (role_is_text_or_image(role) && !n->parent_actionable);
+
+	/* Toolkits make the descendants of insensitive widgets insensitive. */
+	if (!HAS_STATE(states, STATE_SENSITIVE)) {
+		interactable = 0;
+		traverse = 0;
+	}
+
+	pthread_mutex_lock(&ctx.mtx);
+
+	ctx.prof.nodes_visited++;
+
+	if (traverse && interactable) {
+		if (has_extents && w > 0 && h > 0) {
+			int cx = x + w / 2;
+			int cy = y + h / 2;
+
+			if (cx >= ctx.sx && cx < ctx.sx + ctx.sw &&
+			    cy >= ctx.sy && cy < ctx.sy + ctx.sh)
+				add_hint(cx - ctx.sx, cy - ctx.sy);
+			else
+				ctx.prof.offscreen_skipped++;
+		} else {
+			ctx.prof.offscreen_skipped++;
+		}
+	}
+
+	pthread_mutex_unlock(&ctx.mtx);
+
+	if (traverse && children_reply) {
+		struct node children[128];
+		size_t i;
+		size_t nr_children = parse_refs(children_reply, children,
+						 sizeof children / sizeof children[0]);
+
+		pthread_mutex_lock(&ctx.mtx);
+		for (i = 0; i < nr_children; i++) {
+			children[i].parent_actionable = actionable;
+			enqueue(&children[i]);
+		}
+		pthread_mutex_unlock(&ctx.mtx);
+	}
+
+	if (role_reply)
+		dbus_message_unref(role_reply);
+	if (state_reply)
+		dbus_message_unref(state_reply);
+	if (extents_reply)
+		dbus_message_unref(extents_reply);
+	if (iface_reply)
+		dbus_message_unref(iface_reply);
+	if (children_reply)
+		dbus_message_unref(children_reply);
+}
+
+static void *worker(void *arg)
+{
+	int idx = (int)(intptr_t)arg;
+	DBusConnection *conn = get_conn(idx);
+
+	if (!conn)
+		return NULL;
+
+	pthread_mutex_lock(&ctx.mtx);
+	while (1) {
+		struct node n;
+
+		if (!remaining_ms() || ctx.count >= ctx.max_hints)
+			break;
+
+		if (ctx.head == ctx.tail) {
+			struct timespec ts;
+
+			/* Nothing left to do once the queue is drained and all workers are idle. */
+			if (!ctx.busy)
+				break;
+
+			clock_gettime(CLOCK_REALTIME, &ts);
+			ts.tv_nsec += 10 * 1000000;
+			if (ts.tv_nsec >= 1000000000) {
+				ts.tv_sec++;
+				ts.tv_nsec -= 1000000000;
+			}
+
+			pthread_cond_timedwait(&ctx.cond, &ctx.mtx, &ts);
+			continue;
+		}
+
+		n = ctx.queue[ctx.head++ % QUEUE_SIZE];
+		ctx.busy++;
+		pthread_mutex_unlock(&ctx.mtx);
+
+		process_node(conn, &n);
+
+		pthread_mutex_lock(&ctx.mtx);
+		ctx.busy--;
+		pthread_cond_broadcast(&ctx.cond);
+	}
+
+	pthread_cond_broadcast(&ctx.cond);
+	pthread_mutex_unlock(&ctx.mtx);
+
+	return NULL;
+}
+
+/*
+ * Locate the frame which currently has STATE_ACTIVE by querying the
+ * top level windows of every registered application. Requests are
+ * pipelined so this costs two round trips regardless of the number
+ * of applications.
+ */
+static int find_active_frame(DBusConnection *conn, struct node *out)
+{
+	static struct node apps[128];
+	static struct node frames[256];
+	static DBusPendingCall *pcs[256];
+
+	const struct node root = {ATSPI_REGISTRY, ATSPI_ROOT, 0};
+	DBusMessage *reply;
+	size_t i;
+	size_t nr_apps;
+	size_t nr_frames = 0;
+	int found = -1;
+
+	reply = finish_call(send_call(conn, &root, ATSPI_ACCESSIBLE,
+				      "GetChildren", NULL, call_timeout()));
+	nr_apps = parse_refs(reply, apps, sizeof apps / sizeof apps[0]);
+	if (reply)
+		dbus_message_unref(reply);
+
+	for (i = 0; i < nr_apps; i++)
+		pcs[i] = send_call(conn, &apps[i], ATSPI_ACCESSIBLE,
+				   "GetChildren", NULL, call_timeout());
+
+	dbus_connection_flush(conn);
+
+	for (i = 0; i < nr_apps; i++) {
+		reply = finish_call(pcs[i]);
+		nr_frames += parse_refs(reply, frames + nr_frames,
+					sizeof frames / sizeof frames[0] -
+					    nr_frames);
+		if (reply)
+			dbus_message_unref(reply);
+	}
+
+	for (i = 0; i < nr_frames; i++)
+		pcs[i] = send_call(conn, &frames[i], ATSPI_ACCESSIBLE,
+				   "GetState", NULL, call_timeout());
+
+	dbus_connection_flush(conn);
+
+	for (i = 0; i < nr_frames; i++) {
+		uint32_t states[2];
+
+		reply = finish_call(pcs[i]);
+		if (found == -1 && !parse_states(reply, states) &&
+		    HAS_STATE(states, STATE_ACTIVE))
+			found = i;
+
+		if (reply)
+			dbus_message_unref(reply);
+	}
+
+	if (found == -1)
+		return -1;
+
+	*out = frames[found];
+	return 0;
+}
+
+size_t atspi_collect_interactable_hints(int sx, int sy, int sw, int sh,
+					struct hint *hints, size_t max_hints)
+{
+	static int initialized = 0;
+	static int warned = 0;
+
+	pthread_t threads[MAX_WORKERS];
+	int started[MAX_WORKERS] = {0};
+	struct node root;
+	uint64_t start = get_time_us();
+	int nr_workers = env_int("WARPD_ATSPI_WORKERS", 4);
+	int deadline_ms = env_int("WARPD_ATSPI_DEADLINE_MS", 300);
+	int i;
+
+	if (!max_hints)
+		return 0;
+
+	if (!initialized) {
+		dbus_threads_init_default();
+		initialized = 1;
+	}
+
+	if (nr_workers < 1)
+		nr_workers = 1;
+	if (nr_workers > MAX_WORKERS)
+		nr_workers = MAX_WORKERS;
+
+	if (!get_conn(0)) {
+		if (!warned)
+			fprintf(stderr,
+				"atspi: accessibility bus unavailable, is "
+				"accessibility enabled?\n");
+		warned = 1;
+		return 0;
+	}
+
+	ctx.sx = sx;
+	ctx.sy = sy;
+	ctx.sw = sw;
+	ctx.sh = sh;
+	ctx.hints = hints;
+	ctx.count = 0;
+	ctx.max_hints = max_hints;
+	ctx.head = 0;
+	ctx.tail = 0;
+	ctx.busy = 0;
+	ctx.deadline_us = start + (uint64_t)deadline_ms * 1000;
+	memset(&ctx.prof, 0, sizeof ctx.prof);
+
+	if (find_active_frame(conns[0], &root))
+		return 0;
+
+	enqueue(&root);
+
+	for (i = 1; i < nr_workers; i++)
+		started[i] = !pthread_create(&threads[i], NULL, worker,
+					     (void *)(intptr_t)i);
+
+	worker((void *)0);
+
+	for (i = 1; i < nr_workers; i++)
+		if (started[i])
+			pthread_join(threads[i], NULL);
+
+	if (getenv("WARPD_ATSPI_DEBUG"))
+		fprintf(stderr,
+			"atspi: nodes=%zu hints=%zu dup=%zu offscreen=%zu "
+			"dropped=%zu workers=%d ms=%.2f\n",
+			ctx.prof.nodes_visited, ctx.prof.hints_added,
+			ctx.prof.dup_skipped, ctx.prof.offscreen_skipped,
+			ctx.prof.queue_dropped, nr_workers,
+			(get_time_us() - start) / 1000.0);
+
+	return ctx.count;
+}
+
+/* Pending events are drained without blocking. */
+uint64_t atspi_generation()
+{
+	static const char *events[] = {
+	    "object:children-changed",
+	    "object:bounds-changed",
+	    "object:state-changed:showing",
+	    "object:state-changed:visible",
+	    "window:",
+	};
+
+	static pthread_mutex_t mtx = PTHREAD_MUTEX_INITIALIZER;
+	static DBusConnection *conn = NULL;
+	static uint64_t generation = 0;
+	static int failed = 0;
+
+	DBusMessage *msg;
+	size_t i;
+
+	pthread_mutex_lock(&mtx);
+
+	if (!conn && !failed) {
+		DBusError err;
+		const char *address;
+
+		dbus_threads_init_default();
+		dbus_error_init(&err);
+
+		if (!(address = a11y_bus_address()) ||
+		    !(conn = dbus_connection_open_private(address, &err)) ||
+		    !dbus_bus_register(conn, &err)) {
+			if (conn) {
+				dbus_connection_close(conn);
+				dbus_connection_unref(conn);
+				conn = NULL;
+			}
+
+			dbus_error_free(&err);
+			failed = 1;
+			goto out;
+		}
+
+		dbus_connection_set_exit_on_disconnect(conn, FALSE);
+
+		dbus_bus_add_match(conn,
+				   "type='signal',interface='org.a11y.atspi."
+				   "Event.Object'",
+				   NULL);
+		dbus_bus_add_match(conn,
+				   "type='signal',interface='org.a11y.atspi."
+				   "Event.Window'",
+				   NULL);
+
+		/* Applications only emit events which have a registered listener. */
+		for (i = 0; i < sizeof events / sizeof events[0]; i++) {
+			msg = dbus_message_new_method_call(
+			    ATSPI_REGISTRY, "/org/a11y/atspi/registry",
+			    "org.a11y.atspi.Registry", "RegisterEvent");
+			dbus_message_append_args(msg, DBUS_TYPE_STRING,
+						 &events[i], DBUS_TYPE_INVALID);
+			dbus_connection_send(conn, msg, NULL);
+			dbus_message_unref(msg);
+		}
+
+		dbus_connection_flush(conn);
+	}
+
+	if (!conn)
+		goto out;
+
+	dbus_connection_read_write(conn, 0);
+	while ((msg = dbus_connection_pop_message(conn))) {
+		if (dbus_message_get_type(msg) == DBUS_MESSAGE_TYPE_SIGNAL)
+			generation++;
+
+		dbus_message_unref(msg);
+	}
+
+	if (!dbus_connection_get_is_connected(conn)) {
+		dbus_connection_close(conn);
+		dbus_connection_unref(conn);
+		conn = NULL;
+		generation++;
+	}
+
+out:
+	pthread_mutex_unlock(&mtx);
+	return generation;
+}
@@ -0,0 +1,27 @@
+/*
+ * warpd - A modal keyboard-driven pointing system.
+ *
+ * © 2019 Raheman Vaiya (see: LICENSE).
+ */
+
+#ifndef WARPD_ATSPI_H
+#define WARPD_ATSPI_H
+
+#include "../../../platform.h"
+
+/*
+ * Populate hints with the center points of interactable elements in the
+ * focused window which lie within the supplied screen rectangle (in absolute
+ * coordinates). The resulting points are relative to the screen. Not
+ * reentrant.
+ */
+size_t atspi_collect_interactable_hints(int sx, int sy, int sw, int sh,
+					struct hint *hints, size_t max_hints);
+
+/*
+ * Returns a counter which changes whenever accessibility events suggest
+ * that the collected elements may be stale. Safe to call from any thread.
+ */
+uint64_t atspi_generation();
+
+#endif
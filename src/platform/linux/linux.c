@@ -23,7 +23,8 @@ void wayland_init()
 
 void platform_run(int (*main) (struct platform *platform))
 {
-	struct platform platform;
+	/* Zero initialize so unimplemented (optional) hooks are NULL. */
+	struct platform platform = {0};
 
 	if (getenv("WAYLAND_DISPLAY"))
 		wayland_init(&platform);
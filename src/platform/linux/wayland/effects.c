@@ -0,0 +1,110 @@
+/*
+ * keyd - A key remapping daemon.
+ *
+ * © 2019 Raheman Vaiya (see also: LICENSE).
+ */
+#include "wayland.h"
+#include "../../../warpd.h"
+
+/* Beyond this the whole surface is damaged. */
+#define MAX_DAMAGE 64
+
+static void clear_rect(struct frame *f, const struct screen_rect *r)
+{
+	int x0 = MAX(0, r->x);
+	int y0 = MAX(0, r->y);
+	int x1 = MIN(f->w, r->x + r->w);
+	int y1 = MIN(f->h, r->y + r->h);
+	int y;
+
+	if (x1 <= x0)
+		return;
+
+	for (y = y0; y < y1; y++)
+		memset(f->data + y * f->stride / 4 + x0, 0,
+		       (x1 - x0) * sizeof(uint32_t));
+}
+
+/* Logical to device pixels, rounding outwards. */
+static struct screen_rect scale_rect(struct framebuffer *fb,
+				     const struct screen_rect *r)
+{
+	int x0 = r->x * fb->scale / 120;
+	int y0 = r->y * fb->scale / 120;
+	int x1 = ((r->x + r->w) * fb->scale + 119) / 120;
+	int y1 = ((r->y + r->h) * fb->scale + 119) / 120;
+
+	return (struct screen_rect){r->scr, x0, y0, x1 - x0, y1 - y0};
+}
+
+/*
+ * Rings (see anim.c) are drawn into a surface of their own so that they
+ * animate independently of boxes and hints. Each frame only the damaged
+ * area is redrawn and presented, the surface is hidden once the last
+ * ring is gone.
+ */
+void way_screen_draw_rings(struct screen *scr, const struct ring *rings,
+			   size_t n, const struct screen_rect *damage,
+			   size_t nr_damage)
+{
+	static struct screen_rect scaled[MAX_DAMAGE];
+
+	struct framebuffer *fb = &scr->effect_fb;
+	struct screen_rect extent = {0};
+	struct frame *f;
+	size_t i;
+
+	if (!n) {
+		if (scr->effects)
+			surface_hide(scr->effects);
+		return;
+	}
+
+	if (!scr->effects)
+		scr->effects = create_screen_surface(scr);
+
+	framebuffer_update(scr, fb);
+	f = framebuffer_get_frame(fb);
+
+	/* The rings the frame was last drawn with (possibly two frames ago). */
+	clear_rect(f, &f->extent);
+
+	for (i = 0; i < n; i++) {
+		int x0, y0, x1, y1;
+		struct ring r = {
+		    .x = framebuffer_scale(fb, rings[i].x),
+		    .y = framebuffer_scale(fb, rings[i].y),
+		    .radius = framebuffer_scale(fb, rings[i].radius),
+		    .line_width = framebuffer_scale(fb, rings[i].line_width),
+		    .color = rings[i].color,
+		};
+		int reach;
+
+		r.line_width = MAX(1, r.line_width);
+		reach = r.radius + r.line_width / 2 + 2;
+
+		raster_draw_ring(f->data, f->stride / 4, f->w, f->h, 0, 0, &r);
+
+		x0 = i ? MIN(extent.x, r.x - reach) : r.x - reach;
+		y0 = i ? MIN(extent.y, r.y - reach) : r.y - reach;
+		x1 = i ? MAX(extent.x + extent.w, r.x + reach) : r.x + reach;
+		y1 = i ? MAX(extent.y + extent.h, r.y + reach) : r.y + reach;
+
+		extent = (struct screen_rect){scr, x0, y0, x1 - x0, y1 - y0};
+	}
+
+	f->extent = extent;
+
+	/*
+	 * Everything outside of the damage is transparent in both this and
+	 * the front frame.
+	 */
+	for (i = 0; i < nr_damage && i < MAX_DAMAGE; i++)
+		scaled[i] = scale_rect(fb, &damage[i]);
+
+	surface_present(scr->effects, f->wl_buffer, f->w, f->h,
+			nr_damage > MAX_DAMAGE ? NULL : scaled, nr_damage);
+
+	f->busy = 1;
+	fb->front = f;
+}
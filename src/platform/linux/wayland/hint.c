@@ -4,11 +4,15 @@
  * © 2019 Raheman Vaiya (see also: LICENSE).
  */
 #include "wayland.h"
+#include "../../../warpd.h"
+
+#include <math.h>
 
 static char bgcolor[16];
 static char fgcolor[16];
 static char border_color[16];
 static int border_width;
+static int border_radius;
 static const char *font_family;
 
 static int calculate_font_size(cairo_t *cr, int w, int h)
@@ -28,6 +32,69 @@ static int calculate_font_size(cairo_t *cr, int w, int h)
 	return sz;
 }
 
+/* Supplies the glyphs of the hint font to the software rasterizer. */
+static int render_glyphs(struct raster_atlas *atlas, const char *font, int w,
+			 int h)
+{
+	cairo_surface_t *sfc = cairo_image_surface_create(CAIRO_FORMAT_A8, 1, 1);
+	cairo_t *cr = cairo_create(sfc);
+	cairo_font_extents_t fe;
+	int size;
+	char c;
+
+	size = calculate_font_size(cr, w, h);
+	cairo_set_font_size(cr, size);
+	cairo_font_extents(cr, &fe);
+
+	raster_atlas_set_metrics(atlas, ceil(fe.ascent), ceil(fe.descent));
+
+	for (c = 32; c < 127; c++) {
+		const char s[2] = {c, 0};
+		cairo_text_extents_t te;
+		cairo_surface_t *gsfc;
+		cairo_t *gcr;
+		int gw, gh, left, top;
+
+		cairo_text_extents(cr, s, &te);
+
+		/* Leave a pixel on each side for antialiasing. */
+		left = floor(te.x_bearing) - 1;
+		top = 1 - floor(te.y_bearing);
+		gw = ceil(te.width) + 3;
+		gh = ceil(te.height) + 3;
+
+		gsfc = cairo_image_surface_create(CAIRO_FORMAT_A8, gw, gh);
+		gcr = cairo_create(gsfc);
+
+		cairo_select_font_face(gcr, font, CAIRO_FONT_SLANT_NORMAL,
+				       CAIRO_FONT_WEIGHT_NORMAL);
+		cairo_set_font_size(gcr, size);
+		cairo_move_to(gcr, -left, top);
+		cairo_show_text(gcr, s);
+		cairo_surface_flush(gsfc);
+
+		raster_atlas_add_glyph(atlas, c, cairo_image_surface_get_data(gsfc),
+				       gw, gh, cairo_image_surface_get_stride(gsfc),
+				       left, top, lround(te.x_advance));
+
+		cairo_destroy(gcr);
+		cairo_surface_destroy(gsfc);
+	}
+
+	cairo_destroy(cr);
+	cairo_surface_destroy(sfc);
+
+	return 0;
+}
+
+static uint32_t color(const char *s)
+{
+	uint8_t r, g, b, a;
+
+	way_hex_to_rgba(s, &r, &g, &b, &a);
+	return raster_color(r, g, b, a);
+}
+
 static void cairo_draw_text(cairo_t *cr, const char *s, int x, int y, int w,
 			    int h)
 {
@@ -46,19 +113,72 @@ static void cairo_draw_text(cairo_t *cr, const char *s, int x, int y, int w,
 	cairo_show_text(cr, s);
 }
 
-void way_hint_draw(struct screen *scr, struct hint *hints, size_t n)
+static int overlaps(const struct hint *a, const struct hint *b)
 {
-	size_t i;
-	uint8_t r, g, b, a;
+	return a->x < b->x + b->w && b->x < a->x + a->w &&
+	       a->y < b->y + b->h && b->y < a->y + a->h;
+}
+
+/*
+ * Store the hints which occur in only one of a and b in diff, provided the
+ * smaller set is an ordered subset of the larger one (e.g after filtering)
+ * and none of them overlap the common hints. Returns the number of such
+ * hints, or -1 if the sets are not related in this way.
+ */
+static int hint_diff(const struct hint *a, size_t na, const struct hint *b,
+		     size_t nb, struct hint *diff)
+{
+	size_t i = 0, j, k;
+	size_t n = 0;
+
+	if (na < nb)
+		return hint_diff(b, nb, a, na, diff);
+
+	for (j = 0; j < na; j++) {
+		if (i < nb && !memcmp(&a[j], &b[i], sizeof(struct hint)))
+			i++;
+		else
+			diff[n++] = a[j];
+	}
+
+	/* Beyond this a full redraw is cheaper than checking for overlap. */
+	if (i != nb || n * nb > 1 << 20)
+		return -1;
+
+	for (j = 0; j < n; j++)
+		for (k = 0; k < nb; k++)
+			if (overlaps(&diff[j], &b[k]))
+				return -1;
+
+	return n;
+}
 
-	cairo_t *cr = scr->cr;
+static void clear_rect(struct frame *f, const struct hint *h)
+{
+	int x0 = MAX(0, h->x);
+	int y0 = MAX(0, h->y);
+	int x1 = MIN(f->w, h->x + h->w);
+	int y1 = MIN(f->h, h->y + h->h);
+	int y;
+
+	if (x1 <= x0)
+		return;
 
-	if (scr->hints)
-		destroy_surface(scr->hints);
+	for (y = y0; y < y1; y++)
+		memset(f->data + y * f->stride / 4 + x0, 0,
+		       (x1 - x0) * sizeof(uint32_t));
+}
+
+static void cairo_draw_hints(cairo_t *cr, struct hint *hints, size_t n,
+			     int bw)
+{
+	size_t i;
+	uint8_t r, g, b, a;
 
 	cairo_set_operator(cr, CAIRO_OPERATOR_SOURCE);
 	cairo_set_source_rgba(cr, 0, 0, 0, 0);
 	cairo_paint(cr);
+	cairo_set_operator(cr, CAIRO_OPERATOR_OVER);
 
 	for (i = 0; i < n; i++) {
 		way_hex_to_rgba(bgcolor, &r, &g, &b, &a);
@@ -68,11 +188,11 @@ void way_hint_draw(struct screen *scr, struct hint *hints, size_t n)
 				hints[i].h);
 		cairo_fill(cr);
 
-		if (border_width > 0) {
+		if (bw > 0) {
 			way_hex_to_rgba(border_color, &r, &g, &b, &a);
 			cairo_set_source_rgba(cr, r / 255.0, g / 255.0,
 					      b / 255.0, a / 255.0);
-			cairo_set_line_width(cr, border_width);
+			cairo_set_line_width(cr, bw);
 			cairo_rectangle(cr, hints[i].x, hints[i].y, hints[i].w,
 					hints[i].h);
 			cairo_stroke(cr);
@@ -85,19 +205,172 @@ void way_hint_draw(struct screen *scr, struct hint *hints, size_t n)
 		cairo_draw_text(cr, hints[i].label, hints[i].x, hints[i].y,
 				hints[i].w, hints[i].h);
 	}
+}
+
+/*
+ * Hints are drawn into whichever of the screen's frames the compositor has
+ * released. Only the hints which differ from those the frame already
+ * contains are redrawn, and only those which differ from the front frame
+ * are damaged. Frames are in device pixels, so everything is scaled up
+ * front and the surface viewport maps it back to the logical size.
+ */
+void way_hint_draw(struct screen *scr, struct hint *logical, size_t n)
+{
+	/* Scratch space, grown to fit the largest hint sets drawn. */
+	static struct hint *hints;
+	static struct hint *changed;
+	static struct screen_rect *damage;
+	static size_t scratch_sz;
+
+	struct framebuffer *fb = &scr->hint_fb;
+	struct frame *f;
+	struct frame *front;
+	cairo_surface_t *target;
+	int nr_damage = -1;
+	int nr_changed = -1;
+	int redraw = 1;
+	size_t max;
+	int bw;
+	int i;
+
+	framebuffer_update(scr, fb);
+
+	f = framebuffer_get_frame(fb);
+	front = fb->front;
+	target = cairo_get_target(f->cr);
+	bw = framebuffer_scale(fb, border_width);
+
+	/* Differences are bounded by the larger of the sets compared. */
+	max = MAX(n, f->nr_hints);
+	if (front)
+		max = MAX(max, front->nr_hints);
+
+	if (max > scratch_sz) {
+		hints = realloc(hints, max * sizeof *hints);
+		changed = realloc(changed, max * sizeof *changed);
+		damage = realloc(damage, max * sizeof *damage);
+		assert(hints && changed && damage);
+
+		scratch_sz = max;
+	}
+
+	if (n > f->hints_sz) {
+		f->hints = realloc(f->hints, n * sizeof *f->hints);
+		assert(f->hints);
+
+		f->hints_sz = n;
+	}
+
+	for (i = 0; i < (int)n; i++) {
+		/* Scale the edges so that adjacent hints stay adjacent. */
+		int x0 = framebuffer_scale(fb, logical[i].x);
+		int y0 = framebuffer_scale(fb, logical[i].y);
+
+		hints[i] = logical[i];
+		hints[i].x = x0;
+		hints[i].y = y0;
+		hints[i].w =
+		    framebuffer_scale(fb, logical[i].x + logical[i].w) - x0;
+		hints[i].h =
+		    framebuffer_scale(fb, logical[i].y + logical[i].h) - y0;
+	}
 
-	scr->hints = create_surface(scr, 0, 0, scr->w, scr->h, 0);
+	struct raster_style style = {
+	    .bg = color(bgcolor),
+	    .fg = color(fgcolor),
+	    .border = color(border_color),
+	    .border_width = bw,
+	    .border_radius = framebuffer_scale(fb, border_radius),
+	};
+
+	if (f->valid && f->rasterized)
+		nr_changed = hint_diff(f->hints, f->nr_hints, hints, n, changed);
+
+	cairo_surface_flush(target);
+
+	if (nr_changed >= 0 && f->nr_hints >= n) {
+		for (i = 0; i < nr_changed; i++)
+			clear_rect(f, &changed[i]);
+		redraw = 0;
+	} else if (nr_changed >= 0 &&
+		   !raster_draw_hints(f->data, f->stride / 4, f->w, f->h, 0,
+				      changed, nr_changed, &style,
+				      font_family, render_glyphs)) {
+		redraw = 0;
+	}
+
+	if (redraw) {
+		/* Render directly into the shm buffer where possible. */
+		f->rasterized = !raster_draw_hints(f->data, f->stride / 4,
+						   f->w, f->h, 1, hints, n,
+						   &style, font_family,
+						   render_glyphs);
+		if (!f->rasterized) {
+			cairo_surface_mark_dirty(target);
+			cairo_draw_hints(f->cr, hints, n, bw);
+			cairo_surface_flush(target);
+		}
+	}
+
+	cairo_surface_mark_dirty(target);
+
+	if (!redraw && f == front) {
+		/* Drawn in place, so the changes are exactly the damage. */
+		nr_damage = nr_changed;
+		for (i = 0; i < nr_damage; i++)
+			damage[i] = (struct screen_rect){
+			    .x = changed[i].x,
+			    .y = changed[i].y,
+			    .w = changed[i].w,
+			    .h = changed[i].h,
+			};
+	} else if (f != front && front && front->valid &&
+		   front->rasterized == f->rasterized) {
+		nr_damage = hint_diff(front->hints, front->nr_hints, hints, n,
+				      changed);
+
+		/* Cairo strokes the border across the edge of the hint. */
+		for (i = 0; i < nr_damage; i++)
+			damage[i] = (struct screen_rect){
+			    .x = changed[i].x - bw,
+			    .y = changed[i].y - bw,
+			    .w = changed[i].w + 2 * bw,
+			    .h = changed[i].h + 2 * bw,
+			};
+	}
+
+	memcpy(f->hints, hints, n * sizeof(struct hint));
+	f->nr_hints = n;
+	f->valid = 1;
+
+	if (!scr->hints)
+		scr->hints = create_screen_surface(scr);
+
+	surface_present(scr->hints, f->wl_buffer, f->w, f->h,
+			nr_damage < 0 ? NULL : damage, MAX(nr_damage, 0));
+
+	f->busy = 1;
+	fb->front = f;
 }
 
-void way_init_hint(const char *bg, const char *fg, int border_radius,
+void way_init_hint(const char *bg, const char *fg, int _border_radius,
 		   const char *border_col, int _border_width, const char *font)
 {
+	size_t i;
+
 	strncpy(bgcolor, bg, sizeof bgcolor);
 	strncpy(fgcolor, fg, sizeof fgcolor);
 	strncpy(border_color, border_col, sizeof border_color);
 	border_width = _border_width;
 
-	// TODO: handle border radius
+	/* Only honoured by the software rasterizer. */
+	border_radius = _border_radius;
 
 	font_family = font;
+
+	/* The style may have changed. */
+	for (i = 0; i < nr_screens; i++) {
+		screens[i].hint_fb.frames[0].valid = 0;
+		screens[i].hint_fb.frames[1].valid = 0;
+	}
 }
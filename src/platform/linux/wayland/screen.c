@@ -39,30 +39,51 @@ static struct zxdg_output_v1_listener zxdg_output_v1_listener = {
 	.description = noop,
 };
 
+/* The screen and offset of the surface the pointer is over (if any). */
+static struct screen *pointer_scr;
+static int pointer_dx;
+static int pointer_dy;
+
 static void handle_pointer_enter(void *data,
 				 struct wl_pointer *wl_pointer,
 				 uint32_t serial,
 				 struct wl_surface *surface,
 				 wl_fixed_t wlx, wl_fixed_t wly)
 {
-	int i;
+	pointer_scr = surface_lookup(surface, &pointer_dx, &pointer_dy);
 
-	if (!ptr.scr) {
-		ptr.x = wl_fixed_to_int(wlx);
-		ptr.y = wl_fixed_to_int(wly);
+	if (pointer_scr) {
+		ptr.scr = pointer_scr;
+		ptr.x = pointer_dx + wl_fixed_to_int(wlx);
+		ptr.y = pointer_dy + wl_fixed_to_int(wly);
+	}
+}
 
-		for (i = 0; i < nr_screens; i++) {
-			struct screen *scr = &screens[i];
-			if (scr->overlay && surface == surface_get_wl_surface(scr->overlay))
-				ptr.scr = scr;
-		}
+static void handle_pointer_leave(void *data, struct wl_pointer *wl_pointer,
+				 uint32_t serial, struct wl_surface *surface)
+{
+	pointer_scr = NULL;
+}
+
+static void handle_pointer_motion(void *data, struct wl_pointer *wl_pointer,
+				  uint32_t time, wl_fixed_t wlx, wl_fixed_t wly)
+{
+	if (pointer_scr) {
+		ptr.scr = pointer_scr;
+		ptr.x = pointer_dx + wl_fixed_to_int(wlx);
+		ptr.y = pointer_dy + wl_fixed_to_int(wly);
 	}
 }
 
+/*
+ * Registered for the lifetime of the program, so the position is kept up
+ * to date whenever the pointer is over one of our surfaces (in addition to
+ * our own motion, see way_mouse_move).
+ */
 static struct wl_pointer_listener wl_pointer_listener = {
 	.enter = handle_pointer_enter,
-	.leave = noop,
-	.motion = noop,
+	.leave = handle_pointer_leave,
+	.motion = handle_pointer_motion,
 	.button = noop,
 	.axis = noop,
 	.frame = noop,
@@ -71,20 +92,23 @@ static struct wl_pointer_listener wl_pointer_listener = {
 	.axis_discrete = noop,
 };
 
-/* 
- * Register a pointer_listener and listen for enter events after
- * creating a full screen surface for each screen in order to capture the initial
- * cursor position. I couldn't find a better way to achieve this :/.
+/*
+ * The last resort for obtaining the pointer position when it is needed
+ * before it is otherwise known: listen for enter events after creating a
+ * full screen surface for each screen. I couldn't find a better way to
+ * achieve this :/.
  */
-static void discover_pointer_location()
+void discover_pointer_location()
 {
 	size_t i;
 
-	wl_pointer_add_listener(wl_seat_get_pointer(wl.seat), &wl_pointer_listener, NULL);
-
 	for (i = 0; i < nr_screens; i++) {
 		struct screen *scr = &screens[i];
 		scr->overlay = create_surface(scr, 0, 0, scr->w, scr->h, 0);
+		surface_accept_pointer(scr->overlay);
+
+		/* Learn the preferred scale before anything is drawn. */
+		surface_track_scale(scr->overlay);
 	}
 
 	wl_display_flush(wl.dpy);
@@ -108,11 +132,128 @@ static void discover_pointer_location()
 	}
 }
 
+static void output_handle_mode(void *data, struct wl_output *wl_output,
+			       uint32_t flags, int32_t w, int32_t h,
+			       int32_t refresh)
+{
+	struct screen *scr = data;
+
+	if (flags & WL_OUTPUT_MODE_CURRENT)
+		scr->refresh_rate = refresh;
+}
+
+static void output_handle_scale(void *data, struct wl_output *wl_output,
+				int32_t factor)
+{
+	struct screen *scr = data;
+
+	scr->output_scale = factor;
+}
+
+/* Bound at version 3, so name and description are never sent. */
+static const struct wl_output_listener wl_output_listener = {
+	.geometry = noop,
+	.mode = output_handle_mode,
+	.done = noop,
+	.scale = output_handle_scale,
+};
+
 void add_screen(struct wl_output *output)
 {
 	struct screen *scr = &screens[nr_screens++];
 	scr->overlay = NULL;
 	scr->wl_output = output;
+	scr->output_scale = 1;
+
+	wl_output_add_listener(output, &wl_output_listener, scr);
+}
+
+/* Create a shared memory pool of the given size and map it. */
+static void *create_pool(size_t sz, struct wl_shm_pool **pool)
+{
+	static int shm_num = 0;
+	char shm_path[64];
+	void *buf;
+	int fd;
+
+	sprintf(shm_path, "/warpd_%d", shm_num++);
+
+	fd = shm_open(shm_path, O_CREAT|O_TRUNC|O_RDWR, 0600);
+	if (fd < 0) {
+		perror("shm_open");
+		exit(-1);
+	}
+
+	/* Only referenced by the mapping from here on. */
+	shm_unlink(shm_path);
+	ftruncate(fd, sz);
+
+	*pool = wl_shm_create_pool(wl.shm, fd, sz);
+	buf = mmap(NULL, sz, PROT_READ|PROT_WRITE, MAP_SHARED, fd, 0);
+	close(fd);
+
+	return buf;
+}
+
+/* A 1x1 ARGB8888 buffer of the given (premultiplied) color. */
+static struct wl_buffer *shm_pixel(size_t slot, uint32_t pixel)
+{
+	static struct wl_shm_pool *pool;
+	static uint32_t *pixels;
+
+	if (!pool)
+		pixels = create_pool(MAX_COLORS * sizeof(uint32_t), &pool);
+
+	pixels[slot] = pixel;
+
+	return wl_shm_pool_create_buffer(pool, slot * sizeof(uint32_t), 1, 1, 4,
+					 WL_SHM_FORMAT_ARGB8888);
+}
+
+/*
+ * Single pixel buffers of each color, which box surfaces scale to the size
+ * of the box. Colors come from the config, so there are only ever a
+ * handful.
+ */
+static struct wl_buffer *color_buffer(const char *color)
+{
+	static struct {
+		char color[16];
+		struct wl_buffer *buf;
+	} cache[MAX_COLORS];
+	static size_t next = 0;
+
+	struct wl_buffer *buf;
+	uint8_t r = 0, g = 0, b = 0, a = 255;
+	size_t i;
+
+	for (i = 0; i < MAX_COLORS; i++)
+		if (cache[i].buf && !strcmp(cache[i].color, color))
+			return cache[i].buf;
+
+	way_hex_to_rgba(color, &r, &g, &b, &a);
+
+	/* Premultiplied. */
+	r = r * a / 255;
+	g = g * a / 255;
+	b = b * a / 255;
+
+	if (wl.single_pixel_buffer_manager)
+		buf = wp_single_pixel_buffer_manager_v1_create_u32_rgba_buffer(
+		    wl.single_pixel_buffer_manager, r * 0x01010101u,
+		    g * 0x01010101u, b * 0x01010101u, a * 0x01010101u);
+	else
+		buf = shm_pixel(next, a << 24 | r << 16 | g << 8 | b);
+
+	/* Evict the oldest color if the cache is full (unlikely). */
+	if (cache[next].buf)
+		wl_buffer_destroy(cache[next].buf);
+
+	snprintf(cache[next].color, sizeof cache[next].color, "%s", color);
+	cache[next].buf = buf;
+	next = (next + 1) % MAX_COLORS;
+
+	return buf;
 }
 
 void way_screen_draw_box(struct screen *scr, int x, int y, int w, int h, const char *color)
@@ -121,12 +262,31 @@ void way_screen_draw_box(struct screen *scr, int x, int y, int w, int h, const c
 
 	assert(scr->nr_boxes < MAX_BOXES);
 
+	if (wl.viewporter) {
+		struct wl_buffer *buf = color_buffer(color);
+
+		if (scr->nr_boxes == scr->nr_pooled_boxes)
+			scr->boxes[scr->nr_pooled_boxes++] =
+			    create_solid_surface(scr, x, y, w, h, buf);
+		else
+			surface_fill(scr->boxes[scr->nr_boxes], x, y, w, h, buf);
+
+		scr->nr_boxes++;
+		return;
+	}
+
 	way_hex_to_rgba(color, &r, &g, &b, &a);
 	cairo_set_source_rgba(scr->cr, r / 255.0, g / 255.0, b / 255.0, a / 255.0);
 	cairo_rectangle(scr->cr, x, y, w, h);
 	cairo_fill(scr->cr);
 
-	scr->boxes[scr->nr_boxes++] = create_surface(scr, x, y, w, h, 0);
+	if (scr->nr_boxes == scr->nr_pooled_boxes)
+		scr->boxes[scr->nr_pooled_boxes++] =
+		    create_surface(scr, x, y, w, h, 0);
+	else
+		surface_update(scr->boxes[scr->nr_boxes], x, y, w, h);
+
+	scr->nr_boxes++;
 }
 
 
@@ -136,48 +296,177 @@ void way_screen_get_dimensions(struct screen *scr, int *w, int *h)
 	*h = scr->h;
 }
 
+int way_screen_get_refresh_rate(struct screen *scr)
+{
+	return scr->refresh_rate;
+}
+
 void way_screen_clear(struct screen *scr)
 {
 	size_t i;
 	for (i = 0; i < scr->nr_boxes; i++)
-		destroy_surface(scr->boxes[i]);
+		surface_hide(scr->boxes[i]);
 
-	destroy_surface(scr->hints);
+	if (scr->hints)
+		surface_hide(scr->hints);
 
 	scr->nr_boxes = 0;
-	scr->hints = NULL;
 }
 
+static void handle_frame_release(void *data, struct wl_buffer *wl_buffer)
+{
+	struct frame *f = data;
+
+	f->busy = 0;
+}
+
+static const struct wl_buffer_listener frame_listener = {
+	.release = handle_frame_release,
+};
+
+static cairo_t *create_cairo(char *buf, int w, int h, size_t stride)
+{
+	cairo_surface_t *cairo_surface;
+
+	cairo_surface = cairo_image_surface_create_for_data((unsigned char *)buf,
+							    CAIRO_FORMAT_ARGB32, w,
+							    h, stride);
+	return cairo_create(cairo_surface);
+}
+
+static void destroy_cairo(cairo_t *cr)
+{
+	cairo_surface_t *sfc = cairo_get_target(cr);
+
+	cairo_destroy(cr);
+	cairo_surface_destroy(sfc);
+}
+
+/*
+ * The screen's pool consists of the box area (only needed if boxes can't be
+ * scaled from a single pixel, see way_screen_draw_box) and a spare row from
+ * which the blank pixel is taken. Both are at logical resolution.
+ */
 static void init_screen_pool(struct screen *scr)
 {
-	int fd;
-	static int shm_num = 0;
-	char shm_path[64];
-	size_t bufsz;
+	size_t boxsz = 0;
 	char *buf;
-	cairo_surface_t *cairo_surface;
 
 	scr->stride = cairo_format_stride_for_width(CAIRO_FORMAT_ARGB32, scr->w);
 
-	bufsz = scr->stride * scr->h + scr->w * 4;
-	sprintf(shm_path, "/warpd_%d", shm_num++);
+	if (!wl.viewporter)
+		boxsz = scr->stride * scr->h;
 
-	fd = shm_open(shm_path, O_CREAT|O_TRUNC|O_RDWR, 0600);
-	if (fd < 0) {
-		perror("shm_open");
-		exit(-1);
+	buf = create_pool(boxsz + scr->w * 4, &scr->wl_pool);
+
+	if (boxsz)
+		scr->cr = create_cairo(buf, scr->w, scr->h, scr->stride);
+
+	/* Zeroed by ftruncate. */
+	scr->blank = wl_shm_pool_create_buffer(scr->wl_pool, boxsz,
+					       1, 1, 4, WL_SHM_FORMAT_ARGB8888);
+}
+
+/* In 120ths, as per wp_fractional_scale_v1. */
+static int screen_scale(struct screen *scr)
+{
+	int scale = scr->fractional_scale ? (int)scr->fractional_scale :
+					    scr->output_scale * 120;
+
+	/* Fractionally scaled buffers can only be shown through a viewport. */
+	if (!wl.viewporter && scale % 120)
+		scale = scale / 120 * 120;
+
+	return scale < 120 ? 120 : scale;
+}
+
+/*
+ * (Re)allocate the frames of fb at the current device resolution of the
+ * screen, they are shown through a viewport (or the buffer scale) at its
+ * logical size. Called before drawing, since the scale may only become
+ * known (or change) once surfaces are shown.
+ */
+void framebuffer_update(struct screen *scr, struct framebuffer *fb)
+{
+	const int scale = screen_scale(scr);
+	size_t framesz;
+	char *buf;
+	int w, h;
+	size_t stride;
+	size_t i;
+
+	if (fb->pool && scale == fb->scale)
+		return;
+
+	if (fb->pool) {
+		for (i = 0; i < 2; i++) {
+			wl_buffer_destroy(fb->frames[i].wl_buffer);
+			destroy_cairo(fb->frames[i].cr);
+		}
+
+		munmap(fb->data, fb->sz);
+		wl_shm_pool_destroy(fb->pool);
 	}
 
-	ftruncate(fd, bufsz);
+	w = (scr->w * scale + 60) / 120;
+	h = (scr->h * scale + 60) / 120;
+	stride = cairo_format_stride_for_width(CAIRO_FORMAT_ARGB32, w);
+	framesz = stride * h;
+
+	fb->scale = scale;
+	fb->sz = framesz * 2;
+	fb->data = buf = create_pool(fb->sz, &fb->pool);
+	fb->front = NULL;
+
+	for (i = 0; i < 2; i++) {
+		struct frame *f = &fb->frames[i];
+		size_t offset = framesz * i;
+
+		f->wl_buffer = wl_shm_pool_create_buffer(fb->pool, offset, w, h,
+							 stride,
+							 WL_SHM_FORMAT_ARGB8888);
+		wl_buffer_add_listener(f->wl_buffer, &frame_listener, f);
+
+		f->w = w;
+		f->h = h;
+		f->stride = stride;
+		f->data = (uint32_t *)(buf + offset);
+		f->cr = create_cairo(buf + offset, w, h, stride);
+
+		f->busy = 0;
+		f->valid = 0;
+		f->extent = (struct screen_rect){0};
+	}
+}
 
-	scr->wl_pool = wl_shm_create_pool(wl.shm, fd, bufsz);
-	buf = mmap(NULL, bufsz, PROT_READ|PROT_WRITE, MAP_SHARED, fd, 0);
-	close(fd);
+/*
+ * Wait for a frame the compositor has released. The front frame is
+ * preferred, since it is the closest to what is about to be drawn.
+ */
+struct frame *framebuffer_get_frame(struct framebuffer *fb)
+{
+	int attempt;
+	size_t i;
+
+	for (attempt = 0; attempt < 2; attempt++) {
+		if (fb->front && !fb->front->busy)
+			return fb->front;
 
-	cairo_surface = cairo_image_surface_create_for_data(buf,
-							    CAIRO_FORMAT_ARGB32, scr->w,
-							    scr->h, scr->stride);
-	scr->cr = cairo_create(cairo_surface);
+		for (i = 0; i < 2; i++)
+			if (!fb->frames[i].busy)
+				return &fb->frames[i];
+
+		wl_display_roundtrip(wl.dpy);
+	}
+
+	/* shm buffers are released once uploaded, so this shouldn't happen. */
+	return &fb->frames[fb->front == &fb->frames[0]];
+}
+
+/* Logical to device pixels. */
+int framebuffer_scale(struct framebuffer *fb, int v)
+{
+	return (v * fb->scale + 60) / 120;
 }
 
 void init_screen()
@@ -185,7 +474,6 @@ void init_screen()
 	size_t i;
 
 	for (i = 0; i < nr_screens; i++) {
-		struct surface *sfc;
 		struct screen *scr = &screens[i];
 
 		scr->xdg_output =
@@ -196,9 +484,16 @@ void init_screen()
 					    &zxdg_output_v1_listener, scr);
 
 		scr->state = 0;
-		do {
+	}
+
+	/* The geometry of every output is sent in response. */
+	wl_display_roundtrip(wl.dpy);
+
+	for (i = 0; i < nr_screens; i++) {
+		struct screen *scr = &screens[i];
+
+		while (scr->state < 2)
 			wl_display_dispatch(wl.dpy);
-		} while (scr->state != 2);
 
 		scr->ptrx = -1;
 		scr->ptry = -1;
@@ -206,5 +501,7 @@ void init_screen()
 		init_screen_pool(scr);
 	}
 
-	discover_pointer_location();
+	/* The position is only discovered if it is needed before it is seen. */
+	wl_pointer_add_listener(wl_seat_get_pointer(wl.seat),
+				&wl_pointer_listener, NULL);
 }
@@ -7,24 +7,118 @@
 
 static void noop() {}
 
-/* TODO: add support for fractional scaling (requires xdg-output?). */
-
 /* A 'surface' in the local context can be thought of as a viewport into a
  * rectangular region of the screen's backing buffer (the wl_shm_pool).  It is
  * undergirded by a corresponding wayland surface and wayland layer surface with a
  * wayland buffer object created from the relevant part of the screen's memory
- * pool. Surfaces are visible as long as they exist, and hiding them is achieved
- * by destroying them.
+ * pool. Surfaces persist for the lifetime of the program and are repositioned
+ * (surface_update) and hidden (surface_hide) in place, since creating one
+ * involves a configure round trip before anything is shown.
  */
 struct surface {
 	struct zwlr_layer_surface_v1 *wl_layer_surface;
 	struct wl_surface *wl_surface;
 	struct wl_buffer *wl_buffer;
+	struct screen *scr;
+
+	/* The region of the pool viewed by wl_buffer. */
+	int x;
+	int y;
+	int w;
+	int h;
+
+	/*
+	 * Displayed while visible, either wl_buffer or one supplied to
+	 * surface_present() or surface_fill() (in which case wl_buffer is
+	 * NULL).
+	 */
+	struct wl_buffer *front;
+
+	/*
+	 * Scales the single pixel of solid surfaces to w x h, or the device
+	 * resolution buffers of screen surfaces to the logical size.
+	 */
+	struct wp_viewport *viewport;
+	struct wp_fractional_scale_v1 *fractional_scale;
 
 	int configured;
-	int destroyed;
+	int visible;
+
+	/*
+	 * Set for surfaces which should receive pointer events while
+	 * visible, the rest are only displayed and let clicks through.
+	 */
+	int input;
+
+	/* Free list link. */
+	struct surface *next;
 };
 
+/* Surfaces are carved out of chunks which live for the rest of the session. */
+#define ARENA_CHUNK 64
+
+static struct surface *arena;
+static size_t arena_used = ARENA_CHUNK;
+static struct surface *free_surfaces;
+
+static struct surface *alloc_surface()
+{
+	struct surface *sfc;
+
+	if (free_surfaces) {
+		sfc = free_surfaces;
+		free_surfaces = sfc->next;
+	} else {
+		if (arena_used == ARENA_CHUNK) {
+			arena = malloc(ARENA_CHUNK * sizeof *arena);
+			assert(arena);
+			arena_used = 0;
+		}
+
+		sfc = &arena[arena_used++];
+	}
+
+	memset(sfc, 0, sizeof *sfc);
+	return sfc;
+}
+
+/* Damage is in buffer coordinates, the whole buffer is damaged if NULL. */
+static void attach(struct surface *sfc, const struct screen_rect *damage,
+		   size_t n)
+{
+	static struct wl_region *empty;
+	size_t i;
+
+	if (!empty)
+		empty = wl_compositor_create_region(wl.compositor);
+
+	/*
+	 * Hidden surfaces display a single transparent pixel rather than
+	 * being unmapped, which would require waiting for a fresh configure
+	 * to show them again. They must not swallow input either, nor must
+	 * visible ones unless they ask for it (e.g clicks sent while a ripple
+	 * or hints are shown should reach the application below).
+	 */
+	if (sfc->visible) {
+		wl_surface_attach(sfc->wl_surface, sfc->front, 0, 0);
+		wl_surface_set_input_region(sfc->wl_surface,
+					    sfc->input ? NULL : empty);
+
+		if (!damage)
+			wl_surface_damage_buffer(sfc->wl_surface, 0, 0, sfc->w,
+						 sfc->h);
+
+		for (i = 0; damage && i < n; i++)
+			wl_surface_damage_buffer(sfc->wl_surface, damage[i].x,
+						 damage[i].y, damage[i].w,
+						 damage[i].h);
+	} else {
+		wl_surface_attach(sfc->wl_surface, sfc->scr->blank, 0, 0);
+		wl_surface_damage_buffer(sfc->wl_surface, 0, 0, 1, 1);
+		wl_surface_set_input_region(sfc->wl_surface, empty);
+	}
+}
+
 static void layer_surface_handle_configure(void *data, struct zwlr_layer_surface_v1
 					   *layer_surface, uint32_t serial,
 					   uint32_t width, uint32_t height)
@@ -39,7 +133,7 @@ static void layer_surface_handle_configure(void *data, struct zwlr_layer_surface
 	// attaching the buffer to the underlying wl_surface object for the
 	// first time.
 
-	wl_surface_attach(sfc->wl_surface, sfc->wl_buffer, 0, 0);
+	attach(sfc, NULL, 0);
 	wl_surface_commit(sfc->wl_surface);
 
 	sfc->configured = 1;
@@ -54,39 +148,73 @@ void destroy_surface(struct surface *sfc)
 {
 	if (sfc) {
 		zwlr_layer_surface_v1_destroy(sfc->wl_layer_surface);
+		if (sfc->viewport)
+			wp_viewport_destroy(sfc->viewport);
+		if (sfc->fractional_scale)
+			wp_fractional_scale_v1_destroy(sfc->fractional_scale);
 		wl_surface_destroy(sfc->wl_surface);
-		wl_buffer_destroy(sfc->wl_buffer);
+		if (sfc->wl_buffer)
+			wl_buffer_destroy(sfc->wl_buffer);
 
-		free(sfc);
+		sfc->next = free_surfaces;
+		free_surfaces = sfc;
 	}
 }
 
-/* All surfaces which exist are visible. Surface creation/destruction is the means
- * of displaying content on the screen (there is no show/hide) and should be considered a cheap operation
- * which operates on a persistent shared buffer (memory pool). */
-
-struct surface *create_surface(struct screen *scr, int x, int y, int w, int h, int capture_input)
+static void clamp(struct screen *scr, int *x, int *y, int *w, int *h)
 {
-	struct surface *sfc = calloc(1, sizeof (struct surface));
-
-	if (x < 0) {
-		x = 0;
-		w += x;
+	if (*x < 0) {
+		*x = 0;
+		*w += *x;
 	}
-	if (y < 0) {
-		y = 0;
-		h += y;
+	if (*y < 0) {
+		*y = 0;
+		*h += *y;
 	}
-	if ((x+w) > scr->w)
-		x = scr->w-w;
-	if ((y+h) > scr->h)
-		y = scr->h-h;
+	if ((*x + *w) > scr->w)
+		*x = scr->w - *w;
+	if ((*y + *h) > scr->h)
+		*y = scr->h - *h;
+}
+
+/* Point the surface at the given region of the screen's pool. */
+static void set_region(struct surface *sfc, int x, int y, int w, int h)
+{
+	struct screen *scr = sfc->scr;
+
+	clamp(scr, &x, &y, &w, &h);
+
+	if (sfc->wl_buffer && x == sfc->x && y == sfc->y && w == sfc->w &&
+	    h == sfc->h)
+		return;
+
+	if (!sfc->wl_buffer || x != sfc->x || y != sfc->y)
+		zwlr_layer_surface_v1_set_margin(sfc->wl_layer_surface, y, 0, 0, x);
+
+	if (sfc->wl_buffer)
+		wl_buffer_destroy(sfc->wl_buffer);
 
 	sfc->wl_buffer = wl_shm_pool_create_buffer(scr->wl_pool, y*scr->stride + x*4, w, h, scr->stride, WL_SHM_FORMAT_ARGB8888);
 	assert(sfc->wl_buffer);
+
+	sfc->front = sfc->wl_buffer;
+	sfc->x = x;
+	sfc->y = y;
+	sfc->w = w;
+	sfc->h = h;
+}
+
+static struct surface *new_surface(struct screen *scr, int capture_input)
+{
+	struct surface *sfc = alloc_surface();
+
+	sfc->scr = scr;
 	sfc->wl_surface = wl_compositor_create_surface(wl.compositor);
 
 	assert(sfc->wl_surface);
+	/* See surface_lookup. */
+	wl_surface_set_user_data(sfc->wl_surface, sfc);
+
 	sfc->wl_layer_surface =
 		zwlr_layer_shell_v1_get_layer_surface(wl.layer_shell, sfc->wl_surface,
 						      scr->wl_output,
@@ -97,24 +225,227 @@ struct surface *create_surface(struct screen *scr, int x, int y, int w, int h, i
 
 	zwlr_layer_surface_v1_set_size(sfc->wl_layer_surface, 10, 10);
 	zwlr_layer_surface_v1_set_anchor(sfc->wl_layer_surface, ZWLR_LAYER_SURFACE_V1_ANCHOR_TOP|ZWLR_LAYER_SURFACE_V1_ANCHOR_LEFT);
-	zwlr_layer_surface_v1_set_margin(sfc->wl_layer_surface, y, 0, 0, x);
 	zwlr_layer_surface_v1_set_exclusive_zone(sfc->wl_layer_surface, -1);
 
 	zwlr_layer_surface_v1_add_listener(sfc->wl_layer_surface, &layer_surface_listener, sfc);
 
 	sfc->configured = 0;
 
+	sfc->input = capture_input;
 	if (capture_input) {
 		zwlr_layer_surface_v1_set_keyboard_interactivity(sfc->wl_layer_surface,
 								  ZWLR_LAYER_SURFACE_V1_KEYBOARD_INTERACTIVITY_EXCLUSIVE);
 	}
 
+	return sfc;
+}
+
+struct surface *create_surface(struct screen *scr, int x, int y, int w, int h, int capture_input)
+{
+	struct surface *sfc = new_surface(scr, capture_input);
+
+	set_region(sfc, x, y, w, h);
+	sfc->visible = 1;
+
 	wl_surface_commit(sfc->wl_surface);
 
 	return sfc;
 }
 
+/*
+ * A (hidden) surface covering the screen which displays screen sized
+ * buffers supplied by the caller (see surface_present).
+ */
+struct surface *create_screen_surface(struct screen *scr)
+{
+	struct surface *sfc = new_surface(scr, 0);
+
+	sfc->visible = 0;
+	surface_track_scale(sfc);
+
+	wl_surface_commit(sfc->wl_surface);
+
+	return sfc;
+}
+
+/*
+ * Display buf (w x h device pixels covering the screen), which differs from
+ * the previously presented buffer only within the damaged rectangles (all
+ * of it if damage is NULL). The caller owns buf and should track its
+ * release.
+ */
+void surface_present(struct surface *sfc, struct wl_buffer *buf, int w, int h,
+		     const struct screen_rect *damage, size_t n)
+{
+	struct screen *scr = sfc->scr;
+
+	/* The previous contents are no longer on screen. */
+	if (!sfc->visible)
+		damage = NULL;
+
+	if (w != sfc->w || h != sfc->h) {
+		if (wl.viewporter) {
+			if (!sfc->viewport)
+				sfc->viewport = wp_viewporter_get_viewport(
+				    wl.viewporter, sfc->wl_surface);
+
+			wp_viewport_set_destination(sfc->viewport, scr->w,
+						    scr->h);
+		} else {
+			/* Integral, see screen_scale(). */
+			wl_surface_set_buffer_scale(sfc->wl_surface, w / scr->w);
+		}
+
+		sfc->w = w;
+		sfc->h = h;
+		damage = NULL;
+	}
+
+	sfc->front = buf;
+	sfc->visible = 1;
+
+	if (sfc->configured)
+		attach(sfc, damage, n);
+
+	wl_surface_commit(sfc->wl_surface);
+}
+
+/*
+ * Show the given region of the pool (which the caller has drawn) through an
+ * existing surface. The buffer is only recreated if the region changes.
+ */
+void surface_update(struct surface *sfc, int x, int y, int w, int h)
+{
+	set_region(sfc, x, y, w, h);
+	sfc->visible = 1;
+
+	/* Otherwise attached once configured. */
+	if (sfc->configured)
+		attach(sfc, NULL, 0);
+
+	wl_surface_commit(sfc->wl_surface);
+}
+
+/*
+ * Show a solid box by scaling color (a single pixel buffer) to w x h. Moving
+ * the box is a matter of changing the margin, nothing is redrawn.
+ */
+void surface_fill(struct surface *sfc, int x, int y, int w, int h,
+		  struct wl_buffer *color)
+{
+	/* Zero sized destinations are a protocol error. */
+	if (w <= 0 || h <= 0) {
+		surface_hide(sfc);
+		return;
+	}
+
+	clamp(sfc->scr, &x, &y, &w, &h);
+
+	if (!sfc->viewport)
+		sfc->viewport = wp_viewporter_get_viewport(wl.viewporter,
+							   sfc->wl_surface);
+
+	if (x != sfc->x || y != sfc->y)
+		zwlr_layer_surface_v1_set_margin(sfc->wl_layer_surface, y, 0, 0, x);
+
+	if (w != sfc->w || h != sfc->h)
+		wp_viewport_set_destination(sfc->viewport, w, h);
+
+	sfc->x = x;
+	sfc->y = y;
+	sfc->w = w;
+	sfc->h = h;
+
+	/* Unchanged, committing the new position suffices. */
+	if (sfc->visible && sfc->front == color) {
+		wl_surface_commit(sfc->wl_surface);
+		return;
+	}
+
+	sfc->front = color;
+	sfc->visible = 1;
+
+	if (sfc->configured)
+		attach(sfc, NULL, 0);
+
+	wl_surface_commit(sfc->wl_surface);
+}
+
+struct surface *create_solid_surface(struct screen *scr, int x, int y, int w,
+				     int h, struct wl_buffer *color)
+{
+	struct surface *sfc = new_surface(scr, 0);
+
+	/* Forces the initial margin and destination to be set. */
+	sfc->x = -1;
+	sfc->y = -1;
+
+	surface_fill(sfc, x, y, w, h, color);
+
+	return sfc;
+}
+
+void surface_hide(struct surface *sfc)
+{
+	if (!sfc->visible)
+		return;
+
+	sfc->visible = 0;
+
+	if (sfc->configured) {
+		attach(sfc, NULL, 0);
+		wl_surface_commit(sfc->wl_surface);
+	}
+}
+
+static void fractional_scale_handle_preferred_scale(
+    void *data, struct wp_fractional_scale_v1 *fractional_scale, uint32_t scale)
+{
+	struct surface *sfc = data;
+
+	sfc->scr->fractional_scale = scale;
+}
+
+static const struct wp_fractional_scale_v1_listener fractional_scale_listener = {
+	.preferred_scale = fractional_scale_handle_preferred_scale,
+};
+
+/* Record the scale the compositor prefers for the surface's screen. */
+void surface_track_scale(struct surface *sfc)
+{
+	if (!wl.fractional_scale_manager || sfc->fractional_scale)
+		return;
+
+	sfc->fractional_scale = wp_fractional_scale_manager_v1_get_fractional_scale(
+	    wl.fractional_scale_manager, sfc->wl_surface);
+	wp_fractional_scale_v1_add_listener(sfc->fractional_scale,
+					    &fractional_scale_listener, sfc);
+}
+
+/* Receive pointer events while visible (takes effect on the next attach). */
+void surface_accept_pointer(struct surface *sfc)
+{
+	sfc->input = 1;
+}
+
 struct wl_surface *surface_get_wl_surface(struct surface *sfc)
 {
 	return sfc->wl_surface;
 }
+
+/*
+ * The screen of one of our surfaces (e.g from a pointer event) along with
+ * its offset within the screen.
+ */
+struct screen *surface_lookup(struct wl_surface *wl_surface, int *x, int *y)
+{
+	struct surface *sfc;
+
+	if (!wl_surface || !(sfc = wl_surface_get_user_data(wl_surface)))
+		return NULL;
+
+	*x = sfc->x;
+	*y = sfc->y;
+
+	return sfc->scr;
+}
@@ -231,8 +231,15 @@ void way_mouse_click(int btn)
 
 void way_mouse_get_position(struct screen **scr, int *x, int *y)
 {
+	/* Pick up any pointer events which have already arrived. */
+	wl_display_dispatch_pending(wl.dpy);
+
+	/* Only go looking for the pointer if it hasn't been seen yet. */
+	if (!ptr.scr && (x || y || nr_screens > 1))
+		discover_pointer_location();
+
 	if (scr)
-		*scr = ptr.scr;
+		*scr = ptr.scr ? ptr.scr : &screens[0];
 	if (x)
 		*x = ptr.x;
 	if (y)
@@ -314,7 +321,13 @@ void wayland_init(struct platform *platform)
 	platform->commit = way_commit;
 	platform->copy_selection = way_copy_selection;
 	platform->hint_draw = way_hint_draw;
+	/* AT-SPI extents are not in global coordinates under wayland. */
 	platform->collect_interactable_hints = NULL;
+	platform->target_state = NULL;
+	/* TODO: wlr-screencopy */
+	platform->screen_capture = NULL;
+	platform->screen_poll_damage = NULL;
+	platform->screen_draw_image = NULL;
 	platform->init_hint = way_init_hint;
 	platform->input_grab_keyboard = way_input_grab_keyboard;
 	platform->input_lookup_code = way_input_lookup_code;
@@ -336,11 +349,17 @@ void wayland_init(struct platform *platform)
 	platform->screen_clear_ripples = NULL;
 	platform->screen_draw_box = way_screen_draw_box;
 	platform->screen_draw_cursor = NULL;
+	platform->cursor_set_box = NULL;
+	platform->box_create = NULL;
 	platform->screen_get_dimensions = way_screen_get_dimensions;
+	/* No portable way to query the focused toplevel, see hint_window_region. */
+	platform->screen_get_focused_window = NULL;
 	platform->screen_list = way_screen_list;
 	platform->scroll = way_scroll;
 	platform->scroll_amount = way_scroll_amount;
-	platform->trigger_ripple = NULL; // TODO: Implement ripple for Wayland
-	platform->has_active_ripples =
-	    NULL; // TODO: Implement ripple for Wayland
+	platform->screen_draw_rings = way_screen_draw_rings;
+	platform->screen_get_refresh_rate = way_screen_get_refresh_rate;
+	/* Provided by anim.c. */
+	platform->trigger_ripple = NULL;
+	platform->has_active_ripples = NULL;
 }
@@ -22,12 +22,16 @@
 #include <xkbcommon/xkbcommon.h>
 
 #include "../../../platform.h"
+#include "wl/fractional-scale.h"
 #include "wl/layer-shell.h"
+#include "wl/single-pixel-buffer.h"
+#include "wl/viewporter.h"
 #include "wl/virtual-pointer.h"
 #include "wl/xdg-output.h"
 #include "wl/xdg-shell.h"
 
 #define MAX_BOXES 64
+#define MAX_COLORS 64
 
 struct wl {
 	struct wl_display *dpy;
@@ -38,6 +42,50 @@ struct wl {
 	struct zwlr_virtual_pointer_v1 *ptr;
 	struct zwlr_layer_shell_v1 *layer_shell;
 	struct zxdg_output_manager_v1 *xdg_output_manager;
+
+	/* Optional. */
+	struct wp_viewporter *viewporter;
+	struct wp_single_pixel_buffer_manager_v1 *single_pixel_buffer_manager;
+	struct wp_fractional_scale_manager_v1 *fractional_scale_manager;
+};
+
+/* A screen sized buffer which hints or effects are drawn into. */
+struct frame {
+	struct wl_buffer *wl_buffer;
+	uint32_t *data;
+	cairo_t *cr;
+
+	/* In device pixels. */
+	int w;
+	int h;
+	size_t stride;
+
+	/* Set while the compositor may still read the buffer. */
+	int busy;
+
+	/* The hints the buffer contains (if valid). */
+	struct hint *hints;
+	size_t nr_hints;
+	size_t hints_sz;
+	int valid;
+	int rasterized;
+
+	/* Bounds the rings the buffer contains (see effects.c). */
+	struct screen_rect extent;
+};
+
+/* A pair of frames which are presented alternately. */
+struct framebuffer {
+	struct frame frames[2];
+	/* The one last presented. */
+	struct frame *front;
+
+	struct wl_shm_pool *pool;
+	void *data;
+	size_t sz;
+
+	/* The scale the frames are rendered at, in 120ths. */
+	int scale;
 };
 
 struct screen {
@@ -51,17 +99,32 @@ struct screen {
 
 	int state;
 
+	/* Surfaces are reused across redraws, the first nr_boxes are in use. */
 	size_t nr_boxes;
+	size_t nr_pooled_boxes;
 	struct surface *boxes[MAX_BOXES];
 
 	struct surface *overlay;
 	struct surface *hints;
+	struct surface *effects;
 
 	struct wl_output *wl_output;
 	struct zxdg_output_v1 *xdg_output;
 
 	struct wl_shm_pool *wl_pool;
+	/* A transparent pixel displayed by hidden surfaces. */
+	struct wl_buffer *blank;
+
+	struct framebuffer hint_fb;
+	struct framebuffer effect_fb;
+
+	/* In 120ths (0 if unknown). */
+	uint32_t fractional_scale;
+	int output_scale;
+	/* In mHz (0 if unknown). */
+	int refresh_rate;
 	size_t stride;
+	/* Boxes are drawn here if they can't be scaled from a single pixel. */
 	cairo_t *cr;
 };
 
@@ -80,6 +143,10 @@ int way_hex_to_rgba(const char *str, uint8_t *r, uint8_t *g, uint8_t *b,
 		    uint8_t *a);
 
 void init_screen();
+void discover_pointer_location();
+void framebuffer_update(struct screen *scr, struct framebuffer *fb);
+struct frame *framebuffer_get_frame(struct framebuffer *fb);
+int framebuffer_scale(struct framebuffer *fb, int v);
 
 struct ptr {
 	int x;
@@ -98,7 +165,18 @@ struct surface *create_surface(struct screen *scr, int x, int y, int w, int h,
 			       int capture_input);
 void destroy_surface(struct surface *sfc);
 struct wl_surface *surface_get_wl_surface(struct surface *sfc);
-void surface_show(struct surface *sfc);
+struct surface *create_screen_surface(struct screen *scr);
+struct surface *create_solid_surface(struct screen *scr, int x, int y, int w,
+				     int h, struct wl_buffer *color);
+void surface_fill(struct surface *sfc, int x, int y, int w, int h,
+		  struct wl_buffer *color);
+void surface_update(struct surface *sfc, int x, int y, int w, int h);
+void surface_present(struct surface *sfc, struct wl_buffer *buf, int w, int h,
+		     const struct screen_rect *damage, size_t n);
+void surface_track_scale(struct surface *sfc);
+void surface_hide(struct surface *sfc);
+void surface_accept_pointer(struct surface *sfc);
+struct screen *surface_lookup(struct wl_surface *wl_surface, int *x, int *y);
 
 /* Exported platform functions. */
 void way_run(void (*init)(void));
@@ -122,6 +200,9 @@ void way_screen_get_dimensions(screen_t scr, int *w, int *h);
 void way_screen_draw_box(screen_t scr, int x, int y, int w, int h,
 			 const char *color);
 void way_screen_clear(screen_t scr);
+void way_screen_draw_rings(screen_t scr, const struct ring *rings, size_t n,
+			   const struct screen_rect *damage, size_t nr_damage);
+int way_screen_get_refresh_rate(screen_t scr);
 void way_screen_list(screen_t scr[MAX_SCREENS], size_t *n);
 void way_init_hint(const char *bg, const char *fg, int border_radius,
 		   const char *border_color, int border_width,
@@ -39,6 +39,18 @@ static void handle_global(void *data,
 		wl.xdg_output_manager = wl_registry_bind(registry, name, &zxdg_output_manager_v1_interface, 3);
 	}
 
+	if (!strcmp(interface, "wp_viewporter"))
+		wl.viewporter = wl_registry_bind(registry,
+						 name, &wp_viewporter_interface, 1);
+
+	if (!strcmp(interface, "wp_single_pixel_buffer_manager_v1"))
+		wl.single_pixel_buffer_manager = wl_registry_bind(registry,
+								  name, &wp_single_pixel_buffer_manager_v1_interface, 1);
+
+	if (!strcmp(interface, "wp_fractional_scale_manager_v1"))
+		wl.fractional_scale_manager = wl_registry_bind(registry,
+							       name, &wp_fractional_scale_manager_v1_interface, 1);
+
 	if (!strcmp(interface, "zwlr_layer_shell_v1"))
 		wl.layer_shell = wl_registry_bind(registry,
 						  name, &zwlr_layer_shell_v1_interface, 2);
@@ -59,7 +71,7 @@ void way_init()
 
 	wl_registry_add_listener(wl_display_get_registry(wl.dpy), &registry_listener, NULL);
 
-	wl_display_dispatch(wl.dpy);
+	wl_display_roundtrip(wl.dpy);
 
 	if (!wl.ptr) {
 		fprintf(stderr, "Could not create virtual pointer (virtual pointer unsupported?)\n");
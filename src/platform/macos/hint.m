@@ -30,6 +30,17 @@ static void draw_hook(void *arg, NSView *view)
 
 void osx_hint_draw(struct screen *scr, struct hint *hints, size_t n)
 {
+	if (n > scr->hints_sz) {
+		struct hint *h = realloc(scr->hints, sizeof(struct hint)*n);
+
+		if (h) {
+			scr->hints = h;
+			scr->hints_sz = n;
+		} else {
+			n = 0;
+		}
+	}
+
 	scr->nr_hints = n;
 	memcpy(scr->hints, hints, sizeof(struct hint)*n);
 
@@ -93,8 +93,10 @@ struct screen {
 	int w;
 	int h;
 
-	struct hint hints[MAX_HINTS];
+	/* Grown to fit the largest hint set drawn. */
+	struct hint *hints;
 	size_t nr_hints;
+	size_t hints_sz;
 
 	struct box boxes[MAX_BOXES];
 	size_t nr_boxes;
@@ -621,8 +621,11 @@ void platform_run(int (*main)(struct platform *platform))
 	platform.init_hint = init_hint;
 	platform.hint_draw = hint_draw;
 	platform.collect_interactable_hints = NULL;
+	platform.target_state = NULL;
 	platform.screen_draw_box = screen_draw_box;
 	platform.screen_draw_cursor = NULL;
+	platform.cursor_set_box = NULL;
+	platform.box_create = NULL;
 	platform.input_next_event = input_next_event;
 	platform.input_wait = input_wait;
 	platform.screen_clear = screen_clear;
@@ -19,11 +19,13 @@ struct screen {
 	int w;
 	int h;
 
-	struct hint hints[4096];
+	/* Grown to fit the largest hint set drawn. */
+	struct hint *hints;
 	struct box boxes[128];
 
 	size_t nboxes;
 	size_t nhints;
+	size_t hints_sz;
 
 	HANDLE mtx;
 	HWND overlay;
@@ -227,7 +229,17 @@ void wn_screen_set_hints(struct screen *scr, struct hint *hints, size_t nhints)
 {
 	AcquireMutex(mtx);
 
-	assert(nhints < sizeof scr->hints / sizeof scr->hints[0]);
+	if (nhints > scr->hints_sz) {
+		struct hint *h = realloc(scr->hints, sizeof(struct hint) * nhints);
+
+		if (h) {
+			scr->hints = h;
+			scr->hints_sz = nhints;
+		} else {
+			nhints = 0;
+		}
+	}
+
 	memcpy(scr->hints, hints, sizeof(struct hint) * nhints);
 	scr->nhints = nhints;
 
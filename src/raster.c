@@ -0,0 +1,520 @@
+/*
+ * warpd - A modal keyboard-driven pointing system.
+ *
+ * © 2019 Raheman Vaiya (see: LICENSE).
+ */
+
+/*
+ * A software rasterizer for hint overlays. The platform rasterizes the
+ * printable glyphs of the hint font into an atlas once per font and hint
+ * size (see atlas_get), boxes, borders and labels are then
+ * composited directly into a client side buffer of premultiplied ARGB
+ * pixels which the platform presents (e.g via shared memory). The buffer
+ * is drawn in bands of rows in parallel. The rings of animated effects
+ * (see anim.c) are drawn the same way.
+ */
+
+#include "warpd.h"
+
+#include <math.h>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#define NR_ATLASES 8
+
+#define FIRST_GLYPH 32
+#define NR_GLYPHS   95
+
+struct raster_glyph {
+	/* Offset of the coverage bitmap within the atlas data. */
+	size_t offset;
+
+	int w;
+	int h;
+
+	/* Position of the bitmap relative to the pen (top is above it). */
+	int left;
+	int top;
+	int advance;
+
+	int present;
+};
+
+struct raster_atlas {
+	char font[128];
+	raster_font_fn render;
+	int cell_w;
+	int cell_h;
+
+	int ascent;
+	int descent;
+
+	struct raster_glyph glyphs[NR_GLYPHS];
+
+	uint8_t *data;
+	size_t len;
+	size_t sz;
+
+	/* The draw which last used the atlas (see raster_draw_hints). */
+	uint64_t gen;
+};
+
+static struct raster_atlas *atlases[NR_ATLASES];
+static size_t next_atlas;
+static uint64_t gen;
+
+uint32_t raster_color(uint8_t r, uint8_t g, uint8_t b, uint8_t a)
+{
+	return (uint32_t)a << 24 | (uint32_t)(r * a / 255) << 16 |
+	       (uint32_t)(g * a / 255) << 8 | (uint32_t)(b * a / 255);
+}
+
+void raster_atlas_set_metrics(struct raster_atlas *atlas, int ascent,
+			      int descent)
+{
+	atlas->ascent = ascent;
+	atlas->descent = descent;
+}
+
+/*
+ * Add the coverage bitmap of a glyph (one byte per pixel) to the atlas.
+ * Called by the platform from within its raster_font_fn.
+ */
+int raster_atlas_add_glyph(struct raster_atlas *atlas, char c,
+			   const uint8_t *alpha, int w, int h, int stride,
+			   int left, int top, int advance)
+{
+	struct raster_glyph *g;
+	const size_t n = (size_t)MAX(0, w) * MAX(0, h);
+	int y;
+
+	if (c < FIRST_GLYPH || c >= FIRST_GLYPH + NR_GLYPHS)
+		return -1;
+
+	if (atlas->len + n > atlas->sz) {
+		size_t sz = MAX(atlas->sz * 2, atlas->len + n);
+		uint8_t *data = realloc(atlas->data, sz);
+
+		if (!data)
+			return -1;
+
+		atlas->data = data;
+		atlas->sz = sz;
+	}
+
+	g = &atlas->glyphs[c - FIRST_GLYPH];
+
+	g->offset = atlas->len;
+	g->w = MAX(0, w);
+	g->h = MAX(0, h);
+	g->left = left;
+	g->top = top;
+	g->advance = advance;
+	g->present = 1;
+
+	for (y = 0; y < g->h; y++)
+		memcpy(atlas->data + atlas->len + (size_t)y * g->w,
+		       alpha + (size_t)y * stride, g->w);
+
+	atlas->len += n;
+	return 0;
+}
+
+static void free_atlas(struct raster_atlas *atlas)
+{
+	if (atlas) {
+		free(atlas->data);
+		free(atlas);
+	}
+}
+
+/*
+ * Obtain the atlas for the given font and hint size, rendering it with
+ * render() if it is not cached. Atlases used by the current draw are
+ * never evicted, NULL is returned if there is no room.
+ */
+static struct raster_atlas *atlas_get(const char *font, int w, int h,
+				      raster_font_fn render)
+{
+	struct raster_atlas *atlas;
+	size_t i;
+
+	for (i = 0; i < NR_ATLASES; i++) {
+		atlas = atlases[i];
+
+		if (atlas && atlas->render == render && atlas->cell_w == w &&
+		    atlas->cell_h == h && !strcmp(atlas->font, font)) {
+			atlas->gen = gen;
+			return atlas;
+		}
+	}
+
+	for (i = 0; i < NR_ATLASES; i++) {
+		size_t slot = (next_atlas + i) % NR_ATLASES;
+
+		if (!atlases[slot] || atlases[slot]->gen != gen)
+			break;
+	}
+
+	if (i == NR_ATLASES || !(atlas = calloc(1, sizeof *atlas)))
+		return NULL;
+
+	snprintf(atlas->font, sizeof atlas->font, "%s", font);
+	atlas->render = render;
+	atlas->cell_w = w;
+	atlas->cell_h = h;
+	atlas->gen = gen;
+
+	if (render(atlas, font, w, h)) {
+		free_atlas(atlas);
+		return NULL;
+	}
+
+	i = (next_atlas + i) % NR_ATLASES;
+	free_atlas(atlases[i]);
+	atlases[i] = atlas;
+	next_atlas = (i + 1) % NR_ATLASES;
+
+	return atlas;
+}
+
+/* Drop all cached atlases (e.g on config reload). */
+void raster_flush()
+{
+	size_t i;
+
+	for (i = 0; i < NR_ATLASES; i++) {
+		free_atlas(atlases[i]);
+		atlases[i] = NULL;
+	}
+}
+
+static void fill_span(uint32_t *dst, int n, uint32_t color)
+{
+	int i = 0;
+
+#ifdef __SSE2__
+	const __m128i c = _mm_set1_epi32(color);
+
+	for (; i + 4 <= n; i += 4)
+		_mm_storeu_si128((__m128i *)(dst + i), c);
+#endif
+	for (; i < n; i++)
+		dst[i] = color;
+}
+
+#ifdef __SSE2__
+/* (x + 127) / 255 for each 16 bit lane (x <= 255 * 255). */
+static __m128i div255(__m128i x)
+{
+	x = _mm_add_epi16(x, _mm_set1_epi16(128));
+	return _mm_srli_epi16(_mm_add_epi16(x, _mm_srli_epi16(x, 8)), 8);
+}
+
+/* Blend two 16 bit widened pixels (d) with src scaled by coverage (c). */
+static __m128i blend2(__m128i d, __m128i c, __m128i src)
+{
+	const __m128i s = div255(_mm_mullo_epi16(src, c));
+	const __m128i a = _mm_shufflehi_epi16(
+	    _mm_shufflelo_epi16(s, _MM_SHUFFLE(3, 3, 3, 3)),
+	    _MM_SHUFFLE(3, 3, 3, 3));
+
+	return _mm_add_epi16(
+	    s, div255(_mm_mullo_epi16(d, _mm_sub_epi16(_mm_set1_epi16(255),
+							a))));
+}
+#endif
+
+/* Composite the (premultiplied) color over dst with the given coverage. */
+static void blend_span(uint32_t *dst, const uint8_t *cov, int n, uint32_t fg)
+{
+	int i = 0;
+
+#ifdef __SSE2__
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i src = _mm_unpacklo_epi8(_mm_set1_epi32(fg), zero);
+
+	for (; i + 4 <= n; i += 4) {
+		uint32_t c4;
+		__m128i c, d, lo, hi;
+
+		memcpy(&c4, cov + i, sizeof c4);
+		if (!c4)
+			continue;
+
+		/* Replicate the coverage of each pixel across its channels. */
+		c = _mm_cvtsi32_si128(c4);
+		c = _mm_unpacklo_epi8(c, c);
+		c = _mm_unpacklo_epi16(c, c);
+
+		d = _mm_loadu_si128((const __m128i *)(dst + i));
+
+		lo = blend2(_mm_unpacklo_epi8(d, zero),
+			    _mm_unpacklo_epi8(c, zero), src);
+		hi = blend2(_mm_unpackhi_epi8(d, zero),
+			    _mm_unpackhi_epi8(c, zero), src);
+
+		_mm_storeu_si128((__m128i *)(dst + i),
+				 _mm_packus_epi16(lo, hi));
+	}
+#endif
+	for (; i < n; i++) {
+		uint32_t p = 0;
+		uint32_t sa;
+		int shift;
+
+		if (!cov[i])
+			continue;
+
+		sa = ((fg >> 24) * cov[i] + 127) / 255;
+
+		for (shift = 0; shift < 32; shift += 8) {
+			uint32_t s = ((fg >> shift & 0xff) * cov[i] + 127) / 255;
+			uint32_t d = dst[i] >> shift & 0xff;
+
+			p |= (s + (d * (255 - sa) + 127) / 255) << shift;
+		}
+
+		dst[i] = p;
+	}
+}
+
+struct raster_job {
+	uint32_t *buf;
+	int stride;
+	int w;
+	int h;
+	int clear;
+
+	struct hint *hints;
+	size_t n;
+	struct raster_atlas *atlas;
+	const struct raster_style *style;
+
+	/* The rows which need to be drawn. */
+	int y0;
+};
+
+/* The number of pixels row dy of a corner of radius r is inset by. */
+static int corner_inset(int r, int dy)
+{
+	const double d = r - dy - 0.5;
+
+	return r - (int)(sqrt(r * r - d * d) + 0.5);
+}
+
+static void draw_box(struct raster_job *job, struct hint *h, int y0, int y1)
+{
+	const struct raster_style *st = job->style;
+	const int r = MIN(st->border_radius, MIN(h->w, h->h) / 2);
+
+	/* Strokes are centered on the edge of the box (see X/hint.c). */
+	const int bw = st->border_width > 0 ? (st->border_width + 1) / 2 : 0;
+	int y;
+
+	for (y = MAX(y0, h->y); y < MIN(y1, h->y + h->h); y++) {
+		uint32_t *row = job->buf + (size_t)y * job->stride;
+		const int dy = y - h->y;
+		int inset = 0;
+		int x0, x1;
+
+		if (dy < r)
+			inset = corner_inset(r, dy);
+		else if (dy >= h->h - r)
+			inset = corner_inset(r, h->h - 1 - dy);
+
+		x0 = MAX(0, h->x + inset);
+		x1 = MIN(job->w, h->x + h->w - inset);
+
+		if (x1 <= x0)
+			continue;
+
+		if (dy < bw || dy >= h->h - bw) {
+			fill_span(row + x0, x1 - x0, st->border);
+			continue;
+		}
+
+		fill_span(row + x0, x1 - x0, st->bg);
+
+		if (bw) {
+			const int left = MIN(x1, h->x + bw);
+			const int right = MAX(x0, h->x + h->w - bw);
+
+			if (left > x0)
+				fill_span(row + x0, left - x0, st->border);
+			if (x1 > right)
+				fill_span(row + right, x1 - right, st->border);
+		}
+	}
+}
+
+static void draw_label(struct raster_job *job, struct hint *h, int y0, int y1)
+{
+	const struct raster_atlas *atlas = job->atlas;
+	const int baseline =
+	    h->y + (h->h - (atlas->ascent + atlas->descent)) / 2 + atlas->ascent;
+	const int cx0 = MAX(0, h->x);
+	const int cx1 = MIN(job->w, h->x + h->w);
+	const int cy0 = MAX(y0, h->y);
+	const int cy1 = MIN(y1, h->y + h->h);
+	const char *c;
+	int width = 0;
+	int pen;
+
+	for (c = h->label; *c; c++)
+		width += atlas->glyphs[*c - FIRST_GLYPH].advance;
+
+	pen = h->x + (h->w - width) / 2;
+
+	for (c = h->label; *c; c++) {
+		const struct raster_glyph *g = &atlas->glyphs[*c - FIRST_GLYPH];
+		const int gx = pen + g->left;
+		const int gy = baseline - g->top;
+		const int x0 = MAX(cx0, gx);
+		const int x1 = MIN(cx1, gx + g->w);
+		int y;
+
+		pen += g->advance;
+
+		if (x1 <= x0)
+			continue;
+
+		for (y = MAX(cy0, gy); y < MIN(cy1, gy + g->h); y++)
+			blend_span(job->buf + (size_t)y * job->stride + x0,
+				   atlas->data + g->offset +
+				       (size_t)(y - gy) * g->w + (x0 - gx),
+				   x1 - x0, job->style->fg);
+	}
+}
+
+static void draw_band(void *arg, int y0, int y1)
+{
+	struct raster_job *job = arg;
+	size_t i;
+	int y;
+
+	y0 += job->y0;
+	y1 += job->y0;
+
+	if (job->clear)
+		for (y = y0; y < y1; y++)
+			fill_span(job->buf + (size_t)y * job->stride, job->w,
+				  0);
+
+	for (i = 0; i < job->n; i++) {
+		struct hint *h = &job->hints[i];
+
+		if (h->y >= y1 || h->y + h->h <= y0)
+			continue;
+
+		draw_box(job, h, y0, y1);
+		draw_label(job, h, y0, y1);
+	}
+}
+
+/*
+ * Draw the hints into buf (w x h premultiplied ARGB pixels, stride in
+ * pixels). If clear is set the rest of the buffer is made transparent,
+ * otherwise only the rows spanned by the hints are touched. Returns -1
+ * (having drawn nothing) if the font lacks a glyph used by one of the
+ * labels or the hints are not of uniform size.
+ */
+int raster_draw_hints(uint32_t *buf, int stride, int w, int h, int clear,
+		      struct hint *hints, size_t n,
+		      const struct raster_style *style, const char *font,
+		      raster_font_fn render)
+{
+	struct raster_job job;
+	int y0 = h, y1 = 0;
+	size_t i;
+
+	gen++;
+
+	job.atlas = NULL;
+
+	for (i = 0; i < n; i++) {
+		const char *c;
+
+		if (hints[i].w != hints[0].w || hints[i].h != hints[0].h)
+			return -1;
+
+		if (!job.atlas && !(job.atlas = atlas_get(font, hints[0].w,
+							  hints[0].h, render)))
+			return -1;
+
+		for (c = hints[i].label; *c; c++)
+			if (*c < FIRST_GLYPH || *c >= FIRST_GLYPH + NR_GLYPHS ||
+			    !job.atlas->glyphs[*c - FIRST_GLYPH].present)
+				return -1;
+
+		y0 = MIN(y0, MAX(0, hints[i].y));
+		y1 = MAX(y1, MIN(h, hints[i].y + hints[i].h));
+	}
+
+	if (clear) {
+		y0 = 0;
+		y1 = h;
+	}
+
+	if (y1 <= y0)
+		return 0;
+
+	job.buf = buf;
+	job.stride = stride;
+	job.w = w;
+	job.h = h;
+	job.clear = clear;
+	job.hints = hints;
+	job.n = n;
+	job.style = style;
+	job.y0 = y0;
+
+	image_parallel_rows(y1 - y0, 64, draw_band, &job);
+
+	return 0;
+}
+
+/*
+ * Composite an antialiased ring over buf (w x h premultiplied ARGB pixels,
+ * stride in pixels), the top left of which is at (x, y) in the coordinate
+ * space of the ring.
+ */
+void raster_draw_ring(uint32_t *buf, int stride, int w, int h, int x, int y,
+		      const struct ring *ring)
+{
+	const float half = ring->line_width / 2.0;
+	const int reach = ring->radius + ring->line_width / 2 + 2;
+	const int cx = ring->x - x;
+	const int cy = ring->y - y;
+	int x0 = MAX(0, cx - reach);
+	int x1 = MIN(w, cx + reach);
+	int y0 = MAX(0, cy - reach);
+	int y1 = MIN(h, cy + reach);
+	uint8_t *cov;
+	int i, j;
+
+	if (x1 <= x0 || y1 <= y0 || !(ring->color >> 24))
+		return;
+
+	if (!(cov = malloc(x1 - x0)))
+		return;
+
+	for (j = y0; j < y1; j++) {
+		const float dy = j + 0.5 - cy;
+
+		for (i = x0; i < x1; i++) {
+			const float dx = i + 0.5 - cx;
+			const float d = sqrtf(dx * dx + dy * dy);
+			/* Coverage falls off over a pixel at either edge. */
+			float c = half + 0.5 - fabsf(d - ring->radius);
+
+			cov[i - x0] = c <= 0 ? 0 : c >= 1 ? 255 : c * 255;
+		}
+
+		blend_span(buf + j * stride + x0, cov, x1 - x0, ring->color);
+	}
+
+	free(cov);
+}
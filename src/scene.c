@@ -0,0 +1,192 @@
+/*
+ * warpd - A modal keyboard-driven pointing system.
+ *
+ * © 2019 Raheman Vaiya (see: LICENSE).
+ */
+
+/*
+ * A retained overlay scene. Modes keep persistent box handles and only
+ * modify the ones which change, scene_commit() then sends the difference
+ * to platforms which implement retained boxes (box_create). Other
+ * platforms are redrawn from scratch on each commit (the scene is drawn
+ * in creation order). A box may consist of several rectangles which share
+ * a color (e.g the lines of a grid), these are updated as a unit.
+ *
+ * scene_box_create() returns NULL if it fails, the remaining functions
+ * accept (and ignore) a NULL box.
+ */
+
+#include "warpd.h"
+
+struct scene_box {
+	void *pbox;
+
+	screen_t scr;
+	struct screen_rect *rects;
+	size_t nr_rects;
+	size_t sz;
+	char color[32];
+
+	int visible;
+	int dirty;
+
+	/* Whether the platform currently shows the box. */
+	int shown;
+
+	struct scene_box *next;
+};
+
+static struct scene_box *boxes = NULL;
+static struct scene_box *last = NULL;
+
+struct scene_box *scene_box_create()
+{
+	struct scene_box *b = calloc(1, sizeof *b);
+
+	if (!b)
+		return NULL;
+
+	if (platform->box_create && !(b->pbox = platform->box_create())) {
+		free(b);
+		return NULL;
+	}
+
+	if (last)
+		last->next = b;
+	else
+		boxes = b;
+
+	last = b;
+	return b;
+}
+
+static int rects_equal(const struct screen_rect *a,
+		       const struct screen_rect *b, size_t n)
+{
+	size_t i;
+
+	for (i = 0; i < n; i++)
+		if (a[i].x != b[i].x || a[i].y != b[i].y ||
+		    a[i].w != b[i].w || a[i].h != b[i].h)
+			return 0;
+
+	return 1;
+}
+
+void scene_box_hide(struct scene_box *b)
+{
+	if (!b || !b->visible)
+		return;
+
+	b->visible = 0;
+	b->dirty = 1;
+}
+
+/* Set the box to the union of the given rectangles (relative to scr). */
+void scene_box_set_rects(struct scene_box *b, screen_t scr,
+			 const struct screen_rect *rects, size_t n,
+			 const char *color)
+{
+	size_t i;
+
+	if (!b)
+		return;
+
+	if (!n) {
+		scene_box_hide(b);
+		return;
+	}
+
+	if (b->visible && b->scr == scr && b->nr_rects == n &&
+	    rects_equal(b->rects, rects, n) && !strcmp(b->color, color))
+		return;
+
+	if (n > b->sz) {
+		struct screen_rect *r = realloc(b->rects, n * sizeof *r);
+
+		if (!r)
+			return;
+
+		b->rects = r;
+		b->sz = n;
+	}
+
+	for (i = 0; i < n; i++) {
+		b->rects[i] = rects[i];
+		b->rects[i].scr = scr;
+	}
+
+	b->scr = scr;
+	b->nr_rects = n;
+	snprintf(b->color, sizeof b->color, "%s", color);
+
+	b->visible = 1;
+	b->dirty = 1;
+}
+
+void scene_box_set(struct scene_box *b, screen_t scr, int x, int y, int w,
+		   int h, const char *color)
+{
+	struct screen_rect r = {scr, x, y, w, h};
+
+	scene_box_set_rects(b, scr, &r, 1, color);
+}
+
+/* Hide every box (e.g on exiting a mode). */
+void scene_clear()
+{
+	struct scene_box *b;
+
+	for (b = boxes; b; b = b->next)
+		scene_box_hide(b);
+}
+
+/*
+ * Apply the changes since the last commit. Platforms without retained boxes
+ * have scr cleared and redrawn. Does not call platform->commit().
+ */
+void scene_commit(screen_t scr)
+{
+	struct scene_box *b;
+
+	if (!platform->box_create) {
+		platform->screen_clear(scr);
+
+		for (b = boxes; b; b = b->next) {
+			size_t i;
+
+			if (b->visible && b->scr == scr)
+				for (i = 0; i < b->nr_rects; i++)
+					platform->screen_draw_box(
+					    scr, b->rects[i].x, b->rects[i].y,
+					    b->rects[i].w, b->rects[i].h,
+					    b->color);
+			b->dirty = 0;
+		}
+
+		return;
+	}
+
+	for (b = boxes; b; b = b->next) {
+		if (!b->dirty)
+			continue;
+
+		if (b->visible) {
+			if (b->nr_rects == 1)
+				platform->box_update(b->pbox, b->scr,
+						     b->rects[0].x, b->rects[0].y,
+						     b->rects[0].w, b->rects[0].h,
+						     b->color);
+			else
+				platform->box_update_rects(b->pbox, b->scr,
+							   b->rects, b->nr_rects,
+							   b->color);
+			b->shown = 1;
+		} else if (b->shown) {
+			platform->box_hide(b->pbox);
+			b->shown = 0;
+		}
+
+		b->dirty = 0;
+	}
+}
@@ -15,7 +15,8 @@ void screen_get_cursor(screen_t *scr, int *x, int *y, int warp_to_active)
 	int cx = 0;
 	int cy = 0;
 
-	platform->mouse_get_position(&current, &cx, &cy);
+	/* Discovering the position may be expensive (e.g on Wayland). */
+	platform->mouse_get_position(&current, x ? &cx : NULL, y ? &cy : NULL);
 
 	if (active) {
 		if (current != active && warp_to_active) {
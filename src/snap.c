@@ -0,0 +1,241 @@
+/*
+ * warpd - A modal keyboard-driven pointing system.
+ *
+ * © 2019 Raheman Vaiya (see: LICENSE).
+ */
+
+/*
+ * Boundary snapping for normal mode word motions. The edges on screen are
+ * reduced to two bitmaps: pixels which lie on a long horizontal run of
+ * edges (e.g the top of a button, a line of text) and those which lie on
+ * a long vertical run (e.g the side of a table cell). Motions stop at the
+ * next boundary perpendicular to the direction of travel. The maps are
+ * retained until the screen is damaged.
+ */
+
+#include "warpd.h"
+
+#define EDGE_THRESHOLD 24
+
+/* Gaps of up to this many pixels (e.g between glyphs) do not break a run. */
+#define MAX_GAP 3
+
+/* Shorter runs (e.g glyph stems) are not boundaries. */
+#define MIN_RUN 24
+
+/* Skip the boundary the pointer is currently on. */
+#define MIN_STEP 6
+
+struct snap_map {
+	screen_t scr;
+	int valid;
+
+	int w;
+	int h;
+	int stride;
+
+	uint8_t *hbits;
+	uint8_t *vbits;
+};
+
+static struct snap_map map;
+
+static void set_bit(uint8_t *bits, int stride, int x, int y)
+{
+	bits[(size_t)y * stride + (x >> 3)] |= 1 << (x & 7);
+}
+
+static int get_bit(const uint8_t *bits, int stride, int x, int y)
+{
+	return bits[(size_t)y * stride + (x >> 3)] & (1 << (x & 7));
+}
+
+struct run_job {
+	const uint8_t *edges;
+};
+
+static void hrun_band(void *arg, int y0, int y1)
+{
+	struct run_job *job = arg;
+	int x, y;
+
+	for (y = y0; y < y1; y++) {
+		const uint8_t *e = job->edges + (size_t)y * map.w;
+		int start = -1, last = -1;
+
+		memset(map.hbits + (size_t)y * map.stride, 0, map.stride);
+
+		for (x = 0; x <= map.w; x++) {
+			if (x < map.w && !e[x])
+				continue;
+
+			if (start != -1 &&
+			    (x == map.w || x - last > MAX_GAP + 1)) {
+				if (last - start + 1 >= MIN_RUN)
+					for (; start <= last; start++)
+						set_bit(map.hbits, map.stride,
+							start, y);
+				start = -1;
+			}
+
+			if (x < map.w) {
+				if (start == -1)
+					start = x;
+				last = x;
+			}
+		}
+	}
+}
+
+/*
+ * Bands are groups of 8 columns (one byte of each bitmap row) so threads
+ * never share a byte. Rows are streamed in order with per column state.
+ */
+static void vrun_band(void *arg, int g0, int g1)
+{
+	struct run_job *job = arg;
+	const int x0 = g0 * 8;
+	const int x1 = MIN(map.w, g1 * 8);
+	int *start = malloc((x1 - x0) * sizeof *start);
+	int *last = malloc((x1 - x0) * sizeof *last);
+	int x, y;
+
+	if (!start || !last) {
+		free(start);
+		free(last);
+		return;
+	}
+
+	for (x = x0; x < x1; x++)
+		start[x - x0] = -1;
+
+	for (y = 0; y <= map.h; y++) {
+		const uint8_t *e = job->edges + (size_t)y * map.w;
+
+		for (x = x0; x < x1; x++) {
+			int *s = &start[x - x0];
+			int *l = &last[x - x0];
+
+			if (y < map.h && !e[x])
+				continue;
+
+			if (*s != -1 && (y == map.h || y - *l > MAX_GAP + 1)) {
+				if (*l - *s + 1 >= MIN_RUN)
+					for (; *s <= *l; (*s)++)
+						set_bit(map.vbits, map.stride,
+							x, *s);
+				*s = -1;
+			}
+
+			if (y < map.h) {
+				if (*s == -1)
+					*s = y;
+				*l = y;
+			}
+		}
+	}
+
+	free(start);
+	free(last);
+}
+
+static void build(screen_t scr)
+{
+	struct run_job job;
+	uint8_t *luma, *edges;
+	int sw, sh;
+
+	map.valid = 0;
+	map.scr = scr;
+
+	platform->screen_get_dimensions(scr, &sw, &sh);
+
+	if (!(luma = image_capture_luma(scr, 0, 0, sw, sh)))
+		return;
+
+	if (sw != map.w || sh != map.h) {
+		map.w = sw;
+		map.h = sh;
+		map.stride = (sw + 7) / 8;
+
+		free(map.hbits);
+		free(map.vbits);
+
+		map.hbits = malloc((size_t)map.stride * sh);
+		map.vbits = malloc((size_t)map.stride * sh);
+	}
+
+	if (!map.hbits || !map.vbits || !(edges = malloc((size_t)sw * sh))) {
+		map.w = 0;
+		free(luma);
+		return;
+	}
+
+	image_edges(luma, edges, sw, sh, EDGE_THRESHOLD);
+	free(luma);
+
+	job.edges = edges;
+	memset(map.vbits, 0, (size_t)map.stride * sh);
+
+	image_parallel_rows(sh, 64, hrun_band, &job);
+	image_parallel_rows(map.stride, 8, vrun_band, &job);
+
+	free(edges);
+	map.valid = 1;
+}
+
+/* Rebuild the maps if the screen changed since they were built. */
+static void refresh(screen_t scr)
+{
+	uint8_t *tiles;
+	int cols, rows;
+	size_t dirty;
+
+	damage_get_dimensions(scr, &cols, &rows);
+
+	if (!(tiles = malloc(cols * rows)))
+		return;
+
+	dirty = damage_get(scr, DAMAGE_SNAP, tiles);
+	free(tiles);
+
+	if (dirty || !map.valid || map.scr != scr)
+		build(scr);
+}
+
+/* Called on entry to normal mode so the first motion need not wait. */
+void snap_prepare(screen_t scr)
+{
+	if (platform->screen_capture)
+		refresh(scr);
+}
+
+/*
+ * Returns the position (along the axis of motion) of the next boundary
+ * from (x, y) in direction (dx, dy), or fallback if there is none.
+ */
+int snap_motion(screen_t scr, int x, int y, int dx, int dy, int fallback)
+{
+	int i;
+
+	if (!platform->screen_capture)
+		return fallback;
+
+	refresh(scr);
+
+	if (!map.valid || x < 0 || y < 0 || x >= map.w || y >= map.h)
+		return fallback;
+
+	if (dx)
+		for (i = x + dx * MIN_STEP; i >= 0 && i < map.w; i += dx) {
+			if (get_bit(map.vbits, map.stride, i, y))
+				return i;
+		}
+	else
+		for (i = y + dy * MIN_STEP; i >= 0 && i < map.h; i += dy) {
+			if (get_bit(map.hbits, map.stride, x, i))
+				return i;
+		}
+
+	return fallback;
+}
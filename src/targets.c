@@ -0,0 +1,352 @@
+/*
+ * warpd - A modal keyboard-driven pointing system.
+ *
+ * © 2019 Raheman Vaiya (see: LICENSE).
+ */
+
+/*
+ * Cache of interactable targets (see collect_interactable_hints). Entries
+ * are keyed by screen and focused window and remain valid until their TTL
+ * expires or the platform reports a change to the focused window.
+ */
+
+#include "warpd.h"
+
+#ifndef WINDOWS
+#include <pthread.h>
+
+/* Guards the cache, never held while collecting. */
+static pthread_mutex_t mtx = PTHREAD_MUTEX_INITIALIZER;
+
+/*
+ * Serializes collection, which the platform collectors expect. Taken
+ * before the cache lock where both are held.
+ */
+static pthread_mutex_t collect_mtx = PTHREAD_MUTEX_INITIALIZER;
+
+#define lock()		 pthread_mutex_lock(&mtx)
+#define unlock()	 pthread_mutex_unlock(&mtx)
+#define collect_lock()	 pthread_mutex_lock(&collect_mtx)
+#define collect_unlock() pthread_mutex_unlock(&collect_mtx)
+#else
+#define lock()
+#define unlock()
+#define collect_lock()
+#define collect_unlock()
+#endif
+
+#define CACHE_SIZE 4
+
+/* The number of targets first collected into an empty buffer. */
+#define INITIAL_TARGETS 256
+
+struct entry {
+	screen_t scr;
+	uint64_t window;
+	uint64_t generation;
+
+	uint64_t time;
+	uint64_t last_used;
+
+	size_t n;
+	struct hint_buf buf;
+};
+
+static struct entry cache[CACHE_SIZE];
+
+enum target_source {
+	SOURCE_AUTO,
+	SOURCE_ACCESSIBILITY,
+	SOURCE_SCREEN,
+};
+
+/* Written by the main thread, read by the warmer. */
+static volatile int ttl_ms = 0;
+static volatile int warm_interval_ms = 0;
+static volatile int detect_budget_ms = 0;
+static volatile enum target_source source = SOURCE_AUTO;
+static screen_t warm_scr = NULL;
+
+/*
+ * Set while a mode is active, the warmer stays out of the way. Guarded by
+ * the cache lock so no collection is started once it has been set.
+ */
+static int busy = 0;
+
+/*
+ * Prefer the accessibility API, falling back to screen based detection
+ * for applications which don't expose anything (if permitted by
+ * find_source).
+ */
+static size_t collect_once(screen_t scr, struct hint *hints, size_t max_hints)
+{
+	size_t n = 0;
+
+	if (source != SOURCE_SCREEN && platform->collect_interactable_hints)
+		n = platform->collect_interactable_hints(scr, hints, max_hints);
+
+	if (!n && source != SOURCE_ACCESSIBILITY && platform->screen_capture)
+		n = detect_interactable_hints(scr, hints, max_hints,
+					      detect_budget_ms);
+
+	return n;
+}
+
+/*
+ * Collect into buf, growing it (and collecting again) for as long as the
+ * collectors fill it. Since buffers are kept, this only happens when a
+ * window has more targets than any seen before.
+ */
+static size_t collect(screen_t scr, struct hint_buf *buf)
+{
+	size_t sz = MAX(buf->sz, INITIAL_TARGETS);
+	size_t n;
+
+	while (1) {
+		if (!hint_buf_reserve(buf, sz))
+			return 0;
+
+		n = collect_once(scr, buf->hints, buf->sz);
+		if (n < buf->sz)
+			return n;
+
+		sz = buf->sz * 2;
+	}
+}
+
+static int entry_valid(struct entry *e, screen_t scr, uint64_t window,
+		       uint64_t generation, uint64_t now)
+{
+	return e->scr == scr && e->window == window &&
+	       e->generation == generation &&
+	       now - e->time < (uint64_t)ttl_ms * 1000;
+}
+
+/* Expects the lock to be held. */
+static struct entry *lookup(screen_t scr, uint64_t window, uint64_t generation)
+{
+	size_t i;
+	uint64_t now = get_time_us();
+
+	for (i = 0; i < CACHE_SIZE; i++) {
+		if (entry_valid(&cache[i], scr, window, generation, now))
+			return &cache[i];
+	}
+
+	return NULL;
+}
+
+/*
+ * Copies the cached targets into buf, returns -1 if there are none.
+ * Expects the lock to be held.
+ */
+static size_t fetch(screen_t scr, uint64_t window, uint64_t generation,
+		    struct hint_buf *buf)
+{
+	struct entry *e;
+
+	if (!(e = lookup(scr, window, generation)))
+		return -1;
+
+	e->last_used = get_time_us();
+
+	if (!hint_buf_reserve(buf, e->n))
+		return 0;
+
+	memcpy(buf->hints, e->buf.hints, e->n * sizeof(struct hint));
+
+	return e->n;
+}
+
+/* Expects the lock to be held. */
+static void store(screen_t scr, uint64_t window, uint64_t generation,
+		  const struct hint *hints, size_t n)
+{
+	size_t i;
+	struct entry *e = &cache[0];
+
+	/* Reuse the slot for this screen/window or evict the stalest one. */
+	for (i = 0; i < CACHE_SIZE; i++) {
+		if (cache[i].scr == scr && cache[i].window == window) {
+			e = &cache[i];
+			break;
+		}
+
+		if (cache[i].last_used < e->last_used)
+			e = &cache[i];
+	}
+
+	/* Dropped if it can't be stored. */
+	if (!hint_buf_reserve(&e->buf, n)) {
+		e->scr = NULL;
+		e->n = 0;
+		return;
+	}
+
+	e->scr = scr;
+	e->window = window;
+	e->generation = generation;
+	e->n = n;
+	memcpy(e->buf.hints, hints, n * sizeof(struct hint));
+	e->time = get_time_us();
+	e->last_used = e->time;
+}
+
+/*
+ * Populate buf (grown as needed) with the targets of the given screen.
+ * Returns the number of targets.
+ */
+size_t targets_collect(screen_t scr, struct hint_buf *buf)
+{
+	uint64_t window, generation;
+	size_t n;
+
+	if (ttl_ms <= 0 || !platform->target_state ||
+	    platform->target_state(&window, &generation)) {
+		collect_lock();
+		n = collect(scr, buf);
+		collect_unlock();
+
+		return n;
+	}
+
+	lock();
+	warm_scr = scr;
+	n = fetch(scr, window, generation, buf);
+	unlock();
+
+	if (n != (size_t)-1)
+		return n;
+
+	collect_lock();
+
+	/* The warmer may have just collected the same targets. */
+	lock();
+	n = fetch(scr, window, generation, buf);
+	unlock();
+
+	/* The cache remains available to the warmer while collecting. */
+	if (n == (size_t)-1) {
+		n = collect(scr, buf);
+
+		lock();
+		store(scr, window, generation, buf->hints, n);
+		unlock();
+	}
+
+	collect_unlock();
+
+	return n;
+}
+
+void targets_set_busy(int _busy)
+{
+	lock();
+	busy = _busy;
+	unlock();
+}
+
+#ifndef WINDOWS
+/*
+ * Recollects the targets of the focused window once it has changed and
+ * settled (i.e is unchanged for an interval), provided no mode is active.
+ */
+static void *warmer(void *arg)
+{
+	struct hint_buf buf = {0};
+
+	uint64_t prev_window = 0, prev_generation = 0;
+	uint64_t warm_window = 0, warm_generation = 0;
+
+	while (1) {
+		uint64_t window, generation;
+		int interval = warm_interval_ms;
+		screen_t scr;
+		int settled;
+		int idle;
+		size_t n;
+
+		usleep((interval > 0 ? interval : 1000) * 1000);
+
+		if (interval <= 0 || ttl_ms <= 0 ||
+		    platform->target_state(&window, &generation))
+			continue;
+
+		settled = window == prev_window && generation == prev_generation;
+
+		prev_window = window;
+		prev_generation = generation;
+
+		if (!settled ||
+		    (window == warm_window && generation == warm_generation))
+			continue;
+
+		collect_lock();
+
+		lock();
+		idle = !busy;
+		scr = warm_scr;
+		if (scr && lookup(scr, window, generation))
+			scr = NULL;
+		unlock();
+
+		if (idle && scr) {
+			n = collect(scr, &buf);
+
+			lock();
+			store(scr, window, generation, buf.hints, n);
+			unlock();
+		}
+
+		collect_unlock();
+
+		/* Retried on the next check if a mode was active. */
+		if (idle) {
+			warm_window = window;
+			warm_generation = generation;
+		}
+	}
+
+	return NULL;
+}
+#endif
+
+void start_target_warmer()
+{
+#ifndef WINDOWS
+	static int started = 0;
+	pthread_t tid;
+
+	if (started || !platform->target_state ||
+	    (!platform->collect_interactable_hints && !platform->screen_capture))
+		return;
+
+	if (!pthread_create(&tid, NULL, warmer, NULL)) {
+		pthread_detach(tid);
+		started = 1;
+	}
+#endif
+}
+
+void init_targets()
+{
+	screen_t scr;
+
+	ttl_ms = config_get_int("find_cache_ttl");
+	warm_interval_ms = config_get_int("find_cache_warm_interval");
+	detect_budget_ms = config_get_int("find_detect_budget");
+
+	if (!strcmp(config_get("find_source"), "accessibility"))
+		source = SOURCE_ACCESSIBILITY;
+	else if (!strcmp(config_get("find_source"), "screen"))
+		source = SOURCE_SCREEN;
+	else
+		source = SOURCE_AUTO;
+
+	screen_get_cursor(&scr, NULL, NULL, 0);
+
+	lock();
+	if (!warm_scr)
+		warm_scr = scr;
+	unlock();
+}
@@ -0,0 +1,205 @@
+/*
+ * warpd - A modal keyboard-driven pointing system.
+ *
+ * © 2019 Raheman Vaiya (see: LICENSE).
+ */
+
+/*
+ * Blocks until a region of the screen changes and subsequently settles
+ * (--wait-change). Platform damage is used where available (waiting on
+ * it if the platform allows, polling otherwise), otherwise successive
+ * captures are compared tile by tile.
+ */
+
+#include "warpd.h"
+
+/*
+ * Polling intervals (ms) for damage (if it can't be waited on) and capture
+ * based detection.
+ */
+#define DAMAGE_INTERVAL	 5
+#define CAPTURE_INTERVAL 20
+
+static screen_t scr;
+static int rx, ry, rw, rh;
+
+static uint8_t *tiles;
+static int cols, rows;
+
+/* Capture fallback state. */
+static uint32_t *pixels;
+static uint64_t *hashes;
+static int hcols, hrows;
+
+static uint64_t hash_tile(const uint32_t *p, int stride, int w, int h)
+{
+	uint64_t hash = 1469598103934665603ULL;
+	int x, y;
+
+	for (y = 0; y < h; y++)
+		for (x = 0; x < w; x++)
+			hash = (hash ^ p[(size_t)y * stride + x]) *
+			       1099511628211ULL;
+
+	return hash;
+}
+
+/* Returns the number of tiles in the region whose contents changed. */
+static size_t poll_capture()
+{
+	size_t n = 0;
+	int r, c;
+
+	if (platform->screen_capture(scr, rx, ry, rw, rh, pixels))
+		return 0;
+
+	for (r = 0; r < hrows; r++)
+		for (c = 0; c < hcols; c++) {
+			const int x = c * DAMAGE_TILE;
+			const int y = r * DAMAGE_TILE;
+			uint64_t hash = hash_tile(pixels + (size_t)y * rw + x, rw,
+						  MIN(DAMAGE_TILE, rw - x),
+						  MIN(DAMAGE_TILE, rh - y));
+
+			if (hash != hashes[r * hcols + c]) {
+				hashes[r * hcols + c] = hash;
+				n++;
+			}
+		}
+
+	return n;
+}
+
+/* Returns the number of damaged tiles which intersect the region. */
+static size_t poll_damage()
+{
+	const int c0 = rx / DAMAGE_TILE;
+	const int r0 = ry / DAMAGE_TILE;
+	const int c1 = (rx + rw - 1) / DAMAGE_TILE;
+	const int r1 = (ry + rh - 1) / DAMAGE_TILE;
+	size_t n = 0;
+	int r, c;
+
+	damage_get(scr, DAMAGE_WAIT, tiles);
+
+	for (r = r0; r <= r1; r++)
+		for (c = c0; c <= c1; c++)
+			n += tiles[r * cols + c];
+
+	return n;
+}
+
+/*
+ * Start watching the given region of _scr (the whole screen if w or h
+ * is 0). Changes which occur after this point are seen by wait_change().
+ * Returns -1 on failure.
+ */
+int init_wait_change(screen_t _scr, int x, int y, int w, int h)
+{
+	int sw, sh;
+
+	free(tiles);
+	free(pixels);
+	free(hashes);
+
+	tiles = NULL;
+	pixels = NULL;
+	hashes = NULL;
+
+	scr = _scr;
+	platform->screen_get_dimensions(scr, &sw, &sh);
+
+	if (w <= 0 || h <= 0) {
+		x = 0;
+		y = 0;
+		w = sw;
+		h = sh;
+	}
+
+	rx = MAX(0, MIN(x, sw - 1));
+	ry = MAX(0, MIN(y, sh - 1));
+	rw = MAX(1, MIN(w, sw - rx));
+	rh = MAX(1, MIN(h, sh - ry));
+
+	damage_get_dimensions(scr, &cols, &rows);
+	if (!(tiles = malloc(cols * rows)))
+		return -1;
+
+	/*
+	 * Discard everything which predates us (the first poll may report
+	 * the whole screen while the platform starts tracking).
+	 */
+	damage_get(scr, DAMAGE_WAIT, tiles);
+	damage_get(scr, DAMAGE_WAIT, tiles);
+
+	if (damage_tracked() || !platform->screen_capture)
+		return 0;
+
+	hcols = (rw + DAMAGE_TILE - 1) / DAMAGE_TILE;
+	hrows = (rh + DAMAGE_TILE - 1) / DAMAGE_TILE;
+
+	pixels = malloc((size_t)rw * rh * sizeof *pixels);
+	hashes = calloc(hcols * hrows, sizeof *hashes);
+
+	if (!pixels || !hashes) {
+		free(pixels);
+		free(hashes);
+
+		pixels = NULL;
+		hashes = NULL;
+
+		return -1;
+	}
+
+	poll_capture();
+	return 0;
+}
+
+/*
+ * Wait for the region to change and then remain unchanged for
+ * wait_change_settle ms. Returns -1 if no change occurs within
+ * timeout_ms. A region which is still changing once the timeout expires
+ * counts as changed.
+ */
+int wait_change(int timeout_ms)
+{
+	const uint64_t settle = config_get_int("wait_change_settle") * 1000;
+	const int capture = hashes != NULL;
+	const uint64_t start = get_time_us();
+	uint64_t last_change = 0;
+
+	if (!capture && !damage_tracked()) {
+		fprintf(stderr, "ERROR: screen changes cannot be detected on "
+				"this platform\n");
+		return -1;
+	}
+
+	while (1) {
+		uint64_t wait;
+		uint64_t t;
+
+		if (capture ? poll_capture() : poll_damage())
+			last_change = get_time_us();
+
+		t = get_time_us();
+
+		if (last_change && t - last_change >= settle)
+			return 0;
+
+		if (t - start >= (uint64_t)timeout_ms * 1000)
+			return last_change ? 0 : -1;
+
+		if (capture || !platform->screen_wait_damage) {
+			usleep((capture ? CAPTURE_INTERVAL : DAMAGE_INTERVAL) *
+			       1000);
+			continue;
+		}
+
+		/* Sleep until something changes, settles or times out. */
+		wait = start + (uint64_t)timeout_ms * 1000 - t;
+		if (last_change)
+			wait = MIN(wait, last_change + settle - t);
+
+		platform->screen_wait_damage(MAX(1, (wait + 999) / 1000));
+	}
+}
@@ -122,6 +122,8 @@ static void print_usage()
 	    "after the end of the session.\n"
 	    "  --find                      Start warpd in find mode and exit "
 	    "after the end of the session.\n"
+	    "  --text                      Start warpd in text hint mode and "
+	    "exit after the end of the session.\n"
 	    "  --hint2                     Start warpd in two pass hint mode "
 	    "and exit after the end of the session.\n"
 	    "  --normal                    Start warpd in normal mode and exit "
@@ -137,6 +139,15 @@ static void print_usage()
 	    "coordinates.\n"
 	    "  --click <button>            Send a mouse click corresponding to "
 	    "the supplied button and exit. May be paired with --move.\n"
+	    "  --locate <image>            Move the pointer to the center of the "
+	    "on screen region which best matches the supplied image (PNG or "
+	    "PPM/PGM). Exits with a non-zero status if it cannot be found. May be "
+	    "paired with --click.\n"
+	    "  --wait-change[='[<x> <y> <w> <h>] [<timeout>]']\n"
+	    "                              After any other action (e.g --click), "
+	    "wait for the screen (or region) to change and settle before "
+	    "exiting. Exits with a non-zero status if nothing changes within the "
+	    "timeout (ms).\n"
 	    "  -q, --query                 Consumes a list of hints from stdin "
 	    "and presents a one off hint selection.\n"
 	    "  --record                    When used with --click, records the "
@@ -155,6 +166,10 @@ static int oneshot_flag = 0;
 static int click_flag = 0;
 static int x_flag = -1;
 static int y_flag = -1;
+static const char *locate_flag = NULL;
+static int wait_flag = 0;
+static int wait_region[4] = {0};
+static int wait_timeout = -1;
 static int record_flag = 0;
 static int mode = 0;
 
@@ -162,15 +177,37 @@ static int mode = 0;
 int oneshot_main(struct platform *_platform)
 {
 	int ret = 0;
-	screen_t scr;
+	screen_t scr = NULL;
 	platform = _platform;
 
 	parse_config(config_path);
 	init_mouse();
 	init_hints();
+	init_anim();
+	init_targets();
+
+	/* Only look for the pointer if it is needed (see below). */
+	if (wait_flag || x_flag != -1 || y_flag != -1)
+		screen_get_cursor(&scr, NULL, NULL, 0);
+
+	if (wait_flag && !mode &&
+	    init_wait_change(scr, wait_region[0], wait_region[1],
+			     wait_region[2], wait_region[3])) {
+		fprintf(stderr, "ERROR: failed to watch the screen for changes\n");
+		return -1;
+	}
+
+	if (locate_flag) {
+		int x, y;
+
+		if (locate_template(locate_flag, &scr, &x, &y)) {
+			fprintf(stderr, "%s: no match found\n", locate_flag);
+			return -1;
+		}
 
-	screen_get_cursor(&scr, NULL, NULL, 0);
-	if (x_flag == -1 && y_flag == -1) {
+		platform->mouse_move(scr, x, y);
+		printf("%d %d\n", x, y);
+	} else if (x_flag == -1 && y_flag == -1) {
 		if (drag_flag)
 			platform->mouse_down(config_get_int("drag_button"));
 
@@ -179,6 +216,15 @@ int oneshot_main(struct platform *_platform)
 		if (drag_flag)
 			platform->mouse_up(config_get_int("drag_button"));
 
+		/* Only the reaction to the selection is of interest. */
+		if (wait_flag &&
+		    init_wait_change(scr, wait_region[0], wait_region[1],
+				     wait_region[2], wait_region[3])) {
+			fprintf(stderr, "ERROR: failed to watch the screen "
+					"for changes\n");
+			return -1;
+		}
+
 	} else {
 		platform->mouse_move(scr, x_flag, y_flag);
 	}
@@ -186,6 +232,16 @@ int oneshot_main(struct platform *_platform)
 	if (click_flag)
 		platform->mouse_click(click_flag);
 
+	if (wait_flag) {
+		if (wait_timeout < 0)
+			wait_timeout = config_get_int("wait_change_timeout");
+
+		if (wait_change(wait_timeout)) {
+			fprintf(stderr, "timed out waiting for a screen change\n");
+			ret = -1;
+		}
+	}
+
 	return ret;
 }
 
@@ -196,6 +252,7 @@ int daemon_main(struct platform *_platform)
 	parse_config(config_path);
 	init_mouse();
 	init_hints();
+	init_anim();
 
 	daemon_loop(config_path);
 
@@ -234,6 +291,7 @@ int main(int argc, char *argv[])
 
 				{"hint", no_argument, NULL, 257},
 				{"find", no_argument, NULL, 269},
+				{"text", no_argument, NULL, 270},
 				{"grid", no_argument, NULL, 258},
 				{"normal", no_argument, NULL, 259},
 				{"hint2", no_argument, NULL, 261},
@@ -246,6 +304,8 @@ int main(int argc, char *argv[])
 				{"record", no_argument, NULL, 266},
 				{"drag", no_argument, NULL, 267},
 				{"screen", no_argument, NULL, 268},
+				{"locate", required_argument, NULL, 271},
+				{"wait-change", optional_argument, NULL, 272},
 				{0}};
 
 	while ((c = getopt_long(argc, argv, "qrhfvlc:", opts, NULL)) != -1) {
@@ -275,6 +335,9 @@ int main(int argc, char *argv[])
 		case 269:
 			mode = MODE_FIND;
 			break;
+		case 270:
+			mode = MODE_TEXT;
+			break;
 		case 258:
 
 			mode = MODE_GRID;
@@ -305,6 +368,27 @@ int main(int argc, char *argv[])
 			sscanf(optarg, "%d %d", &x_flag, &y_flag);
 			oneshot_flag = 1;
 			break;
+		case 271:
+			locate_flag = optarg;
+			oneshot_flag = 1;
+			break;
+		case 272: {
+			int v[5];
+			int n = optarg ? sscanf(optarg, "%d %d %d %d %d", &v[0],
+						&v[1], &v[2], &v[3], &v[4])
+				       : 0;
+
+			if (n == 1)
+				wait_timeout = v[0];
+			if (n >= 4)
+				memcpy(wait_region, v, sizeof wait_region);
+			if (n == 5)
+				wait_timeout = v[4];
+
+			wait_flag = 1;
+			oneshot_flag = 1;
+			break;
+		}
 		case 266:
 			record_flag = 1;
 			break;
@@ -45,6 +45,9 @@
 #endif
 
 #define MIN(a, b)     (((a) < (b)) ? (a) : (b))
+#ifndef MAX
+#define MAX(a, b)     (((a) > (b)) ? (a) : (b))
+#endif
 #define MAX_HIST_ENTS 16
 
 #ifdef _MSC_VER
@@ -59,6 +62,7 @@ enum {
 	MODE_HINT2,
 	MODE_FIND,
 	MODE_FIND_STICKY,
+	MODE_TEXT,
 	MODE_GRID,
 	MODE_NORMAL,
 	MODE_HINTSPEC,
@@ -88,6 +92,15 @@ struct histfile_ent {
 	int y;
 };
 
+/*
+ * Hint storage which is kept around and grown to fit the largest hint set
+ * seen, rather than being sized for a fixed maximum up front.
+ */
+struct hint_buf {
+	struct hint *hints;
+	size_t sz;
+};
+
 extern char last_selected_hint[32];
 
 int hintspec_mode();
@@ -95,6 +108,7 @@ int history_hint_mode();
 int full_hint_mode(int second_pass);
 int find_hint_mode();
 int find_hint_mode_sticky();
+int text_hint_mode();
 void screen_selection_mode();
 void screen_set_active(screen_t scr);
 screen_t screen_get_active(void);
@@ -104,6 +118,7 @@ struct input_event *grid_mode();
 struct input_event *normal_mode(struct input_event *start_ev, int oneshot);
 
 void init_hints();
+void init_targets();
 void init_normal_mode();
 void init_grid_mode();
 
@@ -116,6 +131,105 @@ int config_input_match(struct input_event *ev, const char *str);
 int config_input_match_loose(struct input_event *ev, const char *str);
 
 size_t hist_hints(struct hint *hints, int w, int h);
+struct hint *hint_buf_reserve(struct hint_buf *b, size_t n);
+
+size_t targets_collect(screen_t scr, struct hint_buf *buf);
+size_t ocr_collect_words(screen_t scr, struct hint_buf *buf);
+
+#define DAMAGE_TILE 64
+
+enum damage_consumer {
+	DAMAGE_OCR,
+	DAMAGE_WAIT,
+	DAMAGE_SNAP,
+
+	NR_DAMAGE_CONSUMERS
+};
+
+size_t damage_get(screen_t scr, enum damage_consumer consumer,
+		  uint8_t *tiles);
+void damage_get_dimensions(screen_t scr, int *cols, int *rows);
+int damage_tracked();
+
+struct scene_box *scene_box_create();
+void scene_box_set(struct scene_box *b, screen_t scr, int x, int y, int w,
+		   int h, const char *color);
+void scene_box_set_rects(struct scene_box *b, screen_t scr,
+			 const struct screen_rect *rects, size_t n,
+			 const char *color);
+void scene_box_hide(struct scene_box *b);
+void scene_clear();
+void scene_commit(screen_t scr);
+
+void init_anim();
+void anim_ripple(screen_t scr, int x, int y);
+void anim_entry_pulse(screen_t scr, int x, int y);
+void anim_clear(screen_t scr);
+void anim_clear_all();
+void anim_drain();
+int anim_tick();
+int anim_timeout(int timeout);
+
+void snap_prepare(screen_t scr);
+int snap_motion(screen_t scr, int x, int y, int dx, int dy, int fallback);
+
+int init_wait_change(screen_t scr, int x, int y, int w, int h);
+int wait_change(int timeout_ms);
+
+size_t detect_interactable_hints(screen_t scr, struct hint *hints,
+				 size_t max_hints, int budget_ms);
+
+void image_parallel_rows(int h, int min_rows,
+			 void (*fn)(void *arg, int y0, int y1), void *arg);
+void image_luma(const uint32_t *pixels, uint8_t *luma, int w, int h);
+void image_edges(const uint8_t *luma, uint8_t *edges, int w, int h,
+		 int threshold);
+void image_reduce(const uint8_t *edges, uint8_t *cells, int w, int h,
+		  int cell);
+uint8_t *image_capture_luma(screen_t scr, int x, int y, int w, int h);
+uint8_t *image_load_luma(const char *path, int *w, int *h);
+uint8_t *image_downsample(const uint8_t *src, int w, int h, int *ow, int *oh);
+void image_zoom(const uint32_t *src, uint32_t *dst, int w, int h, int zoom);
+void image_zoom_bilinear(const uint32_t *src, uint32_t *dst, int w, int h,
+			 int zoom);
+
+/* Colors are premultiplied ARGB (see raster_color). */
+struct raster_style {
+	uint32_t bg;
+	uint32_t fg;
+	uint32_t border;
+
+	int border_width;
+	int border_radius;
+};
+
+struct raster_atlas;
+
+/*
+ * Supplied by the platform to rasterize the glyphs of font sized for
+ * w x h hints into atlas (see raster_atlas_add_glyph). Returns 0 on
+ * success.
+ */
+typedef int (*raster_font_fn)(struct raster_atlas *atlas, const char *font,
+			      int w, int h);
+
+uint32_t raster_color(uint8_t r, uint8_t g, uint8_t b, uint8_t a);
+void raster_atlas_set_metrics(struct raster_atlas *atlas, int ascent,
+			      int descent);
+int raster_atlas_add_glyph(struct raster_atlas *atlas, char c,
+			   const uint8_t *alpha, int w, int h, int stride,
+			   int left, int top, int advance);
+void raster_flush();
+int raster_draw_hints(uint32_t *buf, int stride, int w, int h, int clear,
+		      struct hint *hints, size_t n,
+		      const struct raster_style *style, const char *font,
+		      raster_font_fn render);
+void raster_draw_ring(uint32_t *buf, int stride, int w, int h, int x, int y,
+		      const struct ring *ring);
+
+int locate_template(const char *path, screen_t *scr, int *x, int *y);
+void start_target_warmer();
+void targets_set_busy(int busy);
 
 int mouse_process_key(struct input_event *ev, const char *up_key,
 		      const char *down_key, const char *left_key,
@@ -0,0 +1,54 @@
+#!/bin/sh
+
+# Checks that find mode collects the widgets of an accessible GTK application
+# over AT-SPI, using a virtual X server and a private session bus.
+#
+# Requires Xvfb, dbus-run-session, at-spi2-core and gtk3-widget-factory
+# (debian: xvfb dbus at-spi2-core gtk-3-examples). Run it from the root of
+# the tree after building.
+#
+# Usage: test/atspi.sh [path to warpd] [minimum number of targets]
+
+warpd=${1:-bin/warpd}
+min=${2:-10}
+display=:${WARPD_TEST_DISPLAY:-99}
+
+if [ ! -x "$warpd" ]; then
+	echo "$warpd not found, build warpd first" >&2
+	exit 1
+fi
+
+for cmd in Xvfb dbus-run-session gtk3-widget-factory; do
+	if ! command -v $cmd >/dev/null; then
+		echo "$cmd is required" >&2
+		exit 1
+	fi
+done
+
+Xvfb $display -screen 0 1280x1024x24 >/dev/null 2>&1 &
+xvfb=$!
+trap 'kill $xvfb 2>/dev/null' EXIT INT TERM
+sleep 1
+
+# Without a window manager, GTK considers the window under the pointer to be
+# active, so the pointer is moved over the widget factory (at the origin).
+out=$(DISPLAY=$display WARPD_ATSPI_DEBUG=1 dbus-run-session -- sh -c "
+	gtk3-widget-factory >/dev/null 2>&1 &
+	sleep 3
+	'$warpd' --move '200 200'
+	timeout 5 '$warpd' --find 2>&1 >/dev/null
+	kill \$! 2>/dev/null")
+
+echo "$out"
+
+hints=$(echo "$out" | sed -n 's/^atspi: .*hints=\([0-9]*\).*/\1/p' | head -n 1)
+
+if [ -z "$hints" ]; then
+	echo "FAIL: no targets were collected over AT-SPI" >&2
+	exit 1
+elif [ "$hints" -lt "$min" ]; then
+	echo "FAIL: $hints targets collected, expected at least $min" >&2
+	exit 1
+fi
+
+echo "OK: $hints targets collected"